@@ -50,6 +50,7 @@ public:
         txMint.SetNull();
         vtx.clear();
         vchSig.clear();
+        InvalidateHash();
     }
     bool IsNull() const
     {
@@ -69,15 +70,32 @@ public:
     }
     uint256 GetHash() const
     {
-        walleve::CWalleveBufStream ss;
-        ss << nVersion << nType << nTimeStamp << hashPrev << hashMerkle << vchProof << txMint;
-        return multiverse::crypto::CryptoHash(ss.GetData(),ss.GetSize());
+        if (!fHashCached)
+        {
+            multiverse::crypto::CCryptoHashStream ss;
+            ss << nVersion << nType << nTimeStamp << hashPrev << hashMerkle << vchProof << txMint;
+            hashCached = ss.GetHash();
+            fHashCached = true;
+        }
+        return hashCached;
+    }
+    // Must be called after modifying the header or txMint of a block which was already hashed
+    void InvalidateHash()
+    {
+        fHashCached = false;
     }
     std::size_t GetTxSerializedOffset() const
     {
         return (sizeof(nVersion) + sizeof(nType) + sizeof(nTimeStamp) + sizeof(hashPrev) + 
                 sizeof(hashMerkle) + walleve::GetSerializeSize(vchProof));
     }
+    // Serialized size of the block, given the total serialized size of vtx items
+    std::size_t GetSerializedSize(std::size_t nTotalTxSize) const
+    {
+        return (GetTxSerializedOffset() + walleve::GetSerializeSize(txMint) 
+                + walleve::GetSerializeSize(walleve::CVarInt(vtx.size())) + nTotalTxSize
+                + walleve::GetSerializeSize(vchSig));
+    }
     void GetSerializedProofOfWorkData(std::vector<unsigned char>& vchProofOfWork) const
     {
         walleve::CWalleveBufStream ss;
@@ -117,14 +135,11 @@ public:
         vMerkleTree.clear();
         BOOST_FOREACH(const CTransaction& tx, vtx)
             vMerkleTree.push_back(tx.GetHash());
-        int j = 0;
-        for (int nSize = vtx.size(); nSize > 1; nSize = (nSize + 1) / 2)
+        std::size_t j = 0;
+        for (std::size_t nSize = vtx.size(); nSize > 1; nSize = (nSize + 1) / 2)
         {
-            for (int i = 0; i < nSize; i += 2)
-            {
-                int i2 = std::min(i+1, nSize-1);
-                vMerkleTree.push_back(multiverse::crypto::CryptoHash(vMerkleTree[j+i],vMerkleTree[j+i2]));
-            } 
+            vMerkleTree.resize(j + nSize + (nSize + 1) / 2);
+            multiverse::crypto::CryptoHashMerkleLevel(&vMerkleTree[j],nSize,&vMerkleTree[j + nSize]);
             j += nSize;
         }
         return (vMerkleTree.empty() ? 0 : vMerkleTree.back());
@@ -147,7 +162,17 @@ protected:
         s.Serialize(txMint,opt);
         s.Serialize(vtx,opt);
         s.Serialize(vchSig,opt);
+        InvalidateHash(opt);
     }    
+    void InvalidateHash(walleve::LoadType&)
+    {
+        InvalidateHash();
+    }
+    template <typename O>
+    void InvalidateHash(O&) {}
+protected:
+    mutable uint256 hashCached;
+    mutable bool fHashCached;
 };
 
 class CBlockEx : public CBlock
@@ -190,6 +215,13 @@ public:
     uint8   nProofBits;
     uint32  nFile;
     uint32  nOffset;
+    // serialized size of the block at the head of its record, 0 if not known yet
+    uint32  nBlockSize;
+    CBlockIndex* pLastWork;
+    CBlockIndex* pPrevWork;
+    int64   nWorkSpacing;
+    int64   nWorkWeight;
+    enum { WORK_ADJUST_COUNT = 16 };
 public:
     CBlockIndex()
     {
@@ -210,6 +242,11 @@ public:
         nProofBits = 0;
         nFile = 0;
         nOffset = 0;
+        nBlockSize = 0;
+        pLastWork = NULL;
+        pPrevWork = NULL;
+        nWorkSpacing = 0;
+        nWorkWeight = 0;
     }
     CBlockIndex(CBlock& block,uint32 nFileIn,uint32 nOffsetIn)
     {
@@ -240,6 +277,11 @@ public:
         }
         nFile = nFileIn;
         nOffset = nOffsetIn;
+        nBlockSize = 0;
+        pLastWork = NULL;
+        pPrevWork = NULL;
+        nWorkSpacing = 0;
+        nWorkWeight = 0;
     }
     uint256 GetBlockHash() const
     {
@@ -277,6 +319,39 @@ public:
     {
         return (nMintType == CTransaction::TX_WORK);
     }
+    // Last proof-of-work block of the algo at or before this block
+    CBlockIndex* GetLastWork(int nAlgo) const
+    {
+        CBlockIndex* pIndex = pLastWork;
+        while (pIndex != NULL && pIndex->nProofAlgo != nAlgo)
+        {
+            pIndex = (pIndex->pPrev != NULL ? pIndex->pPrev->pLastWork : NULL);
+        }
+        return pIndex;
+    }
+    // Link proof-of-work blocks of the same algo and accumulate the weighted spacing
+    // of the last WORK_ADJUST_COUNT ones, must be called after pPrev is set
+    void UpdateWork()
+    {
+        pLastWork = (pPrev != NULL ? pPrev->pLastWork : NULL);
+        pPrevWork = NULL;
+        nWorkSpacing = 0;
+        nWorkWeight = 0;
+        if (!IsProofOfWork() || pPrev == NULL)
+        {
+            return;
+        }
+        pPrevWork = pPrev->GetLastWork(nProofAlgo);
+        pLastWork = this;
+
+        CBlockIndex* pIndex = this;
+        for (int nWIndex = WORK_ADJUST_COUNT - 1;nWIndex >= 0 && pIndex != NULL;nWIndex--)
+        {
+            nWorkSpacing += (pIndex->GetBlockTime() - pIndex->pPrev->GetBlockTime()) << nWIndex;
+            nWorkWeight += (1LL) << nWIndex;
+            pIndex = pIndex->pPrevWork;
+        }
+    }
     const std::string GetBlockType() const
     {
         if (nType == CBlock::BLOCK_GENESIS) return std::string("genesis");
@@ -347,5 +422,110 @@ public:
     std::vector<uint256> vBlockHash;
 };
 
+// Block relayed as header, mint tx and 6 bytes short ids of vtx, keyed by the block hash and a salt
+class CCompactBlock
+{
+    friend class walleve::CWalleveStream;
+public:
+    enum { SHORTID_SIZE = 6 };
+    CCompactBlock() : nSalt(0) {}
+    CCompactBlock(const CBlock& block,uint64 nSaltIn) : nSalt(nSaltIn)
+    {
+        header.nVersion = block.nVersion;
+        header.nType = block.nType;
+        header.nTimeStamp = block.nTimeStamp;
+        header.hashPrev = block.hashPrev;
+        header.hashMerkle = block.hashMerkle;
+        header.vchProof = block.vchProof;
+        header.txMint = block.txMint;
+        header.vchSig = block.vchSig;
+
+        uint64 k0,k1;
+        GetShortIdKey(k0,k1);
+        vchShortId.resize(block.vtx.size() * SHORTID_SIZE);
+        for (std::size_t i = 0;i < block.vtx.size();i++)
+        {
+            uint64 nShortId = MakeShortId(k0,k1,block.vtx[i].GetHash());
+            for (int j = 0;j < SHORTID_SIZE;j++)
+            {
+                vchShortId[i * SHORTID_SIZE + j] = (uint8)(nShortId >> (j * 8));
+            }
+        }
+    }
+    bool IsValid() const
+    {
+        return (header.vtx.empty() && vchShortId.size() % SHORTID_SIZE == 0);
+    }
+    std::size_t GetTxCount() const
+    {
+        return (vchShortId.size() / SHORTID_SIZE);
+    }
+    uint64 GetShortId(std::size_t n) const
+    {
+        uint64 nShortId = 0;
+        for (int j = SHORTID_SIZE - 1;j >= 0;j--)
+        {
+            nShortId = (nShortId << 8) | vchShortId[n * SHORTID_SIZE + j];
+        }
+        return nShortId;
+    }
+    void GetShortIdKey(uint64& k0,uint64& k1) const
+    {
+        uint256 hashKey = multiverse::crypto::CryptoHash(header.GetHash(),uint256(nSalt));
+        k0 = hashKey.Get64(0);
+        k1 = hashKey.Get64(1);
+    }
+    static uint64 MakeShortId(uint64 k0,uint64 k1,const uint256& txid)
+    {
+        return (multiverse::crypto::CryptoSipHash(k0,k1,txid) & 0xffffffffffffULL);
+    }
+protected:
+    template <typename O>
+    void WalleveSerialize(walleve::CWalleveStream& s,O& opt)
+    {
+        s.Serialize(header,opt);
+        s.Serialize(nSalt,opt);
+        s.Serialize(vchShortId,opt);
+    }
+public:
+    CBlock header;
+    uint64 nSalt;
+    std::vector<uint8> vchShortId;
+};
+
+class CBlockTxnRequest
+{
+    friend class walleve::CWalleveStream;
+public:
+    CBlockTxnRequest() : hashBlock(0) {}
+protected:
+    template <typename O>
+    void WalleveSerialize(walleve::CWalleveStream& s,O& opt)
+    {
+        s.Serialize(hashBlock,opt);
+        s.Serialize(vIndex,opt);
+    }
+public:
+    uint256 hashBlock;
+    std::vector<uint32> vIndex;
+};
+
+class CBlockTxn
+{
+    friend class walleve::CWalleveStream;
+public:
+    CBlockTxn() : hashBlock(0) {}
+protected:
+    template <typename O>
+    void WalleveSerialize(walleve::CWalleveStream& s,O& opt)
+    {
+        s.Serialize(hashBlock,opt);
+        s.Serialize(vtx,opt);
+    }
+public:
+    uint256 hashBlock;
+    std::vector<CTransaction> vtx;
+};
+
 #endif //MULTIVERSE_BLOCK_H
 
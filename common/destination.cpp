@@ -4,6 +4,7 @@
 
 #include "destination.h"
 #include "template.h"
+#include "sigcache.h"
 #include <walleve/stream/datastream.h>
 
 using namespace std;
@@ -15,17 +16,29 @@ using namespace multiverse::crypto;
 
 bool CDestination::VerifySignature(const uint256& hash,const vector<unsigned char>& vchSig) const
 {
+    CSignatureCache& sigCache = CSignatureCache::GetInstance();
+    if (sigCache.Exists(hash,*this,vchSig))
+    {
+        return true;
+    }
+
+    bool fVerified = false;
     if (IsPubKey())
     {
-        return CPubKey(data).Verify(hash,vchSig);
+        fVerified = CPubKey(data).Verify(hash,vchSig);
     }
     else if (IsTemplate())
     {
         CTemplatePtr ptr = CTemplateGeneric::GetTemplatePtr(data,vchSig);
         if (ptr != NULL)
         {
-            return ptr->VerifyTxSignature(hash,vchSig);
+            fVerified = ptr->VerifyTxSignature(hash,vchSig);
         }
     }
-    return false;
+
+    if (fVerified)
+    {
+        sigCache.AddNew(hash,*this,vchSig);
+    }
+    return fVerified;
 }
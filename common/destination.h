@@ -135,5 +135,14 @@ protected:
     }
 };
 
+class CDestinationHasher
+{
+public:
+    std::size_t operator()(const CDestination& dest) const
+    {
+        return (std::size_t)multiverse::crypto::CryptoSaltedHash(dest.data,dest.prefix);
+    }
+};
+
 #endif //MULTIVERSE_DESTINATION_H
 
@@ -0,0 +1,89 @@
+// Copyright (c) 2017-2018 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "sigcache.h"
+#include "crypto.h"
+
+using namespace std;
+using namespace multiverse::crypto;
+
+//////////////////////////////
+// CSignatureCache
+
+CSignatureCache::CSignatureCache(size_t nMaxCountIn)
+: nMaxCount(nMaxCountIn),nHit(0),nMiss(0)
+{
+    CryptoGetRand256(nSalt);
+}
+
+bool CSignatureCache::Exists(const uint256& hash,const CDestination& dest,const vector<unsigned char>& vchSig)
+{
+    uint256 entry = GetEntry(hash,dest,vchSig);
+    bool fFound = false;
+    {
+        boost::shared_lock<boost::shared_mutex> rlock(rwAccess);
+        fFound = (setEntry.count(entry) || setPrevEntry.count(entry));
+    }
+    if (fFound)
+    {
+        nHit.fetch_add(1);
+    }
+    else
+    {
+        nMiss.fetch_add(1);
+    }
+    return fFound;
+}
+
+void CSignatureCache::AddNew(const uint256& hash,const CDestination& dest,const vector<unsigned char>& vchSig)
+{
+    uint256 entry = GetEntry(hash,dest,vchSig);
+    boost::unique_lock<boost::shared_mutex> wlock(rwAccess);
+    if (setEntry.count(entry) || setPrevEntry.count(entry))
+    {
+        return;
+    }
+    if (setEntry.size() >= max(nMaxCount / 2,(size_t)1))
+    {
+        setPrevEntry.swap(setEntry);
+        setEntry.clear();
+    }
+    setEntry.insert(entry);
+}
+
+void CSignatureCache::Clear()
+{
+    boost::unique_lock<boost::shared_mutex> wlock(rwAccess);
+    setEntry.clear();
+    setPrevEntry.clear();
+    nHit = 0;
+    nMiss = 0;
+}
+
+void CSignatureCache::GetStatus(CSignatureCacheStatus& status) const
+{
+    boost::shared_lock<boost::shared_mutex> rlock(rwAccess);
+    status.nCount = setEntry.size() + setPrevEntry.size();
+    status.nMaxCount = nMaxCount;
+    status.nHit = nHit.load();
+    status.nMiss = nMiss.load();
+}
+
+CSignatureCache& CSignatureCache::GetInstance()
+{
+    static CSignatureCache sigCache;
+    return sigCache;
+}
+
+uint256 CSignatureCache::GetEntry(const uint256& hash,const CDestination& dest,const vector<unsigned char>& vchSig) const
+{
+    vector<unsigned char> vch;
+    vch.reserve(sizeof(uint256) * 3 + 1 + vchSig.size());
+    vch.insert(vch.end(),nSalt.begin(),nSalt.end());
+    vch.insert(vch.end(),hash.begin(),hash.end());
+    vch.push_back(dest.prefix);
+    vch.insert(vch.end(),dest.data.begin(),dest.data.end());
+    vch.insert(vch.end(),vchSig.begin(),vchSig.end());
+    return CryptoHash(&vch[0],vch.size());
+}
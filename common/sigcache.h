@@ -0,0 +1,49 @@
+// Copyright (c) 2017-2018 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef  MULTIVERSE_SIGCACHE_H
+#define  MULTIVERSE_SIGCACHE_H
+
+#include "uint256.h"
+#include "destination.h"
+
+#include <set>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+
+class CSignatureCacheStatus
+{
+public:
+    std::size_t nCount;
+    std::size_t nMaxCount;
+    uint64 nHit;
+    uint64 nMiss;
+};
+
+class CSignatureCache
+{
+public:
+    enum { DEFAULT_MAX_COUNT = 1024 * 64 };
+    CSignatureCache(std::size_t nMaxCountIn = DEFAULT_MAX_COUNT);
+    bool Exists(const uint256& hash,const CDestination& dest,const std::vector<unsigned char>& vchSig);
+    void AddNew(const uint256& hash,const CDestination& dest,const std::vector<unsigned char>& vchSig);
+    void Clear();
+    void GetStatus(CSignatureCacheStatus& status) const;
+    static CSignatureCache& GetInstance();
+protected:
+    uint256 GetEntry(const uint256& hash,const CDestination& dest,const std::vector<unsigned char>& vchSig) const;
+protected:
+    mutable boost::shared_mutex rwAccess;
+    uint256 nSalt;
+    std::size_t nMaxCount;
+    // two generations of up to nMaxCount / 2 entries, the older one is dropped as a whole
+    // when the newer one is full, so the latest entries always survive an eviction
+    std::set<uint256> setEntry;
+    std::set<uint256> setPrevEntry;
+    boost::atomic<uint64> nHit;
+    boost::atomic<uint64> nMiss;
+};
+
+#endif //MULTIVERSE_SIGCACHE_H
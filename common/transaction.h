@@ -46,6 +46,15 @@ protected:
     }
 };
 
+class CTxOutPointHasher
+{
+public:
+    std::size_t operator()(const CTxOutPoint& out) const 
+    { 
+        return (std::size_t)multiverse::crypto::CryptoSaltedHash(out.hash,out.n);
+    }
+};
+
 class CTxIn
 {
     friend class walleve::CWalleveStream;
@@ -103,6 +112,7 @@ public:
         nTxFee = 0;
         vchData.clear();
         vchSig.clear();
+        InvalidateHash();
     }
     bool IsNull() const
     {
@@ -123,15 +133,43 @@ public:
     }
     uint256 GetHash() const
     {
-        walleve::CWalleveBufStream ss;
-        ss << (*this);
-        return multiverse::crypto::CryptoHash(ss.GetData(),ss.GetSize());
+        if (!fHashCached)
+        {
+            multiverse::crypto::CCryptoHashStream ss;
+            ss << (*this);
+            nSizeCached = ss.GetSize();
+            hashCached = ss.GetHash();
+            fHashCached = true;
+        }
+        return hashCached;
+    }
+    // Serialized size, comes for free with the tx hash
+    std::size_t GetSerializedSize() const
+    {
+        GetHash();
+        return nSizeCached;
+    }
+    // Fee per 1000 bytes of serialized tx
+    int64 GetFeeRate() const
+    {
+        return (nTxFee * 1000 / (int64)GetSerializedSize());
     }
     uint256 GetSignatureHash() const
     {
-        walleve::CWalleveBufStream ss;
-        ss << nVersion << nType << nLockUntil << hashAnchor << vInput << sendTo << nAmount << nTxFee << vchData;
-        return multiverse::crypto::CryptoHash(ss.GetData(),ss.GetSize());
+        if (!fSigHashCached)
+        {
+            multiverse::crypto::CCryptoHashStream ss;
+            ss << nVersion << nType << nLockUntil << hashAnchor << vInput << sendTo << nAmount << nTxFee << vchData;
+            hashSigCached = ss.GetHash();
+            fSigHashCached = true;
+        }
+        return hashSigCached;
+    }
+    // Must be called after modifying any field of a tx which was already hashed
+    void InvalidateHash()
+    {
+        fHashCached = false;
+        fSigHashCached = false;
     }
 
     int64 GetChange(int64 nValueIn) const
@@ -169,7 +207,20 @@ protected:
         s.Serialize(nTxFee,opt);
         s.Serialize(vchData,opt);
         s.Serialize(vchSig,opt);
+        InvalidateHash(opt);
+    }
+    void InvalidateHash(walleve::LoadType&)
+    {
+        InvalidateHash();
     }
+    template <typename O>
+    void InvalidateHash(O&) {}
+protected:
+    mutable uint256 hashCached;
+    mutable uint256 hashSigCached;
+    mutable std::size_t nSizeCached;
+    mutable bool fHashCached;
+    mutable bool fSigHashCached;
 };
 
 class CTxOutput
@@ -0,0 +1,25 @@
+// Copyright (c) 2017-2018 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef  MULTIVERSE_CRC32C_H
+#define  MULTIVERSE_CRC32C_H
+
+#include <cstddef>
+
+namespace multiverse
+{
+namespace crypto
+{
+
+// CRC-32C (Castagnoli) cyclic redundancy checksum
+// polynomial : 0x1EDC6F41 (reflected 0x82F63B78)
+// uses the SSE4.2 crc32 instruction when the cpu supports it
+
+unsigned int crc32c(const void* data,std::size_t size,unsigned int crc = 0);
+bool crc32c_accelerated();
+
+} // namespace crypto
+} // namespace multiverse
+
+#endif //MULTIVERSE_CRC32C_H
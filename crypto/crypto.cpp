@@ -101,6 +101,248 @@ uint256 CryptoHash(const uint256& h1,const uint256& h2)
     return hash;
 }
 
+/* BLAKE2b-256 of HASH_LANES independent 64 bytes messages at once. A 64 bytes message 
+   is a single compression, so the whole hash is done here with the state laid out 
+   lane by lane, which lets the compiler keep every lane in one vector register */
+enum { HASH_LANES = 4 };
+
+static const uint64 blake2bIV[8] = 
+{
+    0x6a09e667f3bcc908ULL,0xbb67ae8584caa73bULL,0x3c6ef372fe94f82bULL,0xa54ff53a5f1d36f1ULL,
+    0x510e527fade682d1ULL,0x9b05688c2b3e6c1fULL,0x1f83d9abfb41bd6bULL,0x5be0cd19137e2179ULL
+};
+
+static const uint8 blake2bSigma[12][16] =
+{
+    { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14,15},
+    {14,10, 4, 8, 9,15,13, 6, 1,12, 0, 2,11, 7, 5, 3},
+    {11, 8,12, 0, 5, 2,15,13,10,14, 3, 6, 7, 1, 9, 4},
+    { 7, 9, 3, 1,13,12,11,14, 2, 6, 5,10, 4, 0,15, 8},
+    { 9, 0, 5, 7, 2, 4,10,15,14, 1,11,12, 6, 8, 3,13},
+    { 2,12, 6,10, 0,11, 8, 3, 4,13, 7, 5,15,14, 1, 9},
+    {12, 5, 1,15,14,13, 4,10, 0, 7, 6, 3, 9, 2, 8,11},
+    {13,11, 7,14,12, 1, 3, 9, 5, 0,15, 4, 8, 6, 2,10},
+    { 6,15,14, 9,11, 3, 0, 8,12, 2,13, 7, 1, 4,10, 5},
+    {10, 2, 8, 4, 7, 6, 1, 5,15,11, 9,14, 3,12,13, 0},
+    { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14,15},
+    {14,10, 4, 8, 9,15,13, 6, 1,12, 0, 2,11, 7, 5, 3}
+};
+
+static inline uint64 Blake2bLoad64(const uint8* p)
+{
+    uint64 w = 0;
+    for (int i = 7;i >= 0;i--)
+    {
+        w = (w << 8) | p[i];
+    }
+    return w;
+}
+
+static inline void Blake2bStore64(uint8* p,uint64 w)
+{
+    for (int i = 0;i < 8;i++)
+    {
+        p[i] = (uint8)(w >> (i * 8));
+    }
+}
+
+static inline void Blake2bG(uint64 v[16][HASH_LANES],int a,int b,int c,int d,
+                            const uint64 x[HASH_LANES],const uint64 y[HASH_LANES])
+{
+    for (int l = 0;l < HASH_LANES;l++)
+    {
+        v[a][l] = v[a][l] + v[b][l] + x[l];
+        v[d][l] = ((v[d][l] ^ v[a][l]) >> 32) | ((v[d][l] ^ v[a][l]) << 32);
+        v[c][l] = v[c][l] + v[d][l];
+        v[b][l] = ((v[b][l] ^ v[c][l]) >> 24) | ((v[b][l] ^ v[c][l]) << 40);
+        v[a][l] = v[a][l] + v[b][l] + y[l];
+        v[d][l] = ((v[d][l] ^ v[a][l]) >> 16) | ((v[d][l] ^ v[a][l]) << 48);
+        v[c][l] = v[c][l] + v[d][l];
+        v[b][l] = ((v[b][l] ^ v[c][l]) >> 63) | ((v[b][l] ^ v[c][l]) << 1);
+    }
+}
+
+static void Blake2b64Lanes(const uint8* pLeft[HASH_LANES],const uint8* pRight[HASH_LANES],uint8* pOut[HASH_LANES])
+{
+    uint64 m[16][HASH_LANES];
+    uint64 v[16][HASH_LANES];
+    uint64 h0 = blake2bIV[0] ^ 0x01010000ULL ^ 32;
+
+    for (int i = 0;i < 4;i++)
+    {
+        for (int l = 0;l < HASH_LANES;l++)
+        {
+            m[i][l] = Blake2bLoad64(pLeft[l] + i * 8);
+            m[i + 4][l] = Blake2bLoad64(pRight[l] + i * 8);
+        }
+    }
+    for (int i = 8;i < 16;i++)
+    {
+        for (int l = 0;l < HASH_LANES;l++)
+        {
+            m[i][l] = 0;
+        }
+    }
+    for (int l = 0;l < HASH_LANES;l++)
+    {
+        v[0][l] = h0;
+        for (int i = 1;i < 8;i++)
+        {
+            v[i][l] = blake2bIV[i];
+        }
+        for (int i = 0;i < 8;i++)
+        {
+            v[i + 8][l] = blake2bIV[i];
+        }
+        // 64 bytes counted, last block
+        v[12][l] ^= 64;
+        v[14][l] = ~v[14][l];
+    }
+
+    for (int r = 0;r < 12;r++)
+    {
+        const uint8* s = blake2bSigma[r];
+        Blake2bG(v,0,4, 8,12,m[s[ 0]],m[s[ 1]]);
+        Blake2bG(v,1,5, 9,13,m[s[ 2]],m[s[ 3]]);
+        Blake2bG(v,2,6,10,14,m[s[ 4]],m[s[ 5]]);
+        Blake2bG(v,3,7,11,15,m[s[ 6]],m[s[ 7]]);
+        Blake2bG(v,0,5,10,15,m[s[ 8]],m[s[ 9]]);
+        Blake2bG(v,1,6,11,12,m[s[10]],m[s[11]]);
+        Blake2bG(v,2,7, 8,13,m[s[12]],m[s[13]]);
+        Blake2bG(v,3,4, 9,14,m[s[14]],m[s[15]]);
+    }
+
+    for (int l = 0;l < HASH_LANES;l++)
+    {
+        Blake2bStore64(pOut[l],h0 ^ v[0][l] ^ v[8][l]);
+        for (int i = 1;i < 4;i++)
+        {
+            Blake2bStore64(pOut[l] + i * 8,blake2bIV[i] ^ v[i][l] ^ v[i + 8][l]);
+        }
+    }
+}
+
+void CryptoHashMerkleLevel(const uint256* pChild,std::size_t nChild,uint256* pParent)
+{
+    std::size_t nParent = (nChild + 1) / 2;
+    uint256 hashDiscard[HASH_LANES];
+    for (std::size_t n = 0;n < nParent;n += HASH_LANES)
+    {
+        const uint8* pLeft[HASH_LANES];
+        const uint8* pRight[HASH_LANES];
+        uint8* pOut[HASH_LANES];
+        for (int l = 0;l < HASH_LANES;l++)
+        {
+            // unused lanes repeat the last pair and write to a scratch slot
+            std::size_t i = std::min(n + l,nParent - 1) * 2;
+            pLeft[l] = pChild[i].begin();
+            pRight[l] = pChild[std::min(i + 1,nChild - 1)].begin();
+            pOut[l] = (n + l < nParent ? pParent[n + l].begin() : hashDiscard[l].begin());
+        }
+        Blake2b64Lanes(pLeft,pRight,pOut);
+    }
+}
+
+//////////////////////////////
+// Salted hash
+
+static const uint64 nSaltK0 = CryptoGetRand64();
+static const uint64 nSaltK1 = CryptoGetRand64();
+
+static inline uint64 SipRotl(uint64 x,int b)
+{
+    return ((x << b) | (x >> (64 - b)));
+}
+
+static inline void SipRound(uint64& v0,uint64& v1,uint64& v2,uint64& v3)
+{
+    v0 += v1; v1 = SipRotl(v1,13); v1 ^= v0; v0 = SipRotl(v0,32);
+    v2 += v3; v3 = SipRotl(v3,16); v3 ^= v2;
+    v0 += v3; v3 = SipRotl(v3,21); v3 ^= v0;
+    v2 += v1; v1 = SipRotl(v1,17); v1 ^= v2; v2 = SipRotl(v2,32);
+}
+
+uint64 CryptoSipHash(uint64 k0,uint64 k1,const uint256& hash,uint32 nExtra)
+{
+    uint64 v0 = 0x736f6d6570736575ULL ^ k0;
+    uint64 v1 = 0x646f72616e646f6dULL ^ k1;
+    uint64 v2 = 0x6c7967656e657261ULL ^ k0;
+    uint64 v3 = 0x7465646279746573ULL ^ k1;
+    for (int i = 0;i < 4;i++)
+    {
+        uint64 m = hash.Get64(i);
+        v3 ^= m;
+        SipRound(v0,v1,v2,v3);
+        SipRound(v0,v1,v2,v3);
+        v0 ^= m;
+    }
+    // 36 bytes message, the extra word is the last block
+    uint64 m = (((uint64)36) << 56) | nExtra;
+    v3 ^= m;
+    SipRound(v0,v1,v2,v3);
+    SipRound(v0,v1,v2,v3);
+    v0 ^= m;
+    v2 ^= 0xFF;
+    SipRound(v0,v1,v2,v3);
+    SipRound(v0,v1,v2,v3);
+    SipRound(v0,v1,v2,v3);
+    SipRound(v0,v1,v2,v3);
+    return (v0 ^ v1 ^ v2 ^ v3);
+}
+
+uint64 CryptoSaltedHash(const uint256& hash,uint32 nExtra)
+{
+    return CryptoSipHash(nSaltK0,nSaltK1,hash,nExtra);
+}
+
+//////////////////////////////
+// CCryptoHashStream
+
+static_assert(sizeof(crypto_generichash_blake2b_state) <= 384,"blake2b state does not fit CCryptoHashStream");
+
+CCryptoHashStream::CCryptoHashStream()
+: walleve::CWalleveStream(NULL),nTotal(0)
+{
+    crypto_generichash_blake2b_init((crypto_generichash_blake2b_state*)state,NULL,0,sizeof(uint256));
+    fPutSpan = true;
+    pPutCur = (char*)buffer;
+    pPutEnd = (char*)buffer + BUFFER_SIZE;
+}
+
+uint256 CCryptoHashStream::GetHash()
+{
+    uint256 hash;
+    Flush();
+    crypto_generichash_blake2b_final((crypto_generichash_blake2b_state*)state,hash.begin(),sizeof(hash));
+    return hash;
+}
+
+void CCryptoHashStream::WriteOverflow(const char *s,std::size_t n)
+{
+    Flush();
+    if (n < BUFFER_SIZE)
+    {
+        std::memcpy(pPutCur,s,n);
+        pPutCur += n;
+    }
+    else
+    {
+        crypto_generichash_blake2b_update((crypto_generichash_blake2b_state*)state,(const uint8*)s,n);
+        nTotal += n;
+    }
+}
+
+void CCryptoHashStream::Flush()
+{
+    std::size_t n = pPutCur - (char*)buffer;
+    if (n != 0)
+    {
+        crypto_generichash_blake2b_update((crypto_generichash_blake2b_state*)state,buffer,n);
+        nTotal += n;
+        pPutCur = (char*)buffer;
+    }
+}
+
 //////////////////////////////
 // Sign & verify
 
@@ -130,6 +372,22 @@ bool CryptoVerify(const uint256& pubkey,const void* md,std::size_t len,const std
             && !crypto_sign_ed25519_verify_detached(&vchSig[0],(const uint8*)md,len,(uint8*)&pubkey));
 }
 
+// Not a batched equation : every item is checked with the same cofactorless
+// equation as CryptoVerify. A random linear combination would accept signatures
+// with small order components that a single check rejects
+bool CryptoVerifyEach(const std::vector<CCryptoVerifyItem>& vItem,std::vector<bool>& vValid)
+{
+    bool fAllValid = true;
+    vValid.assign(vItem.size(),false);
+    for (std::size_t i = 0;i < vItem.size();i++)
+    {
+        const CCryptoVerifyItem& item = vItem[i];
+        vValid[i] = CryptoVerify(item.pubkey,&item.hash,sizeof(item.hash),item.vchSig);
+        fAllValid = (fAllValid && vValid[i]);
+    }
+    return fAllValid;
+}
+
 // Encrypt
 void CryptoKeyFromPassphrase(int version,const CCryptoString& passphrase,const uint256& salt,CCryptoKeyData& key)
 {
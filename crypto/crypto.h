@@ -7,6 +7,7 @@
 
 #include "uint256.h"
 
+#include <walleve/stream/stream.h>
 #include <stdexcept>
 #include <memory>
 #include <string>
@@ -73,6 +74,36 @@ void CryptoGetRand256(uint256& u);
 // Hash
 uint256 CryptoHash(const void* msg,std::size_t len);
 uint256 CryptoHash(const uint256& h1,const uint256& h2);
+// pParent[i] = CryptoHash(pChild[2i],pChild[min(2i+1,nChild-1)]) for every parent of a merkle level
+void CryptoHashMerkleLevel(const uint256* pChild,std::size_t nChild,uint256* pParent);
+
+// SipHash-2-4 of a uint256 and an extra word
+uint64 CryptoSipHash(uint64 k0,uint64 k1,const uint256& hash,uint32 nExtra = 0);
+// Salted hash for hash tables, SipHash-2-4 keyed by a random per process salt
+uint64 CryptoSaltedHash(const uint256& hash,uint32 nExtra = 0);
+
+class CCryptoSaltedHasher
+{
+public:
+    std::size_t operator()(const uint256& hash) const { return (std::size_t)CryptoSaltedHash(hash); }
+};
+
+// Hash sink, objects serialized into it are fed to the hash without materializing the bytes
+class CCryptoHashStream : public walleve::CWalleveStream
+{
+public:
+    CCryptoHashStream();
+    uint256 GetHash();
+    std::size_t GetSize() { return (nTotal + (pPutCur - (char*)buffer)); }
+protected:
+    void WriteOverflow(const char *s,std::size_t n);
+    void Flush();
+protected:
+    enum {STATE_SIZE = 384,BUFFER_SIZE = 256};
+    alignas(64) unsigned char state[STATE_SIZE];
+    unsigned char buffer[BUFFER_SIZE];
+    std::size_t nTotal;
+};
 
 // Sign & verify
 struct CCryptoKey
@@ -86,6 +117,19 @@ uint256 CryptoImportKey(CCryptoKey& key,const uint256& secret);
 void CryptoSign(CCryptoKey& key,const void* md,std::size_t len,std::vector<uint8>& vchSig);
 bool CryptoVerify(const uint256& pubkey,const void* md,std::size_t len,const std::vector<uint8>& vchSig);
 
+// Verify a list of signatures, result per item
+struct CCryptoVerifyItem
+{
+    CCryptoVerifyItem() {}
+    CCryptoVerifyItem(const uint256& pubkeyIn,const uint256& hashIn,const std::vector<uint8>& vchSigIn)
+    : pubkey(pubkeyIn),hash(hashIn),vchSig(vchSigIn) {}
+    uint256 pubkey;
+    uint256 hash;
+    std::vector<uint8> vchSig;
+};
+
+bool CryptoVerifyEach(const std::vector<CCryptoVerifyItem>& vItem,std::vector<bool>& vValid);
+
 // Encrypt
 struct CCryptoCipher
 {
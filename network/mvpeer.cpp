@@ -10,12 +10,83 @@ using namespace std;
 using namespace walleve;
 using namespace multiverse::network;
 
+// block and tx payloads are hashed anyway by validation
+static bool IsChecksumExempt(bool fFastChecksum,int nChannel,int nCommand)
+{
+    return (fFastChecksum && nChannel == MVPROTO_CHN_DATA
+            && (nCommand == MVPROTO_CMD_BLOCK || nCommand == MVPROTO_CMD_TX));
+}
+
+static uint32 GetPayloadChecksum(bool fFastChecksum,const char* pPrefix,size_t nPrefixSize,
+                                                    const char* pPayload,size_t nPayloadSize)
+{
+    if (fFastChecksum)
+    {
+        return multiverse::crypto::crc32c(pPayload,nPayloadSize,multiverse::crypto::crc32c(pPrefix,nPrefixSize));
+    }
+    if (nPrefixSize == 0)
+    {
+        return multiverse::crypto::CryptoHash(pPayload,nPayloadSize).Get32();
+    }
+    multiverse::crypto::CCryptoHashStream hs;
+    hs.Write(pPrefix,nPrefixSize).Write(pPayload,nPayloadSize);
+    return hs.GetHash().Get32();
+}
+
+//////////////////////////////
+// CMvPeerFrame
+
+void CMvPeerFrame::Reset()
+{
+    ssRecv.Clear();
+    ssRaw.Clear();
+    fHeader = false;
+    fValid = false;
+}
+
+bool CMvPeerFrame::Decode(size_t& nNext)
+{
+    nNext = 0;
+    try
+    {
+        if (!fHeader)
+        {
+            ssRecv >> hdrRecv;
+            // Verify bounds nPayloadSize before it sizes the payload read
+            if (hdrRecv.nMagic != nMsgMagic || !hdrRecv.Verify())
+            {
+                return false;
+            }
+            fHeader = true;
+            if (hdrRecv.nPayloadSize != 0)
+            {
+                nNext = hdrRecv.nPayloadSize;
+                return true;
+            }
+        }
+        if (!IsChecksumExempt(fFastChecksum,hdrRecv.GetChannel(),hdrRecv.GetCommand())
+            && hdrRecv.nPayloadChecksum != GetPayloadChecksum(fFastChecksum,NULL,0,ssRecv.GetData(),ssRecv.GetSize()))
+        {
+            return false;
+        }
+        if (hdrRecv.IsCompressed() && !DecompressPayload(ssRecv.GetData(),ssRecv.GetSize(),ssRaw))
+        {
+            return false;
+        }
+        fValid = true;
+        return true;
+    }
+    catch (...) {}
+    return false;
+}
+
 //////////////////////////////
 // CMvPeer
 
 CMvPeer::CMvPeer(CPeerNet *pPeerNetIn, CIOClient* pClientIn,uint64 nNonceIn,
                      bool fInBoundIn,uint32 nMsgMagicIn,uint32 nHsTimerIdIn)
-: CPeer(pPeerNetIn,pClientIn,nNonceIn,fInBoundIn),nMsgMagic(nMsgMagicIn),nHsTimerId(nHsTimerIdIn)
+: CPeer(pPeerNetIn,pClientIn,nNonceIn,fInBoundIn),nMsgMagic(nMsgMagicIn),nHsTimerId(nHsTimerIdIn),fFastChecksum(false),
+  spFrame(new CMvPeerFrame(nMsgMagicIn))
 {   
 }   
     
@@ -34,8 +105,20 @@ void CMvPeer::Activate()
     nTimeHello = 0;
     strSubVer.clear();
     nStartingHeight = 0;
+    fFastChecksum = false;
+    spFrame->fFastChecksum = false;
 
-    Read(MESSAGE_HEADER_SIZE,boost::bind(&CMvPeer::HandshakeReadHeader,this));
+    for (int i = 0;i < MESSAGE_PRIORITY_COUNT;i++)
+    {
+        queSend[i].clear();
+    }
+    nSendQueueSize = 0;
+    nSendDropped = 0;
+    nUploadAllowance = ((CMvPeerNet*)pPeerNet)->GetUploadRate();
+    nUploadTime = GetTimeMillis();
+    mapTraffic.clear();
+
+    ReadMessage(boost::bind(&CMvPeer::HandshakeReadCompletd,this));
     if (!fInBound)
     {
         SendHello();
@@ -47,25 +130,119 @@ bool CMvPeer::IsHandshaked()
     return (nHsTimerId == 0);
 }
 
-bool CMvPeer::SendMessage(int nChannel,int nCommand,CWalleveBufStream& ssPayload)
+bool CMvPeer::IsCompressible()
+{
+    return (IsHandshaked() && (nService & NODE_COMPRESS) && (((CMvPeerNet*)pPeerNet)->GetService() & NODE_COMPRESS));
+}
+
+bool CMvPeer::IsFastChecksum()
+{
+    return ((nService & NODE_CRC32C) && (((CMvPeerNet*)pPeerNet)->GetService() & NODE_CRC32C));
+}
+
+bool CMvPeer::SendMessage(int nChannel,int nCommand,const char* pPrefix,size_t nPrefixSize,
+                                                   const char* pPayload,size_t nPayloadSize)
 {
     CMvPeerMessageHeader hdrSend;    
     hdrSend.nMagic = nMsgMagic;
     hdrSend.nType  = CMvPeerMessageHeader::GetMessageType(nChannel,nCommand);
-    hdrSend.nPayloadSize = ssPayload.GetSize();
-    hdrSend.nPayloadChecksum = multiverse::crypto::CryptoHash(ssPayload.GetData(),ssPayload.GetSize()).Get32();
+
+    // the payload goes out as prefix + body, joined only when it is compressed
+    vector<char> vCompressed;
+    if (nPrefixSize + nPayloadSize >= MESSAGE_COMPRESS_MIN_SIZE && IsCompressible())
+    {
+        vector<char> vJoined;
+        if (nPrefixSize != 0)
+        {
+            vJoined.reserve(nPrefixSize + nPayloadSize);
+            vJoined.insert(vJoined.end(),pPrefix,pPrefix + nPrefixSize);
+            vJoined.insert(vJoined.end(),pPayload,pPayload + nPayloadSize);
+        }
+        if (nPrefixSize != 0 ? CompressPayload(&vJoined[0],vJoined.size(),vCompressed)
+                             : CompressPayload(pPayload,nPayloadSize,vCompressed))
+        {
+            hdrSend.nType |= MESSAGE_COMPRESSED;
+            pPrefix = NULL;
+            nPrefixSize = 0;
+            pPayload = &vCompressed[0];
+            nPayloadSize = vCompressed.size();
+        }
+    }
+
+    hdrSend.nPayloadSize = nPrefixSize + nPayloadSize;
+    if (!IsChecksumExempt(fFastChecksum,nChannel,nCommand))
+    {
+        hdrSend.nPayloadChecksum = GetPayloadChecksum(fFastChecksum,pPrefix,nPrefixSize,pPayload,nPayloadSize);
+    }
+    else
+    {
+        hdrSend.nPayloadChecksum = 0;
+    }
     hdrSend.nHeaderChecksum = hdrSend.GetHeaderChecksum();
 
     if (!hdrSend.Verify())
     {
         return false;
     }
-    
-    WriteStream() << hdrSend << ssPayload;
-    Write();
+
+    size_t nSize = MESSAGE_HEADER_SIZE + nPrefixSize + nPayloadSize;
+    if (nSendQueueSize == 0 && WriteStream().GetSize() < MESSAGE_SENDBUFFER_SIZE && IsUploadAllowed())
+    {
+        WriteStream() << hdrSend;
+        WriteStream().Write(pPrefix,nPrefixSize);
+        WriteStream().Write(pPayload,nPayloadSize);
+        CommitSend(nChannel,nCommand,nSize);
+        Write();
+        return true;
+    }
+
+    int nPriority = GetMessagePriority(nChannel,nCommand);
+    if (!EnqueueMessage(nPriority,nSize))
+    {
+        nSendDropped++;
+        return false;
+    }
+
+    CWalleveBufStream ssHeader;
+    ssHeader << hdrSend;
+    queSend[nPriority].push_back(CSendItem());
+    CSendItem& item = queSend[nPriority].back();
+    item.nChannel = nChannel;
+    item.nCommand = nCommand;
+    item.vData.reserve(nSize);
+    item.vData.insert(item.vData.end(),ssHeader.GetData(),ssHeader.GetData() + ssHeader.GetSize());
+    item.vData.insert(item.vData.end(),pPrefix,pPrefix + nPrefixSize);
+    item.vData.insert(item.vData.end(),pPayload,pPayload + nPayloadSize);
+    nSendQueueSize += nSize;
+
+    ((CMvPeerNet*)pPeerNet)->HandlePeerSendBacklog(this);
     return true;
 }
 
+bool CMvPeer::FlushSendQueue()
+{
+    bool fWrite = false;
+    while (nSendQueueSize != 0 && WriteStream().GetSize() < MESSAGE_SENDBUFFER_SIZE && IsUploadAllowed())
+    {
+        int nPriority = MESSAGE_PRIORITY_HIGH;
+        while (queSend[nPriority].empty())
+        {
+            nPriority++;
+        }
+        CSendItem& item = queSend[nPriority].front();
+        WriteStream().Write(&item.vData[0],item.vData.size());
+        CommitSend(item.nChannel,item.nCommand,item.vData.size());
+        nSendQueueSize -= item.vData.size();
+        queSend[nPriority].pop_front();
+        fWrite = true;
+    }
+    if (fWrite)
+    {
+        Write();
+    }
+    return (nSendQueueSize != 0);
+}
+
 uint32 CMvPeer::Request(CInv& inv,uint32 nTimerId)
 {
     uint32 nPrevTimerId = 0;
@@ -127,52 +304,84 @@ void CMvPeer::SendHelloAck()
     SendMessage(MVPROTO_CHN_NETWORK,MVPROTO_CMD_HELLO_ACK);
 }
 
-bool CMvPeer::ParseMessageHeader()
+int CMvPeer::GetMessagePriority(int nChannel,int nCommand)
 {
-    try
+    if (nChannel == MVPROTO_CHN_DATA)
     {
-        ReadStream() >> hdrRecv;
-        return (hdrRecv.nMagic == nMsgMagic || hdrRecv.Verify());
+        if (nCommand == MVPROTO_CMD_INV)
+        {
+            return MESSAGE_PRIORITY_LOW;
+        }
+        if (nCommand == MVPROTO_CMD_TX)
+        {
+            return MESSAGE_PRIORITY_NORMAL;
+        }
     }
-    catch (...) {}
-    return false;
+    return MESSAGE_PRIORITY_HIGH;
 }
 
-bool CMvPeer::HandshakeReadHeader()
+bool CMvPeer::EnqueueMessage(int nPriority,size_t nSize)
 {
-    if (!ParseMessageHeader())
+    // make room by dropping the newest messages of lower priority,
+    // a message never evicts one of its own or higher priority
+    for (int i = MESSAGE_PRIORITY_COUNT - 1;i > nPriority && nSendQueueSize + nSize > MESSAGE_SENDQUEUE_MAX_SIZE;i--)
     {
-        return false;
+        while (!queSend[i].empty() && nSendQueueSize + nSize > MESSAGE_SENDQUEUE_MAX_SIZE)
+        {
+            nSendQueueSize -= queSend[i].back().vData.size();
+            queSend[i].pop_back();
+            nSendDropped++;
+        }
     }
+    return (nSendQueueSize + nSize <= MESSAGE_SENDQUEUE_MAX_SIZE);
+}
 
-    if (hdrRecv.nPayloadSize != 0)
+bool CMvPeer::IsUploadAllowed()
+{
+    int64 nRate = ((CMvPeerNet*)pPeerNet)->GetUploadRate();
+    if (nRate == 0)
     {
-        Read(hdrRecv.nPayloadSize,boost::bind(&CMvPeer::HandshakeReadCompletd,this));
         return true;
     }
-    return HandshakeReadCompletd();
+    // token bucket holding at most one second of allowance, a large message
+    // may overdraw it and holds the queue until the debt is paid back
+    int64 nNow = GetTimeMillis();
+    nUploadAllowance = min(nUploadAllowance + (nNow - nUploadTime) * nRate / 1000,nRate);
+    nUploadTime = nNow;
+    return (nUploadAllowance > 0);
 }
 
-bool CMvPeer::HandleReadHeader()
+void CMvPeer::CommitSend(int nChannel,int nCommand,size_t nSize)
 {
-    if (!ParseMessageHeader())
-    {
-        return false;
-    }
+    CMvPeerTraffic& traffic = mapTraffic[make_pair(nChannel,nCommand)];
+    traffic.nMsgSent++;
+    traffic.nBytesSent += nSize;
+    nUploadAllowance -= nSize;
+}
 
-    if (hdrRecv.nPayloadSize != 0)
-    {
-        Read(hdrRecv.nPayloadSize,boost::bind(&CMvPeer::HandleReadCompleted,this));
-        return true;
-    }
-    return HandleReadCompleted();
+void CMvPeer::CommitRecv(int nChannel,int nCommand,size_t nSize)
+{
+    CMvPeerTraffic& traffic = mapTraffic[make_pair(nChannel,nCommand)];
+    traffic.nMsgRecv++;
+    traffic.nBytesRecv += nSize;
+}
+
+void CMvPeer::ReadMessage(CompltFunc fnComplt)
+{
+    spFrame->Reset();
+    ReadFrame(spFrame->ssRecv,MESSAGE_HEADER_SIZE,boost::bind(&CMvPeerFrame::Decode,spFrame,_1),fnComplt);
 }
 
 bool CMvPeer::HandshakeReadCompletd()
 {
-    CWalleveBufStream& ss = ReadStream();
-    uint256 hash = multiverse::crypto::CryptoHash(ss.GetData(),ss.GetSize());
-    if (hdrRecv.nPayloadChecksum == hash.Get32() && hdrRecv.GetChannel() == MVPROTO_CHN_NETWORK)
+    const CMvPeerMessageHeader& hdrRecv = spFrame->hdrRecv;
+    if (!spFrame->fValid)
+    {
+        return false;
+    }
+    CWalleveBufStream& ss = spFrame->GetPayload();
+    CommitRecv(hdrRecv.GetChannel(),hdrRecv.GetCommand(),MESSAGE_HEADER_SIZE + hdrRecv.nPayloadSize);
+    if (hdrRecv.GetChannel() == MVPROTO_CHN_NETWORK)
     {
         int64 nTimeRecv = GetTime();
         int nCmd = hdrRecv.GetCommand();
@@ -194,7 +403,7 @@ bool CMvPeer::HandshakeReadCompletd()
                     return HandshakeCompletd();
                 }
                 SendHello();
-                Read(MESSAGE_HEADER_SIZE,boost::bind(&CMvPeer::HandshakeReadHeader,this));
+                ReadMessage(boost::bind(&CMvPeer::HandshakeReadCompletd,this));
                 return true;
             }
             else if (nCmd == MVPROTO_CMD_HELLO_ACK && fInBound)
@@ -214,32 +423,38 @@ bool CMvPeer::HandshakeReadCompletd()
 
 bool CMvPeer::HandshakeCompletd()
 {
+    // hello and hello-ack always carry blake2b, both sides switch right after
+    // the last handshake message, before the handshaked hook can send anything
+    fFastChecksum = IsFastChecksum();
+    spFrame->fFastChecksum = fFastChecksum;
     if (!((CMvPeerNet*)pPeerNet)->HandlePeerHandshaked(this,nHsTimerId))
     {
         return false;
     }
     nHsTimerId = 0;
-    Read(MESSAGE_HEADER_SIZE,boost::bind(&CMvPeer::HandleReadHeader,this)); 
+    ReadMessage(boost::bind(&CMvPeer::HandleReadCompleted,this)); 
     return true;
 }
 
 bool CMvPeer::HandleReadCompleted()
 {
-    CWalleveBufStream& ss = ReadStream();
-    uint256 hash = multiverse::crypto::CryptoHash(ss.GetData(),ss.GetSize());
-    if (hdrRecv.nPayloadChecksum == hash.Get32())
+    // framing, checksum and decompression were done on the connection strand
+    const CMvPeerMessageHeader& hdrRecv = spFrame->hdrRecv;
+    if (!spFrame->fValid)
     {
-        try
+        return false;
+    }
+    CommitRecv(hdrRecv.GetChannel(),hdrRecv.GetCommand(),MESSAGE_HEADER_SIZE + hdrRecv.nPayloadSize);
+    try
+    {
+        if (((CMvPeerNet*)pPeerNet)->HandlePeerRecvMessage(this,hdrRecv.GetChannel(),hdrRecv.GetCommand(),
+                                                           spFrame->GetPayload()))
         {
-            if (((CMvPeerNet*)pPeerNet)->HandlePeerRecvMessage(this,hdrRecv.GetChannel(),hdrRecv.GetCommand(),ss))
-            {
-                Read(MESSAGE_HEADER_SIZE,boost::bind(&CMvPeer::HandleReadHeader,this));
-                return true;
-            }
+            ReadMessage(boost::bind(&CMvPeer::HandleReadCompleted,this));
+            return true;
         }
-        catch (...)
-        {}
     }
+    catch (...)
+    {}
     return false;
 }
-
@@ -15,6 +15,36 @@ namespace multiverse
 namespace network
 {
 
+class CMvPeerTraffic
+{
+public:
+    CMvPeerTraffic() : nMsgSent(0),nBytesSent(0),nMsgRecv(0),nBytesRecv(0) {}
+public:
+    uint64 nMsgSent;
+    uint64 nBytesSent;
+    uint64 nMsgRecv;
+    uint64 nBytesRecv;
+};
+
+// Framing of received messages. Header, payload checksum and decompression are done
+// on the connection strand, the pending read shares the frame so it outlives the peer
+class CMvPeerFrame
+{
+public:
+    CMvPeerFrame(uint32 nMsgMagicIn) : nMsgMagic(nMsgMagicIn),fFastChecksum(false),fHeader(false),fValid(false) {}
+    void Reset();
+    bool Decode(std::size_t& nNext);
+    walleve::CWalleveBufStream& GetPayload() { return (hdrRecv.IsCompressed() ? ssRaw : ssRecv); }
+public:
+    uint32 nMsgMagic;
+    bool fFastChecksum;
+    bool fHeader;
+    bool fValid;
+    CMvPeerMessageHeader hdrRecv;
+    walleve::CWalleveBufStream ssRecv;
+    walleve::CWalleveBufStream ssRaw;
+};
+
 class CMvPeer : public walleve::CPeer
 {
 public:
@@ -23,12 +53,26 @@ public:
     ~CMvPeer();
     void Activate();
     bool IsHandshaked();
-    bool SendMessage(int nChannel,int nCommand,walleve::CWalleveBufStream& ssPayload);
+    bool IsCompressible();
+    bool IsFastChecksum();
+    bool SendMessage(int nChannel,int nCommand,const char* pPrefix,std::size_t nPrefixSize,
+                                               const char* pPayload,std::size_t nPayloadSize);
+    bool SendMessage(int nChannel,int nCommand,const char* pPayload,std::size_t nPayloadSize)
+    {
+        return SendMessage(nChannel,nCommand,NULL,0,pPayload,nPayloadSize);
+    }
+    bool SendMessage(int nChannel,int nCommand,walleve::CWalleveBufStream& ssPayload)
+    {
+        return SendMessage(nChannel,nCommand,ssPayload.GetData(),ssPayload.GetSize());
+    }
     bool SendMessage(int nChannel,int nCommand)
     {
-        walleve::CWalleveBufStream ssPayload;
-        return SendMessage(nChannel,nCommand,ssPayload);
+        return SendMessage(nChannel,nCommand,NULL,0);
     }
+    bool FlushSendQueue();
+    std::size_t GetSendQueueSize() const { return nSendQueueSize; }
+    uint64 GetSendDropped() const { return nSendDropped; }
+    const std::map<std::pair<int,int>,CMvPeerTraffic>& GetTraffic() const { return mapTraffic; }
     uint32 Request(CInv& inv,uint32 nTimerId);
     uint32 Responded(CInv& inv);
     void AskFor(const uint256& hashFork,std::vector<CInv>& vInv);
@@ -36,12 +80,15 @@ public:
 protected:
     void SendHello();
     void SendHelloAck();
-    bool ParseMessageHeader();
-    bool HandshakeReadHeader();
+    void ReadMessage(CompltFunc fnComplt);
     bool HandshakeReadCompletd();
     bool HandshakeCompletd();
-    bool HandleReadHeader();
     bool HandleReadCompleted();
+    int GetMessagePriority(int nChannel,int nCommand);
+    bool EnqueueMessage(int nPriority,std::size_t nSize);
+    bool IsUploadAllowed();
+    void CommitSend(int nChannel,int nCommand,std::size_t nSize);
+    void CommitRecv(int nChannel,int nCommand,std::size_t nSize);
 public:
     int nVersion;
     uint64 nService;
@@ -53,10 +100,26 @@ public:
 protected:
     uint32 nMsgMagic;
     uint32 nHsTimerId;
-    CMvPeerMessageHeader hdrRecv;
+    bool fFastChecksum;
+    boost::shared_ptr<CMvPeerFrame> spFrame;
 
     std::map<CInv,uint32> mapRequest;
     std::queue<std::pair<uint256,CInv> > queAskFor;
+
+    class CSendItem
+    {
+    public:
+        int nChannel;
+        int nCommand;
+        std::vector<char> vData;
+    };
+    // messages waiting for the socket, served by priority then in order
+    std::deque<CSendItem> queSend[MESSAGE_PRIORITY_COUNT];
+    std::size_t nSendQueueSize;
+    uint64 nSendDropped;
+    int64 nUploadAllowance;
+    int64 nUploadTime;
+    std::map<std::pair<int,int>,CMvPeerTraffic> mapTraffic;
 };
 
 class CMvPeerInfo : public walleve::CPeerInfo
@@ -66,6 +129,9 @@ public:
     uint64 nService;
     std::string strSubVer;
     int nStartingHeight;
+    std::size_t nSendQueueSize;
+    uint64 nSendDropped;
+    std::map<std::pair<int,int>,CMvPeerTraffic> mapTraffic;
 };
 
 } // namespace network
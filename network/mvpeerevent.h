@@ -26,6 +26,14 @@ enum
     MV_EVENT_PEER_GETBLOCKS,
     MV_EVENT_PEER_TX,
     MV_EVENT_PEER_BLOCK,
+    MV_EVENT_PEER_GETHEADERS,
+    MV_EVENT_PEER_HEADERS,
+    MV_EVENT_PEER_CMPCTBLOCK,
+    MV_EVENT_PEER_GETBLOCKTXN,
+    MV_EVENT_PEER_BLOCKTXN,
+    MV_EVENT_PEER_SYNCTIMER,
+    MV_EVENT_PEER_RAWBLOCK,
+    MV_EVENT_PEER_TXTRICKLE,
     MV_EVENT_PEER_MAX
 };
 
@@ -78,6 +86,15 @@ typedef TYPE_PEERDATAEVENT(MV_EVENT_PEER_GETDATA,std::vector<CInv>) CMvEventPeer
 typedef TYPE_PEERDATAEVENT(MV_EVENT_PEER_GETBLOCKS,CBlockLocator) CMvEventPeerGetBlocks;
 typedef TYPE_PEERDATAEVENT(MV_EVENT_PEER_TX,CTransaction) CMvEventPeerTx;
 typedef TYPE_PEERDATAEVENT(MV_EVENT_PEER_BLOCK,CBlock) CMvEventPeerBlock;
+typedef TYPE_PEERDATAEVENT(MV_EVENT_PEER_GETHEADERS,CBlockLocator) CMvEventPeerGetHeaders;
+typedef TYPE_PEERDATAEVENT(MV_EVENT_PEER_HEADERS,std::vector<CBlock>) CMvEventPeerHeaders;
+typedef TYPE_PEERDATAEVENT(MV_EVENT_PEER_CMPCTBLOCK,CCompactBlock) CMvEventPeerCmpctBlock;
+typedef TYPE_PEERDATAEVENT(MV_EVENT_PEER_GETBLOCKTXN,CBlockTxnRequest) CMvEventPeerGetBlockTxn;
+typedef TYPE_PEERDATAEVENT(MV_EVENT_PEER_BLOCKTXN,CBlockTxn) CMvEventPeerBlockTxn;
+typedef TYPE_PEERDATAEVENT(MV_EVENT_PEER_SYNCTIMER,uint32) CMvEventPeerSyncTimer;
+// serialized block as stored, sent as the body of a block message
+typedef TYPE_PEERDATAEVENT(MV_EVENT_PEER_RAWBLOCK,std::vector<char>) CMvEventPeerRawBlock;
+typedef TYPE_PEERDATAEVENT(MV_EVENT_PEER_TXTRICKLE,uint32) CMvEventPeerTxTrickle;
 /*
 typedef TYPE_PEEREVENT(MV_EVENT_PEER_INV,std::vector<CInv>) CMvEventPeerInv;
 typedef TYPE_PEEREVENT(MV_EVENT_PEER_GETDATA,std::vector<CInv>) CMvEventPeerGetData;
@@ -96,6 +113,14 @@ public:
     DECLARE_EVENTHANDLER(CMvEventPeerGetBlocks);
     DECLARE_EVENTHANDLER(CMvEventPeerTx);
     DECLARE_EVENTHANDLER(CMvEventPeerBlock);
+    DECLARE_EVENTHANDLER(CMvEventPeerGetHeaders);
+    DECLARE_EVENTHANDLER(CMvEventPeerHeaders);
+    DECLARE_EVENTHANDLER(CMvEventPeerCmpctBlock);
+    DECLARE_EVENTHANDLER(CMvEventPeerGetBlockTxn);
+    DECLARE_EVENTHANDLER(CMvEventPeerBlockTxn);
+    DECLARE_EVENTHANDLER(CMvEventPeerSyncTimer);
+    DECLARE_EVENTHANDLER(CMvEventPeerRawBlock);
+    DECLARE_EVENTHANDLER(CMvEventPeerTxTrickle);
 };
 
 } // namespace network
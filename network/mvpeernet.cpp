@@ -27,6 +27,7 @@ CMvPeerNet::CMvPeerNet()
     nVersion  = 0;
     nService  = 0;
     fEnclosed = false;
+    nUploadRate = 0;
     pNetChannel = NULL;
 }   
 
@@ -47,19 +48,40 @@ bool CMvPeerNet::WalleveHandleInitialize()
 void CMvPeerNet::WalleveHandleDeinitialize()
 {
     setDNSeed.clear();
+    setSendBacklog.clear();
     pNetChannel = NULL;
 }
 
+void CMvPeerNet::HeartBeat()
+{
+    CPeerNet::HeartBeat();
+
+    // peers held back by the upload limit have no write completion to resume them
+    set<uint64>::iterator it = setSendBacklog.begin();
+    while (it != setSendBacklog.end())
+    {
+        CMvPeer *pMvPeer = static_cast<CMvPeer *>(GetPeer(*it));
+        if (pMvPeer == NULL || !pMvPeer->FlushSendQueue())
+        {
+            setSendBacklog.erase(it++);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
 bool CMvPeerNet::HandleEvent(CMvEventPeerInv& eventInv)
 {
-    CWalleveBufStream ssPayload;
+    CWalleveVectorStream ssPayload(GetSerializeSize(eventInv));
     ssPayload << eventInv;
     return SendDataMessage(eventInv.nNonce,MVPROTO_CMD_INV,ssPayload);
 }
 
 bool CMvPeerNet::HandleEvent(CMvEventPeerGetData& eventGetData)
 {
-    CWalleveBufStream ssPayload;
+    CWalleveVectorStream ssPayload(GetSerializeSize(eventGetData));
     ssPayload << eventGetData;
     if (!SendDataMessage(eventGetData.nNonce,MVPROTO_CMD_GETDATA,ssPayload))
     {
@@ -72,25 +94,84 @@ bool CMvPeerNet::HandleEvent(CMvEventPeerGetData& eventGetData)
 
 bool CMvPeerNet::HandleEvent(CMvEventPeerGetBlocks& eventGetBlocks)
 {
-    CWalleveBufStream ssPayload;
+    CWalleveVectorStream ssPayload(GetSerializeSize(eventGetBlocks));
     ssPayload << eventGetBlocks;
     return SendDataMessage(eventGetBlocks.nNonce,MVPROTO_CMD_GETBLOCKS,ssPayload);
 }
 
 bool CMvPeerNet::HandleEvent(CMvEventPeerTx& eventTx)
 {
-    CWalleveBufStream ssPayload;
+    CWalleveVectorStream ssPayload(GetSerializeSize(eventTx));
     ssPayload << eventTx;
     return SendDataMessage(eventTx.nNonce,MVPROTO_CMD_TX,ssPayload);
 }
 
 bool CMvPeerNet::HandleEvent(CMvEventPeerBlock& eventBlock)
 {
-    CWalleveBufStream ssPayload;
+    CWalleveVectorStream ssPayload(GetSerializeSize(eventBlock));
     ssPayload << eventBlock;
     return SendDataMessage(eventBlock.nNonce,MVPROTO_CMD_BLOCK,ssPayload);
 }
 
+bool CMvPeerNet::HandleEvent(CMvEventPeerRawBlock& eventRawBlock)
+{
+    CMvPeer *pMvPeer = static_cast<CMvPeer *>(GetPeer(eventRawBlock.nNonce));
+    if (pMvPeer == NULL)
+    {
+        return false;
+    }
+    // same payload as CMvEventPeerBlock, the stored bytes follow the fork hash as they are
+    CWalleveVectorStream ssFork(GetSerializeSize(eventRawBlock.hashFork));
+    ssFork << eventRawBlock.hashFork;
+    vector<char>& vRaw = eventRawBlock.data;
+    return pMvPeer->SendMessage(MVPROTO_CHN_DATA,MVPROTO_CMD_BLOCK,ssFork.GetData(),ssFork.GetSize(),
+                                vRaw.empty() ? NULL : &vRaw[0],vRaw.size());
+}
+
+bool CMvPeerNet::HandleEvent(CMvEventPeerGetHeaders& eventGetHeaders)
+{
+    CWalleveVectorStream ssPayload(GetSerializeSize(eventGetHeaders));
+    ssPayload << eventGetHeaders;
+    return SendDataMessage(eventGetHeaders.nNonce,MVPROTO_CMD_GETHEADERS,ssPayload);
+}
+
+bool CMvPeerNet::HandleEvent(CMvEventPeerHeaders& eventHeaders)
+{
+    CWalleveVectorStream ssPayload(GetSerializeSize(eventHeaders));
+    ssPayload << eventHeaders;
+    return SendDataMessage(eventHeaders.nNonce,MVPROTO_CMD_HEADERS,ssPayload);
+}
+
+bool CMvPeerNet::HandleEvent(CMvEventPeerCmpctBlock& eventCmpctBlock)
+{
+    CWalleveVectorStream ssPayload(GetSerializeSize(eventCmpctBlock));
+    ssPayload << eventCmpctBlock;
+    return SendDataMessage(eventCmpctBlock.nNonce,MVPROTO_CMD_CMPCTBLOCK,ssPayload);
+}
+
+bool CMvPeerNet::HandleEvent(CMvEventPeerGetBlockTxn& eventGetBlockTxn)
+{
+    CWalleveVectorStream ssPayload(GetSerializeSize(eventGetBlockTxn));
+    ssPayload << eventGetBlockTxn;
+    if (!SendDataMessage(eventGetBlockTxn.nNonce,MVPROTO_CMD_GETBLOCKTXN,ssPayload))
+    {
+        return false;
+    }
+
+    // the missing txs are answered in the same time as a block
+    vector<CInv> vInv;
+    vInv.push_back(CInv(CInv::MSG_CMPCT_BLOCK,eventGetBlockTxn.data.hashBlock));
+    SetInvTimer(eventGetBlockTxn.nNonce,vInv);
+    return true;
+}
+
+bool CMvPeerNet::HandleEvent(CMvEventPeerBlockTxn& eventBlockTxn)
+{
+    CWalleveVectorStream ssPayload(GetSerializeSize(eventBlockTxn));
+    ssPayload << eventBlockTxn;
+    return SendDataMessage(eventBlockTxn.nNonce,MVPROTO_CMD_BLOCKTXN,ssPayload);
+}
+
 CPeer* CMvPeerNet::CreatePeer(CIOClient *pClient,uint64 nNonce,bool fInBound)
 {
     uint32_t nTimerId = SetTimer(nNonce,HANDSHAKE_TIMEOUT);
@@ -129,18 +210,21 @@ CPeerInfo* CMvPeerNet::GetPeerInfo(CPeer* pPeer,CPeerInfo* pInfo)
         pMvInfo->nService = pMvPeer->nService;
         pMvInfo->strSubVer = pMvPeer->strSubVer;
         pMvInfo->nStartingHeight = pMvPeer->nStartingHeight;
+        pMvInfo->nSendQueueSize = pMvPeer->GetSendQueueSize();
+        pMvInfo->nSendDropped = pMvPeer->GetSendDropped();
+        pMvInfo->mapTraffic = pMvPeer->GetTraffic();
     }
     return pInfo;
 }
 
-bool CMvPeerNet::SendDataMessage(uint64 nNonce,int nCommand,CWalleveBufStream& ssPayload)
+bool CMvPeerNet::SendDataMessage(uint64 nNonce,int nCommand,CWalleveVectorStream& ssPayload)
 {
     CMvPeer *pMvPeer = static_cast<CMvPeer *>(GetPeer(nNonce));
     if (pMvPeer == NULL)
     {
         return false;
     }
-    return pMvPeer->SendMessage(MVPROTO_CHN_DATA,nCommand,ssPayload);
+    return pMvPeer->SendMessage(MVPROTO_CHN_DATA,nCommand,ssPayload.GetData(),ssPayload.GetSize());
 }
 
 void CMvPeerNet::SetInvTimer(uint64 nNonce,vector<CInv>& vInv)
@@ -161,6 +245,7 @@ void CMvPeerNet::SetInvTimer(uint64 nNonce,vector<CInv>& vInv)
                     break;
                 }
             case CInv::MSG_BLOCK:
+            case CInv::MSG_CMPCT_BLOCK:
                 {
                     nElapse += RESPONSE_BLOCK_TIMEOUT;
                     uint32 nTimerId = SetTimer(nNonce,nElapse);
@@ -200,7 +285,16 @@ void CMvPeerNet::BuildHello(CPeer *pPeer,CWalleveBufStream& ssPayload)
 
 void CMvPeerNet::HandlePeerWriten(CPeer *pPeer)
 {
-    ProcessAskFor(pPeer);
+    CMvPeer *pMvPeer = static_cast<CMvPeer *>(pPeer);
+    if (!pMvPeer->FlushSendQueue())
+    {
+        ProcessAskFor(pPeer);
+    }
+}
+
+void CMvPeerNet::HandlePeerSendBacklog(CPeer *pPeer)
+{
+    setSendBacklog.insert(pPeer->GetNonce());
 }
 
 bool CMvPeerNet::HandlePeerHandshaked(CPeer *pPeer,uint32 nTimerId)
@@ -309,16 +403,17 @@ bool CMvPeerNet::HandlePeerRecvMessage(CPeer *pPeer,int nChannel,int nCommand,CW
     }
     else if (nChannel == MVPROTO_CHN_DATA)
     {
+        // payload is already contiguous, decode it in place
+        CWalleveSpanStream ss(ssPayload.GetData(),ssPayload.GetSize());
         uint256 hashFork;
-        ssPayload >> hashFork;
+        ss >> hashFork;
         switch (nCommand)
         {
         case MVPROTO_CMD_GETBLOCKS:
             {
                 CMvEventPeerGetBlocks* pEvent = new CMvEventPeerGetBlocks(pMvPeer->GetNonce(),hashFork);
-                if (pEvent != NULL)
+                if (pEvent != NULL && LoadEventData(ss,pEvent))
                 {
-                    ssPayload >> pEvent->data;
                     pNetChannel->PostEvent(pEvent);
                     return true;
                 } 
@@ -327,7 +422,7 @@ bool CMvPeerNet::HandlePeerRecvMessage(CPeer *pPeer,int nChannel,int nCommand,CW
         case MVPROTO_CMD_GETDATA:
             {
                 vector<CInv> vInv;
-                ssPayload >> vInv;
+                ss >> vInv;
                 pMvPeer->AskFor(hashFork,vInv);
                 ProcessAskFor(pPeer);
                 return true;
@@ -336,9 +431,8 @@ bool CMvPeerNet::HandlePeerRecvMessage(CPeer *pPeer,int nChannel,int nCommand,CW
         case MVPROTO_CMD_INV:
             {
                 CMvEventPeerInv* pEvent = new CMvEventPeerInv(pMvPeer->GetNonce(),hashFork);
-                if (pEvent != NULL)
+                if (pEvent != NULL && LoadEventData(ss,pEvent))
                 {
-                    ssPayload >> pEvent->data;
                     pNetChannel->PostEvent(pEvent);
                     return true;
                 } 
@@ -347,9 +441,8 @@ bool CMvPeerNet::HandlePeerRecvMessage(CPeer *pPeer,int nChannel,int nCommand,CW
         case MVPROTO_CMD_TX:
             {
                 CMvEventPeerTx* pEvent = new CMvEventPeerTx(pMvPeer->GetNonce(),hashFork);
-                if (pEvent != NULL)
+                if (pEvent != NULL && LoadEventData(ss,pEvent))
                 {
-                    ssPayload >> pEvent->data;
                     CInv inv(CInv::MSG_TX,pEvent->data.GetHash());
                     CancelTimer(pMvPeer->Responded(inv));
                     pNetChannel->PostEvent(pEvent);
@@ -360,9 +453,8 @@ bool CMvPeerNet::HandlePeerRecvMessage(CPeer *pPeer,int nChannel,int nCommand,CW
         case MVPROTO_CMD_BLOCK:
             {
                 CMvEventPeerBlock* pEvent = new CMvEventPeerBlock(pMvPeer->GetNonce(),hashFork);
-                if (pEvent != NULL)
-                {           
-                    ssPayload >> pEvent->data;
+                if (pEvent != NULL && LoadEventData(ss,pEvent))
+                {
                     CInv inv(CInv::MSG_BLOCK,pEvent->data.GetHash());
                     CancelTimer(pMvPeer->Responded(inv));
                     pNetChannel->PostEvent(pEvent);
@@ -370,6 +462,60 @@ bool CMvPeerNet::HandlePeerRecvMessage(CPeer *pPeer,int nChannel,int nCommand,CW
                 }
             }
             break;
+        case MVPROTO_CMD_GETHEADERS:
+            {
+                CMvEventPeerGetHeaders* pEvent = new CMvEventPeerGetHeaders(pMvPeer->GetNonce(),hashFork);
+                if (pEvent != NULL && LoadEventData(ss,pEvent))
+                {
+                    pNetChannel->PostEvent(pEvent);
+                    return true;
+                } 
+            }
+            break;
+        case MVPROTO_CMD_HEADERS:
+            {
+                CMvEventPeerHeaders* pEvent = new CMvEventPeerHeaders(pMvPeer->GetNonce(),hashFork);
+                if (pEvent != NULL && LoadEventData(ss,pEvent))
+                {
+                    pNetChannel->PostEvent(pEvent);
+                    return true;
+                } 
+            }
+            break;
+        case MVPROTO_CMD_CMPCTBLOCK:
+            {
+                CMvEventPeerCmpctBlock* pEvent = new CMvEventPeerCmpctBlock(pMvPeer->GetNonce(),hashFork);
+                if (pEvent != NULL && LoadEventData(ss,pEvent))
+                {
+                    CInv inv(CInv::MSG_CMPCT_BLOCK,pEvent->data.header.GetHash());
+                    CancelTimer(pMvPeer->Responded(inv));
+                    pNetChannel->PostEvent(pEvent);
+                    return true;
+                }
+            }
+            break;
+        case MVPROTO_CMD_GETBLOCKTXN:
+            {
+                CMvEventPeerGetBlockTxn* pEvent = new CMvEventPeerGetBlockTxn(pMvPeer->GetNonce(),hashFork);
+                if (pEvent != NULL && LoadEventData(ss,pEvent))
+                {
+                    pNetChannel->PostEvent(pEvent);
+                    return true;
+                }
+            }
+            break;
+        case MVPROTO_CMD_BLOCKTXN:
+            {
+                CMvEventPeerBlockTxn* pEvent = new CMvEventPeerBlockTxn(pMvPeer->GetNonce(),hashFork);
+                if (pEvent != NULL && LoadEventData(ss,pEvent))
+                {
+                    CInv inv(CInv::MSG_CMPCT_BLOCK,pEvent->data.hashBlock);
+                    CancelTimer(pMvPeer->Responded(inv));
+                    pNetChannel->PostEvent(pEvent);
+                    return true;
+                }
+            }
+            break;
         default:
             break;
         }
@@ -21,7 +21,7 @@ public:
     IMvNetChannel() : IIOModule("netchannel") {}
     virtual int GetPrimaryChainHeight() = 0;
     virtual void BroadcastBlockInv(const uint256& hashFork,const uint256& hashBlock,const std::set<uint64>& setKnownPeer=std::set<uint64>())=0;
-    virtual void BroadcastTxInv(const uint256& hashFork)=0;
+    virtual void BroadcastTxInv(const uint256& hashFork,const std::vector<std::pair<uint256,int64> >& vTxFeeRate)=0;
 
 };
 
@@ -35,34 +35,59 @@ public:
     bool HandlePeerHandshaked(walleve::CPeer *pPeer,uint32 nTimerId);
     bool HandlePeerRecvMessage(walleve::CPeer *pPeer,int nChannel,int nCommand,
                                walleve::CWalleveBufStream& ssPayload); 
+    void HandlePeerSendBacklog(walleve::CPeer *pPeer);
+    uint64 GetService() const { return nService; }
+    int64 GetUploadRate() const { return nUploadRate; }
 protected:
     bool WalleveHandleInitialize();
     void WalleveHandleDeinitialize();
+    void HeartBeat();
     bool HandleEvent(CMvEventPeerInv& eventInv);
     bool HandleEvent(CMvEventPeerGetData& eventGetData);
     bool HandleEvent(CMvEventPeerGetBlocks& eventGetBlocks);
     bool HandleEvent(CMvEventPeerTx& eventTx);
     bool HandleEvent(CMvEventPeerBlock& eventBlock);
+    bool HandleEvent(CMvEventPeerGetHeaders& eventGetHeaders);
+    bool HandleEvent(CMvEventPeerHeaders& eventHeaders);
+    bool HandleEvent(CMvEventPeerCmpctBlock& eventCmpctBlock);
+    bool HandleEvent(CMvEventPeerGetBlockTxn& eventGetBlockTxn);
+    bool HandleEvent(CMvEventPeerBlockTxn& eventBlockTxn);
+    bool HandleEvent(CMvEventPeerRawBlock& eventRawBlock);
     walleve::CPeer* CreatePeer(walleve::CIOClient *pClient,uint64 nNonce,bool fInBound);
     void DestroyPeer(walleve::CPeer* pPeer);
     walleve::CPeerInfo* GetPeerInfo(walleve::CPeer* pPeer,walleve::CPeerInfo* pInfo);
-    bool SendDataMessage(uint64 nNonce,int nCommand,walleve::CWalleveBufStream& ssPayload);
+    bool SendDataMessage(uint64 nNonce,int nCommand,walleve::CWalleveVectorStream& ssPayload);
     void SetInvTimer(uint64 nNonce,std::vector<CInv>& vInv);
     void ProcessAskFor(walleve::CPeer* pPeer);
-    void Configure(uint32 nMagicNumIn,uint32 nVersionIn,uint64 nServiceIn,const std::string& subVersionIn,bool fEnclosedIn)
+    void Configure(uint32 nMagicNumIn,uint32 nVersionIn,uint64 nServiceIn,const std::string& subVersionIn,bool fEnclosedIn,
+                   int64 nUploadRateIn = 0)
     {
         nMagicNum = nMagicNumIn; nVersion = nVersionIn; nService = nServiceIn;
-        subVersion = subVersionIn; fEnclosed = fEnclosedIn;
+        subVersion = subVersionIn; fEnclosed = fEnclosedIn; nUploadRate = nUploadRateIn;
     }
     virtual bool CheckPeerVersion(uint32 nVersionIn,uint64 nServiceIn,const std::string& subVersionIn) = 0;
+    template <typename E>
+    bool LoadEventData(walleve::CWalleveStream& ss,E* pEvent)
+    {
+        try
+        {
+            ss >> pEvent->data;
+            return true;
+        }
+        catch (...) {}
+        pEvent->Free();
+        return false;
+    }
 protected:
     IMvNetChannel* pNetChannel;
     uint32 nMagicNum;
     uint32 nVersion;
     uint64 nService;
     bool fEnclosed;
+    int64 nUploadRate;
     std::string subVersion;    
     std::set<boost::asio::ip::tcp::endpoint> setDNSeed;
+    std::set<uint64> setSendBacklog;
 };
 
 } // namespace network
@@ -4,6 +4,7 @@
 
 #include "mvproto.h"
 #include <boost/asio.hpp>
+#include <zlib.h>
 
 using namespace std;
 using namespace walleve;
@@ -13,6 +14,42 @@ using boost::asio::ip::tcp;
 //////////////////////////////
 // CMvPeerMessageHeader
 
+bool multiverse::network::CompressPayload(const char* pData,size_t nSize,vector<char>& vCompressed)
+{
+    uLongf nDestLen = compressBound(nSize);
+    vCompressed.resize(4 + nDestLen);
+    *(uint32*)&vCompressed[0] = nSize;
+    if (compress2((Bytef*)&vCompressed[4],&nDestLen,(const Bytef*)pData,nSize,Z_BEST_SPEED) != Z_OK
+        || 4 + nDestLen >= nSize)
+    {
+        return false;
+    }
+    vCompressed.resize(4 + nDestLen);
+    return true;
+}
+
+bool multiverse::network::DecompressPayload(const char* pData,size_t nSize,CWalleveBufStream& ssRaw)
+{
+    if (nSize < 4)
+    {
+        return false;
+    }
+    // the announced size is bounded before any output buffer is allocated
+    uint32 nRawSize = *(const uint32*)pData;
+    if (nRawSize > MESSAGE_PAYLOAD_MAX_SIZE)
+    {
+        return false;
+    }
+    uLongf nDestLen = nRawSize;
+    Bytef* pDest = boost::asio::buffer_cast<Bytef*>(ssRaw.prepare(nRawSize));
+    if (uncompress(pDest,&nDestLen,(const Bytef*)(pData + 4),nSize - 4) != Z_OK || nDestLen != nRawSize)
+    {
+        return false;
+    }
+    ssRaw.commit(nRawSize);
+    return true;
+}
+
 ///////////////////////////////
 // CEndpoint
 
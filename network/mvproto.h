@@ -7,6 +7,8 @@
 
 #include "uint256.h"
 #include "crc24q.h"
+#include "crc32c.h"
+#include "crypto.h"
 #include "walleve/walleve.h"
 
 namespace multiverse 
@@ -17,7 +19,11 @@ namespace network
 
 enum
 {
-    NODE_NETWORK           = (1 << 0)
+    NODE_NETWORK           = (1 << 0),
+    NODE_HEADERS           = (1 << 1),
+    NODE_CMPCTBLOCK        = (1 << 2),
+    NODE_COMPRESS          = (1 << 3),
+    NODE_CRC32C            = (1 << 4)
 };
 
 enum
@@ -46,7 +52,12 @@ enum
     MVPROTO_CMD_GETDATA     = 4,
     MVPROTO_CMD_INV         = 5,
     MVPROTO_CMD_TX          = 6,
-    MVPROTO_CMD_BLOCK       = 7
+    MVPROTO_CMD_BLOCK       = 7,
+    MVPROTO_CMD_GETHEADERS  = 8,
+    MVPROTO_CMD_HEADERS     = 9,
+    MVPROTO_CMD_CMPCTBLOCK  = 10,
+    MVPROTO_CMD_GETBLOCKTXN = 11,
+    MVPROTO_CMD_BLOCKTXN    = 12
 };
 
 enum
@@ -57,6 +68,18 @@ enum
 
 #define MESSAGE_HEADER_SIZE		16
 #define MESSAGE_PAYLOAD_MAX_SIZE        0x400000
+#define MESSAGE_COMPRESSED              0x20
+#define MESSAGE_COMPRESS_MIN_SIZE       1024
+#define MESSAGE_SENDBUFFER_SIZE         0x40000
+#define MESSAGE_SENDQUEUE_MAX_SIZE      0x1000000
+
+enum
+{
+    MESSAGE_PRIORITY_HIGH   = 0,
+    MESSAGE_PRIORITY_NORMAL = 1,
+    MESSAGE_PRIORITY_LOW    = 2,
+    MESSAGE_PRIORITY_COUNT  = 3
+};
 
 class CMvPeerMessageHeader
 {
@@ -69,7 +92,8 @@ public:
     uint32 nHeaderChecksum;
 public:
     int GetChannel() const { return (nType >> 6); }
-    int GetCommand() const { return (nType & 0x3F); }
+    int GetCommand() const { return (nType & 0x1F); }
+    bool IsCompressed() const { return (!!(nType & MESSAGE_COMPRESSED)); }
     uint32 GetHeaderChecksum() const
     {
         unsigned char buf[MESSAGE_HEADER_SIZE];
@@ -115,6 +139,10 @@ protected:
     }
 };
 
+// compressed payload : uint32 uncompressed size + deflate stream
+bool CompressPayload(const char* pData,std::size_t nSize,std::vector<char>& vCompressed);
+bool DecompressPayload(const char* pData,std::size_t nSize,walleve::CWalleveBufStream& ssRaw);
+
 class CInv
 {
     friend class walleve::CWalleveStream;
@@ -144,6 +172,15 @@ public:
     uint256 nHash;
 };
 
+class CInvHasher
+{
+public:
+    std::size_t operator()(const CInv& inv) const
+    {
+        return (std::size_t)multiverse::crypto::CryptoSaltedHash(inv.nHash,inv.nType);
+    }
+};
+
 class CEndpoint : public walleve::CBinary
 {
 public:
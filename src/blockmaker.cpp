@@ -219,10 +219,11 @@ bool CBlockMaker::CreateNewBlock(CBlock& block,const uint256& hashPrev,int64 nPr
     }
     
     size_t nMaxTxSize = MAX_BLOCK_SIZE - GetSerializeSize(block) - profile.GetSignatureSize();
-    int64 nTotalTxFee = 0;
-    pTxPool->ArrangeBlockTx(pCoreProtocol->GetGenesisBlockHash(),nMaxTxSize,block.vtx,nTotalTxFee); 
-    block.hashMerkle = block.CalcMerkleTreeRoot();
-    block.txMint.nAmount += nTotalTxFee;
+    CArrangedBlockTxPtr spArranged;
+    pTxPool->GetArrangedBlockTx(pCoreProtocol->GetGenesisBlockHash(),nMaxTxSize,spArranged);
+    block.vtx = spArranged->vtx;
+    block.hashMerkle = spArranged->GetMerkleRoot();
+    block.txMint.nAmount += spArranged->nTotalTxFee;
  
     if (!SignBlock(block,profile))
     {
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "core.h"
+#include "sigcache.h"
 
 using namespace std;                      
 using namespace walleve; 
@@ -14,9 +15,149 @@ static const int64  MAX_CLOCK_DRIFT   = 10 * 60;
 
 static const int  PROOF_OF_WORK_BITS_LIMIT   = 16;
 static const int  PROOF_OF_WORK_BITS_INIT    = 20;
-static const int  PROOF_OF_WORK_ADJUST_COUNT = 16; 
 static const int  PROOF_OF_WORK_ADJUST_DEBOUNCE = 10; 
 static const int  PROOF_OF_WORK_TARGET_SPACING = BLOCK_TARGET_SPACING + BLOCK_TARGET_SPACING / 2; 
+static const size_t MERKLE_HASH_CHUNK = 64;
+
+///////////////////////////////
+// CBlockTxValidation
+
+class CBlockTxValidation
+{
+public:
+    CBlockTxValidation(ICoreProtocol* pCoreProtocolIn,const CBlock& blockIn)
+    : pCoreProtocol(pCoreProtocolIn),block(blockIn),nTotalTxSize(0)
+    {
+    }
+    bool Validate(CWalleveWorkers& workers)
+    {
+        size_t nTx = block.vtx.size();
+        size_t nTreeSize = nTx;
+        for (size_t nSize = nTx;nSize > 1;nSize = (nSize + 1) / 2)
+        {
+            nTreeSize += (nSize + 1) / 2;
+        }
+        vMerkleTree.resize(nTreeSize);
+        vTxSize.resize(nTx);
+        vTxErr.assign(nTx,MV_FAILED);
+
+        if (!workers.ForEach(nTx,boost::bind(&CBlockTxValidation::ValidateTx,this,_1)))
+        {
+            return false;
+        }
+        BOOST_FOREACH(size_t nSize,vTxSize)
+        {
+            nTotalTxSize += nSize;
+        }
+
+        // same layout as CBlock::BuildMerkleTree
+        size_t j = 0;
+        for (size_t nSize = nTx;nSize > 1;nSize = (nSize + 1) / 2)
+        {
+            size_t nParent = (nSize + 1) / 2;
+            size_t nChunk = (nParent + MERKLE_HASH_CHUNK - 1) / MERKLE_HASH_CHUNK;
+            if (!workers.ForEach(nChunk,boost::bind(&CBlockTxValidation::HashMerkleChunk,this,j,nSize,_1)))
+            {
+                return false;
+            }
+            j += nSize;
+        }
+        return true;
+    }
+    uint256 GetMerkleRoot() const
+    {
+        return (vMerkleTree.empty() ? uint256(0) : vMerkleTree.back());
+    }
+protected:
+    void ValidateTx(size_t n)
+    {
+        const CTransaction& tx = block.vtx[n];
+        vMerkleTree[n] = tx.GetHash();
+        vTxSize[n] = tx.GetSerializedSize();
+        vTxErr[n] = (tx.IsMintTx() ? MV_ERR_TRANSACTION_INVALID : pCoreProtocol->ValidateTransaction(tx));
+    }
+    void HashMerkleChunk(size_t nOffset,size_t nSize,size_t nChunk)
+    {
+        size_t nParentBegin = nChunk * MERKLE_HASH_CHUNK;
+        size_t nChildEnd = min((nParentBegin + MERKLE_HASH_CHUNK) * 2,nSize);
+        crypto::CryptoHashMerkleLevel(&vMerkleTree[nOffset + nParentBegin * 2],nChildEnd - nParentBegin * 2,
+                                      &vMerkleTree[nOffset + nSize + nParentBegin]);
+    }
+public:
+    ICoreProtocol* pCoreProtocol;
+    const CBlock& block;
+    vector<uint256> vMerkleTree;
+    vector<size_t> vTxSize;
+    vector<MvErr> vTxErr;
+    size_t nTotalTxSize;
+};
+
+///////////////////////////////
+// CBlockTxSigVerification
+
+class CBlockTxSigVerification
+{
+public:
+    enum { CHUNK_SIZE = 32 };
+    CBlockTxSigVerification(const CBlockEx& blockIn) : block(blockIn) {}
+    void Verify(CWalleveWorkers& workers)
+    {
+        // an item stays failed until its signature is known to be good
+        vTxErr.assign(block.vtx.size(),MV_FAILED);
+        workers.ForEach((block.vtx.size() + CHUNK_SIZE - 1) / CHUNK_SIZE,
+                        boost::bind(&CBlockTxSigVerification::VerifyChunk,this,_1));
+    }
+protected:
+    // uncached pubkey signatures of a chunk are collected for crypto, templates are verified one by one
+    void VerifyChunk(size_t nChunk)
+    {
+        CSignatureCache& sigCache = CSignatureCache::GetInstance();
+        vector<crypto::CCryptoVerifyItem> vItem;
+        vector<size_t> vIndex;
+        size_t nEnd = min((nChunk + 1) * CHUNK_SIZE,block.vtx.size());
+        for (size_t i = nChunk * CHUNK_SIZE;i < nEnd;i++)
+        {
+            const CTransaction& tx = block.vtx[i];
+            const CDestination& destIn = block.vTxContxt[i].destIn;
+            uint256 hashSig = tx.GetSignatureHash();
+            if (destIn.IsPubKey())
+            {
+                if (sigCache.Exists(hashSig,destIn,tx.vchSig))
+                {
+                    vTxErr[i] = MV_OK;
+                }
+                else
+                {
+                    vItem.push_back(crypto::CCryptoVerifyItem(destIn.data,hashSig,tx.vchSig));
+                    vIndex.push_back(i);
+                }
+            }
+            else
+            {
+                vTxErr[i] = (destIn.VerifySignature(hashSig,tx.vchSig) ? MV_OK : MV_ERR_TRANSACTION_SIGNATURE_INVALID);
+            }
+        }
+        vector<bool> vValid;
+        crypto::CryptoVerifyEach(vItem,vValid);
+        for (size_t k = 0;k < vItem.size();k++)
+        {
+            size_t i = vIndex[k];
+            if (vValid[k])
+            {
+                sigCache.AddNew(vItem[k].hash,block.vTxContxt[i].destIn,vItem[k].vchSig);
+                vTxErr[i] = MV_OK;
+            }
+            else
+            {
+                vTxErr[i] = MV_ERR_TRANSACTION_SIGNATURE_INVALID;
+            }
+        }
+    }
+public:
+    const CBlockEx& block;
+    vector<MvErr> vTxErr;
+};
+
 ///////////////////////////////
 // CMvCoreProtocol
 
@@ -26,6 +167,8 @@ CMvCoreProtocol::CMvCoreProtocol()
     nProofOfWorkInit = PROOF_OF_WORK_BITS_INIT;
     nProofOfWorkUpperTarget = PROOF_OF_WORK_TARGET_SPACING + PROOF_OF_WORK_ADJUST_DEBOUNCE;
     nProofOfWorkLowerTarget = PROOF_OF_WORK_TARGET_SPACING - PROOF_OF_WORK_ADJUST_DEBOUNCE;
+    // no released chain to checkpoint yet, enabled by -assumevalid
+    hashAssumeValid = 0;
 }
 
 CMvCoreProtocol::~CMvCoreProtocol()
@@ -37,9 +180,34 @@ bool CMvCoreProtocol::WalleveHandleInitialize()
     CBlock block;
     GetGenesisBlock(block);
     hashGenesisBlock = block.GetHash();
+
+    const CMvBasicConfig* pConfig = WalleveConfig();
+    if (pConfig != NULL && !pConfig->strAssumeValid.empty())
+    {
+        hashAssumeValid.SetHex(pConfig->strAssumeValid);
+    }
+    if (hashAssumeValid != 0)
+    {
+        WalleveLog("Assume valid block : %s\n",hashAssumeValid.GetHex().c_str());
+    }
+    return true;
+}
+
+bool CMvCoreProtocol::WalleveHandleInvoke()
+{
+    if (!workerValidation.Start())
+    {
+        WalleveLog("Failed to start block validation workers\n");
+        return false;
+    }
     return true;
 }
 
+void CMvCoreProtocol::WalleveHandleHalt()
+{
+    workerValidation.Stop();
+}
+
 const MvErr CMvCoreProtocol::Debug(const MvErr& err,const char* pszFunc,const char *pszFormat,...)
 {
     string strFormat(pszFunc);
@@ -130,9 +298,9 @@ MvErr CMvCoreProtocol::ValidateTransaction(const CTransaction& tx)
         }
     }
 
-    if (GetSerializeSize(tx) > MAX_TX_SIZE)
+    if (tx.GetSerializedSize() > MAX_TX_SIZE)
     {
-        return DEBUG(MV_ERR_TRANSACTION_OVERSIZE,"%u\n",GetSerializeSize(tx));
+        return DEBUG(MV_ERR_TRANSACTION_OVERSIZE,"%u\n",tx.GetSerializedSize());
     }
 
     return MV_OK;
@@ -159,30 +327,36 @@ MvErr CMvCoreProtocol::ValidateBlock(CBlock& block)
         return DEBUG(MV_ERR_BLOCK_TRANSACTIONS_INVALID,"invalid mint tx\n");
     }
 
-    size_t nBlockSize = GetSerializeSize(block);
+    // Hash and validate txs, then build merkle tree levels on validation workers
+    CBlockTxValidation validation(this,block);
+    if (!validation.Validate(workerValidation))
+    {
+        return DEBUG(MV_FAILED,"tx validation interrupted\n");
+    }
+
+    size_t nBlockSize = block.GetSerializedSize(validation.nTotalTxSize);
     if (nBlockSize > MAX_BLOCK_SIZE)
     {
         return DEBUG(MV_ERR_BLOCK_OVERSIZE,"size overflow size=%u vtx=%u\n",nBlockSize,block.vtx.size());
     }
 
-    vector<uint256> vMerkleTree;
-    if (block.hashMerkle != block.BuildMerkleTree(vMerkleTree))
+    if (block.hashMerkle != validation.GetMerkleRoot())
     {
         return DEBUG(MV_ERR_BLOCK_TXHASH_MISMATCH,"tx merkeroot mismatched\n");
     }
 
-    set<uint256> setTx;
-    setTx.insert(vMerkleTree.begin(),vMerkleTree.begin() + block.vtx.size());
-    if (setTx.size() != block.vtx.size())
+    vector<uint256> vTxHash(validation.vMerkleTree.begin(),validation.vMerkleTree.begin() + block.vtx.size());
+    sort(vTxHash.begin(),vTxHash.end());
+    if (adjacent_find(vTxHash.begin(),vTxHash.end()) != vTxHash.end())
     {
         return DEBUG(MV_ERR_BLOCK_DUPLICATED_TRANSACTION,"duplicate tx\n");
     }
 
-    BOOST_FOREACH(CTransaction& tx,block.vtx)
+    for (size_t i = 0;i < block.vtx.size();i++)
     {
-        if (tx.IsMintTx() || ValidateTransaction(tx) != MV_OK)
+        if (validation.vTxErr[i] != MV_OK)
         {
-            return DEBUG(MV_ERR_BLOCK_TRANSACTIONS_INVALID,"invalid tx %s\n",tx.GetHash().GetHex().c_str());
+            return DEBUG(MV_ERR_BLOCK_TRANSACTIONS_INVALID,"invalid tx %s\n",block.vtx[i].GetHash().GetHex().c_str());
         }
     }
 
@@ -195,16 +369,53 @@ MvErr CMvCoreProtocol::ValidateBlock(CBlock& block)
 
 MvErr CMvCoreProtocol::VerifyBlock(CBlock& block,CBlockIndex* pIndexPrev)
 {
-    (void)block;
-    (void)pIndexPrev;
-    return MV_OK;
+    // bodies are held to the same rules as the header chain they were synchronized against
+    return VerifyBlockHeader(block,pIndexPrev);
 }
 
-MvErr CMvCoreProtocol::VerifyBlockTx(CTransaction& tx,CTxContxt& txContxt,CBlockIndex* pIndexPrev)
+MvErr CMvCoreProtocol::VerifyBlockHeader(CBlock& block,CBlockIndex* pIndexPrev)
 {
-    (void)tx;
-    (void)txContxt;
-    (void)pIndexPrev;
+    // These are checks that only need the header, mint tx and previous index
+    if (block.GetBlockTime() > WalleveGetNetTime() + MAX_CLOCK_DRIFT)
+    {
+        return DEBUG(MV_ERR_BLOCK_TIMESTAMP_OUT_OF_RANGE,"%ld\n",block.GetBlockTime());
+    }
+
+    if (!block.txMint.IsMintTx())
+    {
+        return DEBUG(MV_ERR_BLOCK_TRANSACTIONS_INVALID,"invalid mint tx\n");
+    }
+
+    if (block.IsProofOfWork())
+    {
+        if (block.vchProof.size() < CProofOfHashWorkCompact::PROOFHASHWORK_SIZE)
+        {
+            return DEBUG(MV_ERR_BLOCK_PROOF_OF_WORK_INVALID,"proof size %u\n",block.vchProof.size());
+        }
+        CProofOfHashWorkCompact proof;
+        proof.Load(block.vchProof);
+
+        int nBits;
+        int64 nReward;
+        if (!GetProofOfWorkTarget(pIndexPrev,proof.nAlgo,nBits,nReward))
+        {
+            return DEBUG(MV_ERR_BLOCK_PROOF_OF_WORK_INVALID,"invalid algo %d\n",proof.nAlgo);
+        }
+        if (proof.nBits != nBits)
+        {
+            return DEBUG(MV_ERR_BLOCK_PROOF_OF_WORK_INVALID,"bits mismatched (%d : %d)\n",proof.nBits,nBits);
+        }
+
+        vector<unsigned char> vchProofOfWork;
+        block.GetSerializedProofOfWorkData(vchProofOfWork);
+        uint256 hash = crypto::CryptoHash(&vchProofOfWork[0],vchProofOfWork.size());
+        uint256 hashTarget = (~uint256(0) >> GetProofOfWorkRunTimeBits(nBits,block.GetBlockTime(),pIndexPrev->GetBlockTime()));
+        if (hash > hashTarget)
+        {
+            return DEBUG(MV_ERR_BLOCK_PROOF_OF_WORK_INVALID,"hash error (%s : %s)\n",
+                                                             hash.GetHex().c_str(),hashTarget.GetHex().c_str());
+        }
+    }
     return MV_OK;
 }
 
@@ -247,38 +458,18 @@ bool CMvCoreProtocol::GetProofOfWorkTarget(CBlockIndex* pIndexPrev,int nAlgo,int
     }
     nReward = GetProofOfWorkReward(pIndexPrev);
 
-    CBlockIndex* pIndex = pIndexPrev;
-    while ((!pIndex->IsProofOfWork() || pIndex->nProofAlgo != nAlgo) && pIndex->pPrev != NULL)
-    {
-        pIndex = pIndex->pPrev;
-    }
+    CBlockIndex* pIndex = pIndexPrev->GetLastWork(nAlgo);
     
     // first 
-    if (!pIndex->IsProofOfWork())
+    if (pIndex == NULL)
     {
         nBits = nProofOfWorkInit;
         return true; 
     }
 
+    // weighted spacing of the last works is accumulated when the index is added
     nBits = pIndex->nProofBits;
-    int64 nSpacing = 0;
-    int64 nWeight = 0;
-    int nWIndex = PROOF_OF_WORK_ADJUST_COUNT - 1; 
-    while (pIndex->IsProofOfWork())
-    {
-        nSpacing += (pIndex->GetBlockTime() - pIndex->pPrev->GetBlockTime()) << nWIndex;
-        nWeight += (1ULL) << nWIndex; 
-        if (!nWIndex--)
-        {
-            break;
-        }
-        pIndex = pIndex->pPrev;
-        while ((!pIndex->IsProofOfWork() || pIndex->nProofAlgo != nAlgo) && pIndex->pPrev != NULL)
-        {
-            pIndex = pIndex->pPrev;
-        }
-    }
-    nSpacing /= nWeight;
+    int64 nSpacing = pIndex->nWorkSpacing / pIndex->nWorkWeight;
     if (nSpacing > nProofOfWorkUpperTarget && nBits > nProofOfWorkLimit)
     {
         nBits--;
@@ -311,6 +502,33 @@ int64 CMvCoreProtocol::GetProofOfWorkReward(CBlockIndex* pIndexPrev)
     return (15 * COIN);    
 }
 
+const uint256& CMvCoreProtocol::GetAssumeValidBlockHash()
+{
+    return hashAssumeValid;
+}
+
+void CMvCoreProtocol::AddAssumeValidBlock(const vector<pair<int,uint256> >& vBlock)
+{
+    boost::unique_lock<boost::mutex> lock(mtxAssumeValid);
+    for (size_t i = 0;i < vBlock.size();i++)
+    {
+        mapAssumeValid[vBlock[i].first] = vBlock[i].second;
+    }
+}
+
+void CMvCoreProtocol::PruneAssumeValidBlock(int nHeight)
+{
+    boost::unique_lock<boost::mutex> lock(mtxAssumeValid);
+    mapAssumeValid.erase(mapAssumeValid.begin(),mapAssumeValid.upper_bound(nHeight));
+}
+
+bool CMvCoreProtocol::IsAssumeValidBlock(const uint256& hashBlock,int nHeight)
+{
+    boost::unique_lock<boost::mutex> lock(mtxAssumeValid);
+    map<int,uint256>::iterator it = mapAssumeValid.find(nHeight);
+    return (it != mapAssumeValid.end() && (*it).second == hashBlock);
+}
+
 bool CMvCoreProtocol::CheckBlockSignature(const CBlock& block)
 {
     (void)block;
@@ -329,3 +547,23 @@ void CMvTestNetCoreProtocol::GetGenesisBlock(CBlock& block)
     (void)block;
 }
 
+MvErr CMvCoreProtocol::VerifyBlockTx(CBlockEx& block,CBlockIndex* pIndexPrev,size_t& nInvalidTx)
+{
+    // the assumed-valid block commits to its ancestors by hash, their signatures are skipped
+    // while inputs, amounts and merkle root are still checked by the callers
+    if (IsAssumeValidBlock(block.GetHash(),pIndexPrev->nHeight + 1))
+    {
+        return MV_OK;
+    }
+    CBlockTxSigVerification verification(block);
+    verification.Verify(workerValidation);
+    for (size_t i = 0;i < verification.vTxErr.size();i++)
+    {
+        if (verification.vTxErr[i] != MV_OK)
+        {
+            nInvalidTx = i;
+            return DEBUG(verification.vTxErr[i],"invalid signature %s\n",block.vtx[i].GetHash().GetHex().c_str());
+        }
+    }
+    return MV_OK;
+}
@@ -20,22 +20,34 @@ public:
     virtual MvErr ValidateTransaction(const CTransaction& tx);
     virtual MvErr ValidateBlock(CBlock& block);
     virtual MvErr VerifyBlock(CBlock& block,CBlockIndex* pIndexPrev);
-    virtual MvErr VerifyBlockTx(CTransaction& tx,CTxContxt& txContxt,CBlockIndex* pIndexPrev);
+    virtual MvErr VerifyBlockHeader(CBlock& block,CBlockIndex* pIndexPrev);
+    virtual MvErr VerifyBlockTx(CBlockEx& block,CBlockIndex* pIndexPrev,std::size_t& nInvalidTx);
     virtual MvErr VerifyTransaction(CTransaction& tx,const std::vector<CTxOutput>& vPrevOutput,int nForkHeight);
     virtual bool GetProofOfWorkTarget(CBlockIndex* pIndexPrev,int nAlgo,int& nBits,int64& nReward);
     virtual int GetProofOfWorkRunTimeBits(int nBits,int64 nTime,int64 nPrevTime);
+    virtual const uint256& GetAssumeValidBlockHash();
+    virtual void AddAssumeValidBlock(const std::vector<std::pair<int,uint256> >& vBlock);
+    virtual void PruneAssumeValidBlock(int nHeight);
     //virtual MvErr 
 protected:
     bool WalleveHandleInitialize();
+    bool WalleveHandleInvoke();
+    void WalleveHandleHalt();
     const MvErr Debug(const MvErr& err,const char* pszFunc,const char *pszFormat,...); 
     bool CheckBlockSignature(const CBlock& block);
    int64 GetProofOfWorkReward(CBlockIndex* pIndexPrev);
+    bool IsAssumeValidBlock(const uint256& hashBlock,int nHeight);
 protected:
     uint256 hashGenesisBlock;
+    uint256 hashAssumeValid;
     int nProofOfWorkLimit;
     int nProofOfWorkInit;
     int64 nProofOfWorkUpperTarget;
     int64 nProofOfWorkLowerTarget;
+    walleve::CWalleveWorkers workerValidation;
+    boost::mutex mtxAssumeValid;
+    // ancestors of the assumed-valid block by height, until the primary chain connects them
+    std::map<int,uint256> mapAssumeValid;
 };
 
 class CMvTestNetCoreProtocol : public CMvCoreProtocol
@@ -142,45 +142,44 @@ MvErr CDispatcher::AddNewBlock(CBlock& block,uint64 nNonce)
 
 MvErr CDispatcher::AddNewTx(CTransaction& tx,uint64 nNonce)
 {
-    MvErr err = MV_OK;
-    err = pCoreProtocol->ValidateTransaction(tx);
-    if (err != MV_OK)
-    {
-        return err;
-    }
-    set<uint256> setMissingPrevTx;
-    BOOST_FOREACH(const CTxIn& txin,tx.vInput)
+    vector<CTxAdmission> vAdmission;
+    vAdmission.push_back(CTxAdmission(&tx,nNonce));
+    AddNewTx(vAdmission);
+    return vAdmission[0].err;
+}
+
+void CDispatcher::AddNewTx(vector<CTxAdmission>& vAdmission)
+{
+    pTxPool->Push(vAdmission);
+
+    map<uint256,vector<pair<uint256,int64> > > mapBroadcastTx;
+    BOOST_FOREACH(CTxAdmission& admission,vAdmission)
     {
-        if (!pTxPool->Exists(txin.prevout.hash) && !pWorldLine->ExistsTx(txin.prevout.hash))
+        if (admission.err != MV_OK)
         {
-            setMissingPrevTx.insert(txin.prevout.hash);
+            continue;
+        }
+        CTransaction& tx = *admission.pTx;
+        if (!pWallet->UpdateTx(admission.hashFork,CAssembledTx(tx,-1,admission.destIn,admission.nValueIn)))
+        {
+            admission.err = MV_ERR_SYS_DATABASE_ERROR;
+            continue;
         }
-    }
-    if (!setMissingPrevTx.empty())
-    {
-        return MV_ERR_MISSING_PREV;
-    }
-    uint256 hashFork;
-    CDestination destIn;
-    int64 nValueIn;
-    err = pTxPool->Push(tx,hashFork,destIn,nValueIn);
-    if (err != MV_OK)
-    {
-        return err;
-    }
-    if (!pWallet->UpdateTx(hashFork,CAssembledTx(tx,-1,destIn,nValueIn)))
-    {
-        return MV_ERR_SYS_DATABASE_ERROR;
-    }
 
-    CTransactionUpdate updateTransaction;
-    updateTransaction.hashFork = hashFork; 
-    updateTransaction.txUpdate = tx;
-    pService->NotifyTransactionUpdate(updateTransaction);
+        CTransactionUpdate updateTransaction;
+        updateTransaction.hashFork = admission.hashFork; 
+        updateTransaction.txUpdate = tx;
+        pService->NotifyTransactionUpdate(updateTransaction);
 
-    if (!nNonce)
+        if (!admission.nNonce)
+        {
+            mapBroadcastTx[admission.hashFork].push_back(make_pair(admission.txid,tx.GetFeeRate()));
+        }
+    }
+
+    for (map<uint256,vector<pair<uint256,int64> > >::iterator it = mapBroadcastTx.begin();
+         it != mapBroadcastTx.end();++it)
     {
-        pNetChannel->BroadcastTxInv(hashFork);
+        pNetChannel->BroadcastTxInv((*it).first,(*it).second);
     }
-    return MV_OK;
 }
@@ -18,6 +18,7 @@ public:
     ~CDispatcher();
     MvErr AddNewBlock(CBlock& block,uint64 nNonce=0);
     MvErr AddNewTx(CTransaction& tx,uint64 nNonce=0);
+    void AddNewTx(std::vector<CTxAdmission>& vAdmission);
 protected:
     bool WalleveHandleInitialize();
     void WalleveHandleDeinitialize();
@@ -225,7 +225,9 @@ bool CMvEntry::InitializeModules(const EModeType& mode)
                 {
                     return false;
                 }
-                dynamic_cast<CHttpServer*>(pBase)->AddNewHost(GetRPCHostConfig());
+                CHttpServer* pHttpServer = dynamic_cast<CHttpServer*>(pBase);
+                pHttpServer->AddNewHost(GetRPCHostConfig());
+                pHttpServer->SetIOThreadCount(CastConfigPtr<CMvRPCConfig*>(mvConfig.GetConfig())->nRPCThreads);
 
                 if (!AttachModule(new CRPCMod()))
                 {
@@ -15,6 +15,7 @@ CMvBasicConfig::CMvBasicConfig()
     po::options_description desc("MvBasic");
 
     AddOpt<bool>(desc, "testnet", fTestNet, false);
+    AddOpt<std::string>(desc, "assumevalid", strAssumeValid, "");
 
     AddOptions(desc);
 }
@@ -49,6 +49,7 @@ public:
 public:
     unsigned int nMagicNum;
     bool fTestNet;
+    std::string strAssumeValid;
 
 protected:
     template <typename T>
@@ -12,6 +12,7 @@ using namespace multiverse;
 #define DEFAULT_MAX_INBOUNDS 125
 #define DEFAULT_MAX_OUTBOUNDS 10
 #define DEFAULT_CONNECT_TIMEOUT 5
+#define DEFAULT_NET_THREADS 1
 
 CMvNetworkConfig::CMvNetworkConfig()
 {
@@ -19,11 +20,16 @@ CMvNetworkConfig::CMvNetworkConfig()
 
     AddOpt<bool>(desc, "listen", fListen, false);
     AddOpt<bool>(desc, "bloom", fBloom, true);
+    AddOpt<bool>(desc, "compress", fCompress, true);
+    AddOpt<bool>(desc, "fastchecksum", fFastChecksum, true);
     AddOpt<int>(desc, "port", nPortInt, 0);
     AddOpt<int>(desc, "maxconnections", nMaxConnection,
                 DEFAULT_MAX_OUTBOUNDS + DEFAULT_MAX_INBOUNDS);
     AddOpt<unsigned int>(desc, "timeout", nConnectTimeout,
                          DEFAULT_CONNECT_TIMEOUT);
+    AddOpt<unsigned int>(desc, "netthreads", nNetThreads,
+                         DEFAULT_NET_THREADS);
+    AddOpt<unsigned int>(desc, "peeruploadrate", nPeerUploadRate, 0);
     AddOpt<std::vector<std::string> >(desc, "addnode", vNode);
     AddOpt<std::vector<std::string> >(desc, "connect", vConnectTo);
 
@@ -57,6 +63,11 @@ bool CMvNetworkConfig::PostLoad()
         nConnectTimeout = 1;
     }
 
+    if (nNetThreads == 0)
+    {
+        nNetThreads = 1;
+    }
+
     if (!fTestNet)
     {
         //        vDNSeed.push_back("123.56.69.80");
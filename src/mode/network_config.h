@@ -23,10 +23,14 @@ public:
 public:
     bool fListen;
     bool fBloom;
+    bool fCompress;
+    bool fFastChecksum;
     unsigned short nPort;
     unsigned int nMaxInBounds;
     unsigned int nMaxOutBounds;
     unsigned int nConnectTimeout;
+    unsigned int nNetThreads;
+    unsigned int nPeerUploadRate;
     std::vector<std::string> vNode;
     std::vector<std::string> vConnectTo;
     std::vector<std::string> vDNSeed;
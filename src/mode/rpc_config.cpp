@@ -15,6 +15,7 @@ using namespace multiverse;
 #define DEFAULT_TESTNET_RPCPORT 6814
 #define DEFAULT_RPC_MAX_CONNECTIONS 5
 #define DEFAULT_RPC_CONNECT_TIMEOUT 120
+#define DEFAULT_RPC_THREADS 1
 
 CMvRPCConfig::CMvRPCConfig()
 {
@@ -26,6 +27,8 @@ CMvRPCConfig::CMvRPCConfig()
                          DEFAULT_RPC_CONNECT_TIMEOUT);
     AddOpt<unsigned int>(desc, "rpcmaxconnections", nRPCMaxConnections,
                          DEFAULT_RPC_MAX_CONNECTIONS);
+    AddOpt<unsigned int>(desc, "rpcthreads", nRPCThreads,
+                         DEFAULT_RPC_THREADS);
     AddOpt<std::vector<std::string> >(desc, "rpcallowip", vRPCAllowIP);
 
     AddOpt<std::string>(desc, "rpcwallet", strRPCWallet, "");
@@ -63,6 +66,11 @@ bool CMvRPCConfig::PostLoad()
         nRPCConnectTimeout = 1;
     }
 
+    if (nRPCThreads == 0)
+    {
+        nRPCThreads = 1;
+    }
+
     epRPC = tcp::endpoint(!vRPCAllowIP.empty()
                               ? boost::asio::ip::address_v4::any()
                               : boost::asio::ip::address_v4::loopback(),
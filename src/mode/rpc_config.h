@@ -28,6 +28,7 @@ public:
     unsigned int nRPCPort;
     unsigned int nRPCConnectTimeout;
     unsigned int nRPCMaxConnections;
+    unsigned int nRPCThreads;
     std::vector<std::string> vRPCAllowIP;
     std::string strRPCWallet;
     std::string strRPCUser;
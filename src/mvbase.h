@@ -35,10 +35,19 @@ public:
     virtual MvErr ValidateTransaction(const CTransaction& tx) = 0;
     virtual MvErr ValidateBlock(CBlock& block) = 0;
     virtual MvErr VerifyBlock(CBlock& block,CBlockIndex* pIndexPrev) = 0;
-    virtual MvErr VerifyBlockTx(CTransaction& tx,CTxContxt& txContxt,CBlockIndex* pIndexPrev) = 0;
+    virtual MvErr VerifyBlockHeader(CBlock& block,CBlockIndex* pIndexPrev) = 0;
+    virtual MvErr VerifyBlockTx(CBlockEx& block,CBlockIndex* pIndexPrev,std::size_t& nInvalidTx) = 0;
     virtual MvErr VerifyTransaction(CTransaction& tx,const std::vector<CTxOutput>& vPrevOutput,int nForkHeight) = 0;
     virtual bool GetProofOfWorkTarget(CBlockIndex* pIndexPrev,int nAlgo,int& nBits,int64& nReward) = 0;
     virtual int GetProofOfWorkRunTimeBits(int nBits,int64 nTime,int64 nPrevTime) = 0;
+    virtual const uint256& GetAssumeValidBlockHash() = 0;
+    virtual void AddAssumeValidBlock(const std::vector<std::pair<int,uint256> >& vBlock) = 0;
+    virtual void PruneAssumeValidBlock(int nHeight) = 0;
+
+    const CMvBasicConfig * WalleveConfig()
+    {
+        return dynamic_cast<const CMvBasicConfig *>(walleve::IWalleveBase::WalleveConfig());
+    }
 };
 
 class IWorldLine : public walleve::IWalleveBase
@@ -50,6 +59,7 @@ public:
     virtual bool GetBlockHash(const uint256& hashFork,int nHeight,uint256& hashBlock) = 0;
     virtual bool GetLastBlock(const uint256& hashFork,uint256& hashBlock,int& nHeight,int64& nTime) = 0;
     virtual bool GetBlock(const uint256& hashBlock,CBlock& block) = 0;
+    virtual bool GetBlockRaw(const uint256& hashBlock,std::vector<char>& vRaw) = 0;
     virtual bool Exists(const uint256& hashBlock) = 0;
     virtual bool GetTransaction(const uint256& txid,CTransaction& tx) = 0;
     virtual bool GetTxLocation(const uint256& txid,uint256& hashFork,int& nHeight) = 0;
@@ -61,6 +71,8 @@ public:
     virtual bool GetProofOfWorkTarget(const uint256& hashPrev,int nAlgo,int& nBits,int64& nReward) = 0;
     virtual bool GetBlockLocator(const uint256& hashFork,CBlockLocator& locator) = 0;
     virtual bool GetBlockInv(const uint256& hashFork,const CBlockLocator& locator,std::vector<uint256>& vBlockHash,std::size_t nMaxCount) = 0;
+    virtual bool GetBlockHeaders(const uint256& hashFork,const CBlockLocator& locator,std::vector<CBlock>& vHeader,std::size_t nMaxCount) = 0;
+    virtual bool GetBlockIndex(const uint256& hashBlock,CBlockIndex** ppIndex) = 0;
 
     const CMvBasicConfig * WalleveConfig()
     {
@@ -80,12 +92,14 @@ public:
     virtual void Clear() = 0;
     virtual std::size_t Count(const uint256& fork) const = 0;
     virtual MvErr Push(CTransaction& tx,uint256& hashFork,CDestination& destIn,int64& nValueIn) = 0;
+    virtual void Push(std::vector<CTxAdmission>& vAdmission) = 0;
     virtual void Pop(const uint256& txid) = 0;
     virtual bool Get(const uint256& txid,CTransaction& tx) const = 0;
     virtual void ListTx(const uint256& hashFork,std::vector<std::pair<uint256,std::size_t> >& vTxPool) = 0;
     virtual void ListTx(const uint256& hashFork,std::vector<uint256>& vTxPool) = 0;
     virtual bool FilterTx(CTxFilter& filter) = 0;
     virtual void ArrangeBlockTx(const uint256& hashFork,std::size_t nMaxSize,std::vector<CTransaction>& vtx,int64& nTotalTxFee) = 0;
+    virtual void GetArrangedBlockTx(const uint256& hashFork,std::size_t nMaxSize,CArrangedBlockTxPtr& spArranged) = 0;
     virtual bool FetchInputs(const uint256& hashFork,const CTransaction& tx,std::vector<CTxOutput>& vUnspent) = 0;
     virtual bool SynchronizeWorldLine(CWorldLineUpdate& update,CTxSetChange& change) = 0;
     const CMvStorageConfig * StorageConfig()
@@ -152,6 +166,7 @@ public:
     IDispatcher() : IWalleveBase("dispatcher") {}
     virtual MvErr AddNewBlock(CBlock& block,uint64 nNonce=0) = 0;
     virtual MvErr AddNewTx(CTransaction& tx,uint64 nNonce=0) = 0;
+    virtual void AddNewTx(std::vector<CTxAdmission>& vAdmission) = 0;
 };
 
 class IService : public walleve::IWalleveBase
@@ -6,6 +6,7 @@
 #define  MULTIVERSE_TYPE_H
 
 #include "uint256.h"
+#include "error.h"
 #include "block.h"
 #include "transaction.h"
 #include "mvproto.h"
@@ -14,6 +15,7 @@
 #include <map>
 #include <set>
 
+#include <boost/shared_ptr.hpp>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/ordered_index.hpp>
@@ -94,6 +96,80 @@ public:
     std::vector<std::pair<uint256,std::vector<CTxIn> > > vTxRemove;
 };
 
+class CTxAdmission
+{
+public:
+    CTxAdmission(CTransaction* pTxIn=NULL,uint64 nNonceIn=0)
+    : pTx(pTxIn),nNonce(nNonceIn),nForkHeight(0),nValueIn(0),nSyncCount(0),err(MV_FAILED) {}
+public:
+    CTransaction* pTx;
+    uint64 nNonce;
+    uint256 txid;
+    uint256 hashFork;
+    int nForkHeight;
+    CDestination destIn;
+    int64 nValueIn;
+    std::vector<CTxOutput> vPrevOutput;
+    std::size_t nSyncCount;
+    MvErr err;
+};
+
+// Txs arranged for the next block of a fork, kept up to date by txpool.
+// Merkle levels are stored so that appending a tx rehashes one path only
+class CArrangedBlockTx
+{
+public:
+    CArrangedBlockTx(std::size_t nMaxSizeIn=0) : nMaxSize(nMaxSizeIn),fComplete(true),nTotalTxFee(0),nTotalSize(0) {}
+    bool IsUsable(std::size_t nMaxSizeIn) const
+    {
+        return (nMaxSize == nMaxSizeIn || (fComplete && nTotalSize <= nMaxSizeIn));
+    }
+    void AddTx(const CTransaction& tx,const uint256& txid,int64 nTxFee,std::size_t nSize)
+    {
+        vtx.push_back(tx);
+        nTotalTxFee += nTxFee;
+        nTotalSize += nSize;
+        if (vMerkleLevel.empty())
+        {
+            vMerkleLevel.resize(1);
+        }
+        vMerkleLevel[0].push_back(txid);
+        for (std::size_t k = 0;vMerkleLevel[k].size() > 1;k++)
+        {
+            if (k + 1 == vMerkleLevel.size())
+            {
+                vMerkleLevel.resize(k + 2);
+            }
+            const std::vector<uint256>& vLevel = vMerkleLevel[k];
+            std::size_t nParent = (vLevel.size() - 1) / 2;
+            std::size_t n2 = std::min(nParent * 2 + 1,vLevel.size() - 1);
+            uint256 hash = crypto::CryptoHash(vLevel[nParent * 2],vLevel[n2]);
+            std::vector<uint256>& vUpper = vMerkleLevel[k + 1];
+            if (nParent < vUpper.size())
+            {
+                vUpper[nParent] = hash;
+            }
+            else
+            {
+                vUpper.push_back(hash);
+            }
+        }
+    }
+    uint256 GetMerkleRoot() const
+    {
+        return (vMerkleLevel.empty() ? uint256(0) : vMerkleLevel.back()[0]);
+    }
+public:
+    std::size_t nMaxSize;
+    bool fComplete;
+    int64 nTotalTxFee;
+    std::size_t nTotalSize;
+    std::vector<CTransaction> vtx;
+    std::vector<std::vector<uint256> > vMerkleLevel;
+};
+
+typedef boost::shared_ptr<const CArrangedBlockTx> CArrangedBlockTxPtr;
+
 class CNetworkPeerUpdate
 {
 public:
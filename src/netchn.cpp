@@ -34,6 +34,18 @@ void CNetChannelPeer::CNetChannelPeerFork::ClearExpiredTx(size_t nReserved)
     }
 }
 
+void CNetChannelPeer::CNetChannelPeerFork::AddPendingTx(const uint256& txid,int64 nFeeRate)
+{
+    if (!IsKnownTx(txid))
+    {
+        setPendingTx.insert(make_pair(nFeeRate,txid));
+        if (setPendingTx.size() > NETCHANNEL_PENDINGTX_MAXCOUNT)
+        {
+            setPendingTx.erase(setPendingTx.begin());
+        }
+    }
+}
+
 bool CNetChannelPeer::IsSynchronized(const uint256& hashFork) const
 {
     map<uint256,CNetChannelPeerFork>::const_iterator it = mapSubscribedFork.find(hashFork);
@@ -65,6 +77,18 @@ void CNetChannelPeer::AddKnownTx(const uint256& hashFork,const vector<uint256>&
     }
 }
 
+void CNetChannelPeer::AddPendingTx(const uint256& hashFork,const vector<pair<uint256,int64> >& vTxFeeRate)
+{
+    map<uint256,CNetChannelPeerFork>::iterator it = mapSubscribedFork.find(hashFork);
+    if (it != mapSubscribedFork.end())
+    {
+        for (vector<pair<uint256,int64> >::const_iterator mi = vTxFeeRate.begin();mi != vTxFeeRate.end();++mi)
+        {
+            (*it).second.AddPendingTx((*mi).first,(*mi).second);
+        }
+    }
+}
+
 void CNetChannelPeer::MakeTxInv(const uint256& hashFork,const vector<uint256>& vTxPool,
                                                         vector<network::CInv>& vInv,size_t nMaxCount)
 {
@@ -89,6 +113,28 @@ void CNetChannelPeer::MakeTxInv(const uint256& hashFork,const vector<uint256>& v
     }
 }
 
+void CNetChannelPeer::MakePendingTxInv(const uint256& hashFork,vector<network::CInv>& vInv,size_t nMaxCount)
+{
+    map<uint256,CNetChannelPeerFork>::iterator it = mapSubscribedFork.find(hashFork);
+    if (it != mapSubscribedFork.end())
+    {
+        vector<uint256> vTxHash;
+        CNetChannelPeerFork& peerFork = (*it).second;
+        while (!peerFork.setPendingTx.empty() && vInv.size() < nMaxCount)
+        {
+            set<pair<int64,uint256> >::iterator mi = --peerFork.setPendingTx.end();
+            const uint256& txid = (*mi).second;
+            if (!peerFork.IsKnownTx(txid))
+            {
+                vInv.push_back(network::CInv(network::CInv::MSG_TX,txid));
+                vTxHash.push_back(txid);
+            }
+            peerFork.setPendingTx.erase(mi);
+        }
+        peerFork.AddKnownTx(vTxHash);
+    }
+}
+
 //////////////////////////////
 // CNetChannel 
 
@@ -100,6 +146,10 @@ CNetChannel::CNetChannel()
     pTxPool = NULL;
     pService = NULL;
     pDispatcher = NULL;
+    nSyncTimerId = 0;
+    nHeadersSyncHeight = 0;
+    nHeadersSyncTime = 0;
+    nTxTrickleTimerId = 0;
 }
 
 CNetChannel::~CNetChannel()
@@ -159,12 +209,20 @@ void CNetChannel::WalleveHandleDeinitialize()
 bool CNetChannel::WalleveHandleInvoke()
 {
     mapSched.insert(make_pair(pCoreProtocol->GetGenesisBlockHash(),CSchedule()));
+    nSyncTimerId = WalleveSetTimer(SYNC_TIMER_INTERVAL,boost::bind(&CNetChannel::SyncTimerFunc,this,_1));
+    nTxTrickleTimerId = WalleveSetTimer(TX_TRICKLE_TICK,boost::bind(&CNetChannel::TxTrickleTimerFunc,this,_1));
     return network::IMvNetChannel::WalleveHandleInvoke(); 
 }
 
 void CNetChannel::WalleveHandleHalt()
 {
+    WalleveCancelTimer(nSyncTimerId);
+    nSyncTimerId = 0;
+    WalleveCancelTimer(nTxTrickleTimerId);
+    nTxTrickleTimerId = 0;
     mapSched.clear();
+    headerChain.Clear();
+    mapPartialBlock.clear();
     network::IMvNetChannel::WalleveHandleHalt();
 }
 
@@ -198,25 +256,14 @@ void CNetChannel::BroadcastBlockInv(const uint256& hashFork,const uint256& hashB
     }
 }
 
-void CNetChannel::BroadcastTxInv(const uint256& hashFork)
+void CNetChannel::BroadcastTxInv(const uint256& hashFork,const vector<pair<uint256,int64> >& vTxFeeRate)
 {
-    vector<uint256> vTxPool;
-    pTxPool->ListTx(hashFork,vTxPool);
-    if (!vTxPool.empty() && !mapPeer.empty())
+    if (!vTxFeeRate.empty())
     {
         boost::unique_lock<boost::shared_mutex> wlock(rwNetPeer);    
         for (map<uint64,CNetChannelPeer>::iterator it = mapPeer.begin();it != mapPeer.end();++it)
         {
-            CNetChannelPeer& peer = (*it).second;
-            if (peer.IsSubscribed(hashFork))
-            {
-                network::CMvEventPeerInv eventInv((*it).first,hashFork);
-                peer.MakeTxInv(hashFork,vTxPool,eventInv.data,network::CInv::MAX_INV_COUNT);
-                if (!eventInv.data.empty())
-                {
-                    pPeerNet->DispatchEvent(&eventInv);
-                }
-            }
+            (*it).second.AddPendingTx(hashFork,vTxFeeRate);
         }
     } 
 }
@@ -224,14 +271,14 @@ void CNetChannel::BroadcastTxInv(const uint256& hashFork)
 bool CNetChannel::HandleEvent(network::CMvEventPeerActive& eventActive)
 {
     uint64 nNonce = eventActive.nNonce;
-    if ((eventActive.data.nService & network::NODE_NETWORK))
-    {
-        DispatchGetBlocksEvent(nNonce,pCoreProtocol->GetGenesisBlockHash());
-    }
     {
         boost::unique_lock<boost::shared_mutex> wlock(rwNetPeer);    
         mapPeer[nNonce] = CNetChannelPeer(eventActive.data.nService,pCoreProtocol->GetGenesisBlockHash());   
     }
+    if ((eventActive.data.nService & network::NODE_NETWORK))
+    {
+        DispatchSyncEvent(nNonce,pCoreProtocol->GetGenesisBlockHash());
+    }
     NotifyPeerUpdate(nNonce,true,eventActive.data);    
     return true;
 }
@@ -251,6 +298,18 @@ bool CNetChannel::HandleEvent(network::CMvEventPeerDeactive& eventDeactive)
             SchedulePeerInv(nNonceSched,(*it).first,sched);
         }
     }
+    headerChain.RemovePeer(nNonce);
+    for (map<uint256,CNetChannelPartialBlock>::iterator it = mapPartialBlock.begin();it != mapPartialBlock.end();)
+    {
+        if ((*it).second.nNonce == nNonce)
+        {
+            mapPartialBlock.erase(it++);
+        }
+        else
+        {
+            ++it;
+        }
+    }
     {
         boost::unique_lock<boost::shared_mutex> wlock(rwNetPeer);    
         mapPeer.erase(nNonce);
@@ -316,10 +375,20 @@ bool CNetChannel::HandleEvent(network::CMvEventPeerGetData& eventGetData)
         }
         else if (inv.nType == network::CInv::MSG_BLOCK)
         {
-            network::CMvEventPeerBlock eventBlock(nNonce,hashFork);
-            if (pWorldLine->GetBlock(inv.nHash,eventBlock.data))
+            network::CMvEventPeerRawBlock eventRawBlock(nNonce,hashFork);
+            if (pWorldLine->GetBlockRaw(inv.nHash,eventRawBlock.data))
             {
-                pPeerNet->DispatchEvent(&eventBlock);
+                pPeerNet->DispatchEvent(&eventRawBlock);
+            }
+        }
+        else if (inv.nType == network::CInv::MSG_CMPCT_BLOCK)
+        {
+            CBlock block;
+            if (pWorldLine->GetBlock(inv.nHash,block))
+            {
+                network::CMvEventPeerCmpctBlock eventCmpctBlock(nNonce,hashFork);
+                eventCmpctBlock.data = CCompactBlock(block,crypto::CryptoGetRand64());
+                pPeerNet->DispatchEvent(&eventCmpctBlock);
             }
         }
     }
@@ -345,6 +414,101 @@ bool CNetChannel::HandleEvent(network::CMvEventPeerGetBlocks& eventGetBlocks)
     return true;
 }
 
+bool CNetChannel::HandleEvent(network::CMvEventPeerGetHeaders& eventGetHeaders)
+{
+    uint64 nNonce = eventGetHeaders.nNonce;
+    uint256& hashFork = eventGetHeaders.hashFork;
+    network::CMvEventPeerHeaders eventHeaders(nNonce,hashFork);
+    if (!pWorldLine->GetBlockHeaders(hashFork,eventGetHeaders.data,eventHeaders.data,MAX_GETHEADERS_COUNT))
+    {
+        DispatchMisbehaveEvent(nNonce,CEndpointManager::DDOS_ATTACK);
+        return true;
+    }
+    pPeerNet->DispatchEvent(&eventHeaders);
+    return true;
+}
+
+bool CNetChannel::HandleEvent(network::CMvEventPeerHeaders& eventHeaders)
+{
+    uint64 nNonce = eventHeaders.nNonce;
+    uint256& hashFork = eventHeaders.hashFork;
+    vector<CBlock>& vHeader = eventHeaders.data;
+    try
+    {
+        if (vHeader.size() > MAX_GETHEADERS_COUNT)
+        {
+            throw runtime_error("Headers count overflow.");
+        }
+        if (hashFork != pCoreProtocol->GetGenesisBlockHash())
+        {
+            throw runtime_error("Headers of non-primary fork.");
+        }
+
+        CSchedule& sched = GetSchedule(hashFork);
+        CBlockIndex* pIndexLast = NULL;
+        bool fFull = false;
+        if (headerChain.IsEmpty())
+        {
+            nHeadersSyncHeight = 0;
+            nHeadersSyncTime = GetTime();
+        }
+        BOOST_FOREACH(CBlock& header,vHeader)
+        {
+            uint256 hash = header.GetHash();
+            if (!header.vtx.empty() || header.IsOrigin() || headerChain.IsInvalid(hash)
+                || (pIndexLast != NULL && header.hashPrev != pIndexLast->GetBlockHash()))
+            {
+                throw runtime_error("Invalid header.");
+            }
+
+            CBlockIndex* pIndex = headerChain.GetIndex(hash);
+            if (pIndex == NULL && !pWorldLine->GetBlockIndex(hash,&pIndex))
+            {
+                CBlockIndex* pIndexPrev = pIndexLast;
+                if (pIndexPrev == NULL && (pIndexPrev = headerChain.GetIndex(header.hashPrev)) == NULL
+                    && !pWorldLine->GetBlockIndex(header.hashPrev,&pIndexPrev))
+                {
+                    // not connected to known headers, ignored
+                    break;
+                }
+                if (pIndexPrev->GetOriginHash() != hashFork
+                    || pCoreProtocol->VerifyBlockHeader(header,pIndexPrev) != MV_OK)
+                {
+                    throw runtime_error("Invalid header.");
+                }
+                if ((pIndex = headerChain.AddNew(hash,header,pIndexPrev)) == NULL)
+                {
+                    fFull = true;
+                    break;
+                }
+                if (hash == pCoreProtocol->GetAssumeValidBlockHash())
+                {
+                    AddAssumeValidChain(pIndex);
+                }
+            }
+            pIndexLast = pIndex;
+        }
+
+        if (pIndexLast != NULL)
+        {
+            headerChain.SetPeerBest(nNonce,pIndexLast);
+            if (vHeader.size() == MAX_GETHEADERS_COUNT && !fFull)
+            {
+                DispatchGetHeadersEvent(nNonce,hashFork,pIndexLast->GetBlockHash());
+            }
+        }
+
+        set<uint64> setSchedPeer,setMisbehavePeer;
+        ScheduleHeaderBlock(hashFork,sched,setSchedPeer);
+        PostAddNew(hashFork,sched,setSchedPeer,setMisbehavePeer);
+    }
+    catch (...)
+    {
+        DispatchMisbehaveEvent(nNonce,CEndpointManager::DDOS_ATTACK);
+    }
+    return true;
+}
+
 bool CNetChannel::HandleEvent(network::CMvEventPeerTx& eventTx)
 {
     uint64 nNonce = eventTx.nNonce;
@@ -415,8 +579,15 @@ bool CNetChannel::HandleEvent(network::CMvEventPeerBlock& eventBlock)
         
         if (!sched.ReceiveBlock(nNonce,hash,block,setSchedPeer))
         {
+            if (sched.IsLateBlock(nNonce,hash) || pWorldLine->Exists(hash))
+            {
+                // reassigned after stalling, the other peer's copy is taken or already connected
+                return true;
+            }
             throw runtime_error("Failed to receive block");
         }
+        // a compact block of the peer it was taken from is not completed any more
+        mapPartialBlock.erase(hash);
 
         uint256 hashForkPrev;
         int nHeightPrev;
@@ -436,6 +607,7 @@ bool CNetChannel::HandleEvent(network::CMvEventPeerBlock& eventBlock)
             sched.AddOrphanBlockPrev(hash,block.hashPrev);
         }
 
+        ScheduleHeaderBlock(hashFork,sched,setSchedPeer);
         PostAddNew(hashFork,sched,setSchedPeer,setMisbehavePeer);
     }
     catch (...)
@@ -445,6 +617,204 @@ bool CNetChannel::HandleEvent(network::CMvEventPeerBlock& eventBlock)
     return true;
 }
 
+bool CNetChannel::HandleEvent(network::CMvEventPeerCmpctBlock& eventCmpctBlock)
+{
+    uint64 nNonce = eventCmpctBlock.nNonce;
+    uint256& hashFork = eventCmpctBlock.hashFork;
+    CCompactBlock& cmpct = eventCmpctBlock.data;
+    try
+    {
+        CSchedule& sched = GetSchedule(hashFork);
+        uint256 hash = cmpct.header.GetHash();
+        if (!sched.IsAssigned(network::CInv(network::CInv::MSG_BLOCK,hash),nNonce))
+        {
+            if (sched.IsLateBlock(nNonce,hash) || pWorldLine->Exists(hash))
+            {
+                // reassigned after stalling, the other peer's copy is taken or already connected
+                return true;
+            }
+            throw runtime_error("Unrequested compact block.");
+        }
+        map<uint256,CNetChannelPartialBlock>::iterator it = mapPartialBlock.find(hash);
+        if (!cmpct.IsValid() || (it != mapPartialBlock.end() && (*it).second.nNonce == nNonce))
+        {
+            throw runtime_error("Unrequested compact block.");
+        }
+        if (it != mapPartialBlock.end())
+        {
+            // left by the peer the block was taken from
+            mapPartialBlock.erase(it);
+        }
+
+        // the tx count comes from the peer, bound it by what fits in a block
+        size_t nTx = cmpct.GetTxCount();
+        if (nTx > MAX_BLOCK_SIZE / GetSerializeSize(CTransaction()))
+        {
+            throw runtime_error("Too many txs in compact block.");
+        }
+
+        CBlock block = cmpct.header;
+        block.vtx.resize(nTx);
+        vector<bool> vFilled(nTx,false);
+
+        // short ids shared by several txs of the block are left to the round trip
+        map<uint64,size_t> mapShortId;
+        for (size_t i = 0;i < nTx;i++)
+        {
+            if (!mapShortId.insert(make_pair(cmpct.GetShortId(i),i)).second)
+            {
+                mapShortId[cmpct.GetShortId(i)] = nTx;
+            }
+        }
+
+        uint64 k0,k1;
+        cmpct.GetShortIdKey(k0,k1);
+        vector<uint256> vTxPool;
+        pTxPool->ListTx(hashFork,vTxPool);
+        BOOST_FOREACH(const uint256& txid,vTxPool)
+        {
+            map<uint64,size_t>::iterator it = mapShortId.find(CCompactBlock::MakeShortId(k0,k1,txid));
+            if (it != mapShortId.end() && (*it).second < nTx && !vFilled[(*it).second])
+            {
+                vFilled[(*it).second] = pTxPool->Get(txid,block.vtx[(*it).second]);
+            }
+        }
+
+        vector<uint32> vMissing;
+        for (size_t i = 0;i < nTx;i++)
+        {
+            if (!vFilled[i])
+            {
+                vMissing.push_back(i);
+            }
+        }
+
+        if (vMissing.empty())
+        {
+            CompleteCompactBlock(nNonce,hashFork,block);
+        }
+        else
+        {
+            CNetChannelPartialBlock& partial = mapPartialBlock[hash];
+            partial.nNonce = nNonce;
+            partial.hashFork = hashFork;
+            partial.block = block;
+            partial.vMissing = vMissing;
+
+            network::CMvEventPeerGetBlockTxn eventGetBlockTxn(nNonce,hashFork);
+            eventGetBlockTxn.data.hashBlock = hash;
+            eventGetBlockTxn.data.vIndex = vMissing;
+            pPeerNet->DispatchEvent(&eventGetBlockTxn);
+        }
+    }
+    catch (...)
+    {
+        DispatchMisbehaveEvent(nNonce,CEndpointManager::DDOS_ATTACK);
+    }
+    return true;
+}
+
+bool CNetChannel::HandleEvent(network::CMvEventPeerGetBlockTxn& eventGetBlockTxn)
+{
+    uint64 nNonce = eventGetBlockTxn.nNonce;
+    uint256& hashFork = eventGetBlockTxn.hashFork;
+    CBlock block;
+    if (pWorldLine->GetBlock(eventGetBlockTxn.data.hashBlock,block))
+    {
+        // indexes must be strictly increasing, so no tx can be asked for twice
+        const vector<uint32>& vIndex = eventGetBlockTxn.data.vIndex;
+        if (vIndex.size() > block.vtx.size())
+        {
+            DispatchMisbehaveEvent(nNonce,CEndpointManager::DDOS_ATTACK);
+            return true;
+        }
+        for (size_t i = 0;i < vIndex.size();i++)
+        {
+            if (vIndex[i] >= block.vtx.size() || (i > 0 && vIndex[i] <= vIndex[i - 1]))
+            {
+                DispatchMisbehaveEvent(nNonce,CEndpointManager::DDOS_ATTACK);
+                return true;
+            }
+        }
+
+        network::CMvEventPeerBlockTxn eventBlockTxn(nNonce,hashFork);
+        eventBlockTxn.data.hashBlock = eventGetBlockTxn.data.hashBlock;
+        eventBlockTxn.data.vtx.reserve(vIndex.size());
+        BOOST_FOREACH(const uint32 nIndex,vIndex)
+        {
+            eventBlockTxn.data.vtx.push_back(block.vtx[nIndex]);
+        }
+        pPeerNet->DispatchEvent(&eventBlockTxn);
+    }
+    return true;
+}
+
+bool CNetChannel::HandleEvent(network::CMvEventPeerBlockTxn& eventBlockTxn)
+{
+    uint64 nNonce = eventBlockTxn.nNonce;
+    vector<CTransaction>& vtx = eventBlockTxn.data.vtx;
+    const uint256& hashBlock = eventBlockTxn.data.hashBlock;
+    map<uint256,CNetChannelPartialBlock>::iterator it = mapPartialBlock.find(hashBlock);
+    if (it == mapPartialBlock.end() || (*it).second.nNonce != nNonce)
+    {
+        map<uint256,CSchedule>::iterator itSched = mapSched.find(eventBlockTxn.hashFork);
+        if ((itSched != mapSched.end() && (*itSched).second.IsLateBlock(nNonce,hashBlock))
+            || pWorldLine->Exists(hashBlock))
+        {
+            // the partial block was dropped when the block was taken from this peer
+            return true;
+        }
+        DispatchMisbehaveEvent(nNonce,CEndpointManager::DDOS_ATTACK);
+        return true;
+    }
+    if ((*it).second.vMissing.size() != vtx.size())
+    {
+        DispatchMisbehaveEvent(nNonce,CEndpointManager::DDOS_ATTACK);
+        return true;
+    }
+
+    CNetChannelPartialBlock& partial = (*it).second;
+    for (size_t i = 0;i < vtx.size();i++)
+    {
+        partial.block.vtx[partial.vMissing[i]] = vtx[i];
+    }
+    uint256 hashFork = partial.hashFork;
+    CBlock block = partial.block;
+    mapPartialBlock.erase(it);
+
+    CompleteCompactBlock(nNonce,hashFork,block,true);
+    return true;
+}
+
+bool CNetChannel::HandleEvent(network::CMvEventPeerSyncTimer& eventSyncTimer)
+{
+    if (eventSyncTimer.data != nSyncTimerId)
+    {
+        return true;
+    }
+    const uint256& hashFork = eventSyncTimer.hashFork;
+    map<uint256,CSchedule>::iterator it = mapSched.find(hashFork);
+    if (it != mapSched.end())
+    {
+        set<uint64> setSchedPeer,setMisbehavePeer;
+        ScheduleHeaderBlock(hashFork,(*it).second,setSchedPeer);
+        PostAddNew(hashFork,(*it).second,setSchedPeer,setMisbehavePeer);
+    }
+    nSyncTimerId = WalleveSetTimer(SYNC_TIMER_INTERVAL,boost::bind(&CNetChannel::SyncTimerFunc,this,_1));
+    return true;
+}
+
+bool CNetChannel::HandleEvent(network::CMvEventPeerTxTrickle& eventTxTrickle)
+{
+    if (eventTxTrickle.data != nTxTrickleTimerId)
+    {
+        return true;
+    }
+    FlushPendingTxInv();
+    nTxTrickleTimerId = WalleveSetTimer(TX_TRICKLE_TICK,boost::bind(&CNetChannel::TxTrickleTimerFunc,this,_1));
+    return true;
+}
+
 CSchedule& CNetChannel::GetSchedule(const uint256& hashFork)
 {
     map<uint256,CSchedule>::iterator it = mapSched.find(hashFork);
@@ -473,6 +843,41 @@ void CNetChannel::DispatchGetBlocksEvent(uint64 nNonce,const uint256& hashFork)
     }
 }
 
+void CNetChannel::DispatchGetHeadersEvent(uint64 nNonce,const uint256& hashFork)
+{
+    network::CMvEventPeerGetHeaders eventGetHeaders(nNonce,hashFork);
+    if (pWorldLine->GetBlockLocator(hashFork,eventGetHeaders.data))
+    {
+        CBlockIndex* pIndexBest = headerChain.GetBest();
+        if (pIndexBest != NULL)
+        {
+            vector<uint256>& vBlockHash = eventGetHeaders.data.vBlockHash;
+            vBlockHash.insert(vBlockHash.begin(),pIndexBest->GetBlockHash());
+        }
+        pPeerNet->DispatchEvent(&eventGetHeaders);
+    }
+}
+
+void CNetChannel::DispatchGetHeadersEvent(uint64 nNonce,const uint256& hashFork,const uint256& hashLast)
+{
+    network::CMvEventPeerGetHeaders eventGetHeaders(nNonce,hashFork);
+    eventGetHeaders.data.vBlockHash.push_back(hashLast);
+    pPeerNet->DispatchEvent(&eventGetHeaders);
+}
+
+void CNetChannel::DispatchSyncEvent(uint64 nNonce,const uint256& hashFork)
+{
+    // primary fork is synchronized headers-first with peers supporting it
+    if (hashFork == pCoreProtocol->GetGenesisBlockHash() && IsHeadersPeer(nNonce))
+    {
+        DispatchGetHeadersEvent(nNonce,hashFork);
+    }
+    else
+    {
+        DispatchGetBlocksEvent(nNonce,hashFork);
+    }
+}
+
 void CNetChannel::DispatchAwardEvent(uint64 nNonce,CEndpointManager::Bonus bonus)
 {
     CWalleveEventPeerNetReward eventReward(nNonce);
@@ -492,11 +897,15 @@ void CNetChannel::SchedulePeerInv(uint64 nNonce,const uint256& hashFork,CSchedul
     network::CMvEventPeerGetData eventGetData(nNonce,hashFork);
     bool fMissingPrev = false;
     bool fEmpty = true;
-    if (sched.ScheduleBlockInv(nNonce,eventGetData.data,MAX_PEER_SCHED_COUNT,fMissingPrev,fEmpty))
+    if (sched.ScheduleBlockInv(nNonce,eventGetData.data,fMissingPrev,fEmpty))
     {
         if (fMissingPrev)
         {
-            DispatchGetBlocksEvent(nNonce,hashFork);
+            // during headers-first sync the missing prev is scheduled to other peers
+            if (hashFork != pCoreProtocol->GetGenesisBlockHash() || !IsHeadersSyncing() || !IsHeadersPeer(nNonce))
+            {
+                DispatchSyncEvent(nNonce,hashFork);
+            }
         }
         else if (eventGetData.data.empty())
         {
@@ -511,6 +920,13 @@ void CNetChannel::SchedulePeerInv(uint64 nNonce,const uint256& hashFork,CSchedul
     {
         DispatchMisbehaveEvent(nNonce,CEndpointManager::DDOS_ATTACK);
     }
+    if (eventGetData.data.size() == 1 && eventGetData.data[0].nType == network::CInv::MSG_BLOCK
+        && (hashFork != pCoreProtocol->GetGenesisBlockHash() || !IsHeadersSyncing())
+        && IsCompactPeer(nNonce))
+    {
+        // a single new block is most likely made of txs already in the pool
+        eventGetData.data[0].nType = network::CInv::MSG_CMPCT_BLOCK;
+    }
     if (!eventGetData.data.empty())
     {
         pPeerNet->DispatchEvent(&eventGetData);
@@ -565,6 +981,11 @@ void CNetChannel::AddNewBlock(const uint256& hashFork,const uint256& hash,CSched
             else
             {
                 sched.InvalidateBlock(hashBlock,setMisbehavePeer);
+                if (headerChain.GetIndex(hashBlock) != NULL)
+                {
+                    headerChain.Invalidate(hashBlock);
+                    ResetHeaderChain(hashFork);
+                }
             }
         }
     }
@@ -577,32 +998,42 @@ void CNetChannel::AddNewTx(const uint256& hashFork,const uint256& txid,CSchedule
     vector<uint256> vtx;
 
     vtx.push_back(txid);
-    int nAddNewTx = 0;
-    for (size_t i = 0;i < vtx.size();i++)
+    vector<pair<uint256,int64> > vTxFeeRate;
+    while (!vtx.empty())
     {
-        uint256 hashTx = vtx[i];
-        uint64 nNonceSender = 0;
-        CTransaction *pTx = sched.GetTransaction(hashTx,nNonceSender);
-        if (pTx != NULL)
+        // txs of one generation are admitted as a batch, their children are
+        // collected for the next round so that dependent chains keep order
+        vector<CTxAdmission> vAdmission;
+        BOOST_FOREACH(const uint256& hashTx,vtx)
         {
-            MvErr err = pDispatcher->AddNewTx(*pTx,nNonceSender);
-            if (err == MV_OK)
+            uint64 nNonceSender = 0;
+            CTransaction *pTx = sched.GetTransaction(hashTx,nNonceSender);
+            if (pTx != NULL)
+            {
+                vAdmission.push_back(CTxAdmission(pTx,nNonceSender));
+            }
+        }
+        vtx.clear();
+
+        pDispatcher->AddNewTx(vAdmission);
+
+        BOOST_FOREACH(const CTxAdmission& admission,vAdmission)
+        {
+            const uint256& hashTx = admission.txid;
+            if (admission.err == MV_OK)
             {
                 sched.GetNextTx(hashTx,vtx,setTx);
                 sched.RemoveInv(network::CInv(network::CInv::MSG_TX,hashTx),setSchedPeer);
-                DispatchAwardEvent(nNonceSender,CEndpointManager::MAJOR_DATA);
-                nAddNewTx++;
+                DispatchAwardEvent(admission.nNonce,CEndpointManager::MAJOR_DATA);
+                vTxFeeRate.push_back(make_pair(hashTx,admission.pTx->GetFeeRate()));
             }
-            else if (err != MV_ERR_MISSING_PREV)
+            else if (admission.err != MV_ERR_MISSING_PREV)
             {
                 sched.InvalidateTx(hashTx,setMisbehavePeer);
             }
         }
     }
-    if (nAddNewTx)
-    {
-        BroadcastTxInv(hashFork);
-    }
+    BroadcastTxInv(hashFork,vTxFeeRate);
 }
 
 void CNetChannel::PostAddNew(const uint256& hashFork,CSchedule& sched,
@@ -646,3 +1077,200 @@ void CNetChannel::SetPeerSyncStatus(uint64 nNonce,const uint256& hashFork,bool f
         } 
     }
 }
+
+bool CNetChannel::IsHeadersSyncing()
+{
+    // a stale or partial header chain must not hold the getblocks path back
+    return (!headerChain.IsEmpty() && GetTime() - nHeadersSyncTime < HEADERS_SYNC_STALL_TIMEOUT);
+}
+
+bool CNetChannel::IsHeadersPeer(uint64 nNonce)
+{
+    boost::shared_lock<boost::shared_mutex> rlock(rwNetPeer);
+    map<uint64,CNetChannelPeer>::iterator it = mapPeer.find(nNonce);
+    return (it != mapPeer.end() && ((*it).second.nService & network::NODE_HEADERS));
+}
+
+bool CNetChannel::IsCompactPeer(uint64 nNonce)
+{
+    boost::shared_lock<boost::shared_mutex> rlock(rwNetPeer);
+    map<uint64,CNetChannelPeer>::iterator it = mapPeer.find(nNonce);
+    return (it != mapPeer.end() && ((*it).second.nService & network::NODE_CMPCTBLOCK));
+}
+
+void CNetChannel::CompleteCompactBlock(uint64 nNonce,const uint256& hashFork,CBlock& block,bool fBlockTxn)
+{
+    if (block.CalcMerkleTreeRoot() != block.hashMerkle)
+    {
+        // after a round trip the peer's own txs may be bad, let another peer serve it
+        if (fBlockTxn)
+        {
+            set<uint64> setSchedPeer,setMisbehavePeer;
+            CSchedule& sched = GetSchedule(hashFork);
+            if (sched.ReassignBlock(block.GetHash(),setSchedPeer))
+            {
+                PostAddNew(hashFork,sched,setSchedPeer,setMisbehavePeer);
+                return;
+            }
+        }
+        // short id collision with a pool tx, fall back to the full block
+        network::CMvEventPeerGetData eventGetData(nNonce,hashFork);
+        eventGetData.data.push_back(network::CInv(network::CInv::MSG_BLOCK,block.GetHash()));
+        pPeerNet->DispatchEvent(&eventGetData);
+        return;
+    }
+    network::CMvEventPeerBlock eventBlock(nNonce,hashFork);
+    eventBlock.data = block;
+    HandleEvent(eventBlock);
+}
+
+void CNetChannel::ScheduleHeaderBlock(const uint256& hashFork,CSchedule& sched,set<uint64>& setSchedPeer)
+{
+    CBlockIndex* pIndexBest = headerChain.GetBest();
+    if (hashFork != pCoreProtocol->GetGenesisBlockHash() || pIndexBest == NULL)
+    {
+        return;
+    }
+
+    uint256 hashLast;
+    int nHeightLast;
+    int64 nTimeLast;
+    CBlockIndex* pIndexLast = NULL;
+    if (!pWorldLine->GetLastBlock(hashFork,hashLast,nHeightLast,nTimeLast)
+        || !pWorldLine->GetBlockIndex(hashLast,&pIndexLast))
+    {
+        return;
+    }
+    if (pIndexBest->nChainTrust <= pIndexLast->nChainTrust)
+    {
+        // caught up with the header chain, ask for more if it was truncated
+        if (headerChain.IsFull())
+        {
+            ResetHeaderChain(hashFork);
+        }
+        else
+        {
+            headerChain.Clear();
+        }
+        return;
+    }
+    if (nHeightLast > nHeadersSyncHeight)
+    {
+        nHeadersSyncHeight = nHeightLast;
+        nHeadersSyncTime = GetTime();
+    }
+
+    CBlockIndex* pIndex = NULL;
+    while ((pIndex = headerChain.GetSyncIndex()) != NULL && pWorldLine->Exists(pIndex->GetBlockHash()))
+    {
+        headerChain.SkipSyncIndex();
+    }
+
+    // bodies of the next window are spread over the peers which have announced them,
+    // out-of-order arrivals wait in the orphan pool for their prev. A body held by a
+    // slow peer for too long is handed to the others so that the window keeps moving
+    vector<CBlockIndex*> vWindow;
+    headerChain.GetSyncWindow(MAX_HEADERS_SCHED_WINDOW,vWindow);
+    BOOST_FOREACH(CBlockIndex* pIndexSync,vWindow)
+    {
+        network::CInv inv(network::CInv::MSG_BLOCK,pIndexSync->GetBlockHash());
+        if (sched.Exists(inv))
+        {
+            if (sched.ReassignStalledBlock(inv.nHash,setSchedPeer))
+            {
+                mapPartialBlock.erase(inv.nHash);
+            }
+            continue;
+        }
+        if (pWorldLine->Exists(inv.nHash))
+        {
+            continue;
+        }
+        set<uint64> setKnownPeer;
+        headerChain.GetKnownPeer(pIndexSync,setKnownPeer);
+        BOOST_FOREACH(const uint64 nNonceKnown,setKnownPeer)
+        {
+            sched.AddNewInv(inv,nNonceKnown);
+            setSchedPeer.insert(nNonceKnown);
+        }
+    }
+}
+
+void CNetChannel::AddAssumeValidChain(CBlockIndex* pIndex)
+{
+    // ancestors already in storage were fully verified
+    vector<pair<int,uint256> > vBlock;
+    while (pIndex != NULL && headerChain.GetIndex(pIndex->GetBlockHash()) == pIndex)
+    {
+        vBlock.push_back(make_pair((int)pIndex->nHeight,pIndex->GetBlockHash()));
+        pIndex = pIndex->pPrev;
+    }
+    pCoreProtocol->AddAssumeValidBlock(vBlock);
+}
+
+void CNetChannel::SyncTimerFunc(uint32 nTimerId)
+{
+    network::CMvEventPeerSyncTimer* pEvent = new network::CMvEventPeerSyncTimer(0,pCoreProtocol->GetGenesisBlockHash());
+    if (pEvent != NULL)
+    {
+        pEvent->data = nTimerId;
+        PostEvent(pEvent);
+    }
+}
+
+void CNetChannel::TxTrickleTimerFunc(uint32 nTimerId)
+{
+    network::CMvEventPeerTxTrickle* pEvent = new network::CMvEventPeerTxTrickle(0,pCoreProtocol->GetGenesisBlockHash());
+    if (pEvent != NULL)
+    {
+        pEvent->data = nTimerId;
+        PostEvent(pEvent);
+    }
+}
+
+void CNetChannel::FlushPendingTxInv()
+{
+    // each peer is flushed after its own random delay, so the order in which
+    // peers learn about a tx does not reveal where it came from
+    int64 nNow = GetTimeMillis();
+    boost::unique_lock<boost::shared_mutex> wlock(rwNetPeer);    
+    for (map<uint64,CNetChannelPeer>::iterator it = mapPeer.begin();it != mapPeer.end();++it)
+    {
+        CNetChannelPeer& peer = (*it).second;
+        if (peer.nNextTxTrickle > nNow)
+        {
+            continue;
+        }
+        peer.nNextTxTrickle = nNow + crypto::CryptoGetRand32() % (2 * TX_TRICKLE_INTERVAL);
+        for (map<uint256,CSchedule>::iterator mi = mapSched.begin();mi != mapSched.end();++mi)
+        {
+            network::CMvEventPeerInv eventInv((*it).first,(*mi).first);
+            peer.MakePendingTxInv((*mi).first,eventInv.data,MAX_TX_TRICKLE_COUNT);
+            if (!eventInv.data.empty())
+            {
+                pPeerNet->DispatchEvent(&eventInv);
+            }
+        }
+    }
+}
+
+void CNetChannel::ResetHeaderChain(const uint256& hashFork)
+{
+    headerChain.Clear();
+
+    vector<uint64> vPeer;
+    {
+        boost::shared_lock<boost::shared_mutex> rlock(rwNetPeer);
+        for (map<uint64,CNetChannelPeer>::iterator it = mapPeer.begin();it != mapPeer.end();++it)
+        {
+            if (((*it).second.nService & network::NODE_HEADERS) && (*it).second.IsSubscribed(hashFork))
+            {
+                vPeer.push_back((*it).first);
+            }
+        }
+    }
+    BOOST_FOREACH(const uint64 nNonce,vPeer)
+    {
+        DispatchGetHeadersEvent(nNonce,hashFork);
+    }
+}
@@ -19,32 +19,50 @@ class CNetChannelPeer
     public:
         CNetChannelPeerFork() : fSynchronized(true) {}
         enum { NETCHANNEL_KNOWNINV_EXPIREDTIME = 10 * 60,NETCHANNEL_KNOWNINV_MAXCOUNT = 1024 * 8 };
+        enum { NETCHANNEL_PENDINGTX_MAXCOUNT = 1024 * 8 };
         void AddKnownTx(const std::vector<uint256>& vTxHash);
         bool IsKnownTx(const uint256& txid) const {  return (!!setKnownTx.get<0>().count(txid)); }
+        void AddPendingTx(const uint256& txid,int64 nFeeRate);
     protected:
         void ClearExpiredTx(std::size_t nReserved);
     public:
         bool fSynchronized;
         CPeerKnownTxSet setKnownTx;
+        // txs not yet announced, ordered by fee rate
+        std::set<std::pair<int64,uint256> > setPendingTx;
     };
 public:
-    CNetChannelPeer() {}
+    CNetChannelPeer() : nService(0),nNextTxTrickle(0) {}
     CNetChannelPeer(uint64 nServiceIn,const uint256& hashPrimary)
-    : nService(nServiceIn)
+    : nService(nServiceIn),nNextTxTrickle(0)
     {
         mapSubscribedFork.insert(std::make_pair(hashPrimary,CNetChannelPeerFork()));
     }
     bool IsSynchronized(const uint256& hashFork) const;
     bool SetSyncStatus(const uint256& hashFork,bool fSync,bool& fInverted);
     void AddKnownTx(const uint256& hashFork,const std::vector<uint256>& vTxHash);
+    void AddPendingTx(const uint256& hashFork,const std::vector<std::pair<uint256,int64> >& vTxFeeRate);
     bool IsSubscribed(const uint256& hashFork) const { return (!!mapSubscribedFork.count(hashFork)); }
     void MakeTxInv(const uint256& hashFork,const std::vector<uint256>& vTxPool,
                                            std::vector<network::CInv>& vInv,std::size_t nMaxCount);
+    void MakePendingTxInv(const uint256& hashFork,std::vector<network::CInv>& vInv,std::size_t nMaxCount);
 public:
     uint64 nService;
+    int64 nNextTxTrickle;
     std::map<uint256,CNetChannelPeerFork> mapSubscribedFork;
 };
 
+class CNetChannelPartialBlock
+{
+public:
+    CNetChannelPartialBlock() : nNonce(0) {}
+public:
+    uint64 nNonce;
+    uint256 hashFork;
+    CBlock block;
+    std::vector<uint32> vMissing;
+};
+
 class CNetChannel : public network::IMvNetChannel
 {
 public:
@@ -52,10 +70,17 @@ public:
     ~CNetChannel();
     int GetPrimaryChainHeight();
     void BroadcastBlockInv(const uint256& hashFork,const uint256& hashBlock,const std::set<uint64>& setKnownPeer=std::set<uint64>());
-    void BroadcastTxInv(const uint256& hashFork);
+    void BroadcastTxInv(const uint256& hashFork,const std::vector<std::pair<uint256,int64> >& vTxFeeRate);
 protected:
     enum {MAX_GETBLOCKS_COUNT = 128};
+    enum {MAX_GETHEADERS_COUNT = 1024};
     enum {MAX_PEER_SCHED_COUNT = 8};
+    enum {MAX_HEADERS_SCHED_WINDOW = 256};
+    enum {HEADERS_SYNC_STALL_TIMEOUT = 60};
+    enum {SYNC_TIMER_INTERVAL = 2000};
+    enum {TX_TRICKLE_TICK = 100};
+    enum {TX_TRICKLE_INTERVAL = 500};
+    enum {MAX_TX_TRICKLE_COUNT = 1024};
 
     bool WalleveHandleInitialize();
     void WalleveHandleDeinitialize();
@@ -69,10 +94,20 @@ protected:
     bool HandleEvent(network::CMvEventPeerGetBlocks& eventGetBlocks);
     bool HandleEvent(network::CMvEventPeerTx& eventTx);
     bool HandleEvent(network::CMvEventPeerBlock& eventBlock);
+    bool HandleEvent(network::CMvEventPeerGetHeaders& eventGetHeaders);
+    bool HandleEvent(network::CMvEventPeerHeaders& eventHeaders);
+    bool HandleEvent(network::CMvEventPeerCmpctBlock& eventCmpctBlock);
+    bool HandleEvent(network::CMvEventPeerGetBlockTxn& eventGetBlockTxn);
+    bool HandleEvent(network::CMvEventPeerBlockTxn& eventBlockTxn);
+    bool HandleEvent(network::CMvEventPeerSyncTimer& eventSyncTimer);
+    bool HandleEvent(network::CMvEventPeerTxTrickle& eventTxTrickle);
 
     CSchedule& GetSchedule(const uint256& hashFork);
     void NotifyPeerUpdate(uint64 nNonce,bool fActive,const network::CAddress& addrPeer);
     void DispatchGetBlocksEvent(uint64 nNonce,const uint256& hashFork);
+    void DispatchGetHeadersEvent(uint64 nNonce,const uint256& hashFork);
+    void DispatchGetHeadersEvent(uint64 nNonce,const uint256& hashFork,const uint256& hashLast);
+    void DispatchSyncEvent(uint64 nNonce,const uint256& hashFork);
     void DispatchAwardEvent(uint64 nNonce,walleve::CEndpointManager::Bonus bonus);
     void DispatchMisbehaveEvent(uint64 nNonce,walleve::CEndpointManager::CloseReason reason);
     void SchedulePeerInv(uint64 nNonce,const uint256& hashFork,CSchedule& sched);
@@ -84,6 +119,16 @@ protected:
     void PostAddNew(const uint256& hashFork,CSchedule& sched,
                     std::set<uint64>& setSchedPeer,std::set<uint64>& setMisbehavePeer);
     void SetPeerSyncStatus(uint64 nNonce,const uint256& hashFork,bool fSync);
+    bool IsHeadersPeer(uint64 nNonce);
+    bool IsHeadersSyncing();
+    bool IsCompactPeer(uint64 nNonce);
+    void CompleteCompactBlock(uint64 nNonce,const uint256& hashFork,CBlock& block,bool fBlockTxn = false);
+    void ScheduleHeaderBlock(const uint256& hashFork,CSchedule& sched,std::set<uint64>& setSchedPeer);
+    void ResetHeaderChain(const uint256& hashFork);
+    void AddAssumeValidChain(CBlockIndex* pIndex);
+    void SyncTimerFunc(uint32 nTimerId);
+    void TxTrickleTimerFunc(uint32 nTimerId);
+    void FlushPendingTxInv();
 protected:
     network::CMvPeerNet* pPeerNet;
     ICoreProtocol* pCoreProtocol;
@@ -93,7 +138,14 @@ protected:
     IService *pService;
     mutable boost::shared_mutex rwNetPeer; 
     std::map<uint256,CSchedule> mapSched; 
+    CHeaderChain headerChain;
+    // local primary height and the time it last grew while syncing along headerChain
+    int nHeadersSyncHeight;
+    int64 nHeadersSyncTime;
+    std::map<uint256,CNetChannelPartialBlock> mapPartialBlock;
     std::map<uint64,CNetChannelPeer> mapPeer;
+    uint32 nSyncTimerId;
+    uint32 nTxTrickleTimerId;
 };
 
 } // namespace multiverse
@@ -25,8 +25,19 @@ CNetwork::~CNetwork()
 
 bool CNetwork::WalleveHandleInitialize()
 {
-    Configure(NetworkConfig()->nMagicNum,PROTO_VERSION,network::NODE_NETWORK,
-              FormatSubVersion(),!NetworkConfig()->vConnectTo.empty());
+    uint64 nService = network::NODE_NETWORK | network::NODE_HEADERS | network::NODE_CMPCTBLOCK;
+    if (NetworkConfig()->fCompress)
+    {
+        nService |= network::NODE_COMPRESS;
+    }
+    if (NetworkConfig()->fFastChecksum && crypto::crc32c_accelerated())
+    {
+        nService |= network::NODE_CRC32C;
+    }
+    // peeruploadrate is in KB/s per peer, 0 means unlimited
+    Configure(NetworkConfig()->nMagicNum,PROTO_VERSION,nService,
+              FormatSubVersion(),!NetworkConfig()->vConnectTo.empty(),
+              (int64)NetworkConfig()->nPeerUploadRate * 1024);
 
     CPeerNetConfig config;
     if (NetworkConfig()->fListen)
@@ -35,6 +46,7 @@ bool CNetwork::WalleveHandleInitialize()
                                                  NetworkConfig()->nMaxInBounds));
     }
     config.nMaxOutBounds = NetworkConfig()->nMaxOutBounds;
+    config.nIOThreads = NetworkConfig()->nNetThreads;
     config.nPortDefault = NetworkConfig()->nPort;
     BOOST_FOREACH(const string& conn,NetworkConfig()->vConnectTo)
     {
@@ -5,6 +5,7 @@
 #include "rpcmod.h"
 #include "address.h"
 #include "template.h"
+#include "sigcache.h"
 #include "version.h"
 #include <boost/assign/list_of.hpp>
 using namespace std;
@@ -39,6 +40,7 @@ CRPCMod::CRPCMod()
                  ("removependingtx",       &CRPCMod::RPCRemovePendingTx)
                  ("gettransaction",        &CRPCMod::RPCGetTransaction)
                  ("sendtransaction",       &CRPCMod::RPCSendTransaction)
+                 ("getsigcacheinfo",       &CRPCMod::RPCGetSigCacheInfo)
                  ("listkey",               &CRPCMod::RPCListKey)
                  ("getnewkey",             &CRPCMod::RPCGetNewKey)
                  ("encryptkey",            &CRPCMod::RPCEncryptKey)
@@ -469,6 +471,28 @@ Value CRPCMod::RPCListPeer(const Array& params,bool fHelp)
         obj.push_back(Pair("inbound", info.fInBound));
         obj.push_back(Pair("height", info.nStartingHeight));
         obj.push_back(Pair("banscore", info.nScore));
+
+        uint64 nBytesSent = 0,nBytesRecv = 0;
+        Array traffic;
+        for (map<pair<int,int>,network::CMvPeerTraffic>::const_iterator it = info.mapTraffic.begin();
+             it != info.mapTraffic.end();++it)
+        {
+            Object item;
+            item.push_back(Pair("channel", (*it).first.first));
+            item.push_back(Pair("command", (*it).first.second));
+            item.push_back(Pair("msgsent", (boost::uint64_t)(*it).second.nMsgSent));
+            item.push_back(Pair("bytessent", (boost::uint64_t)(*it).second.nBytesSent));
+            item.push_back(Pair("msgrecv", (boost::uint64_t)(*it).second.nMsgRecv));
+            item.push_back(Pair("bytesrecv", (boost::uint64_t)(*it).second.nBytesRecv));
+            traffic.push_back(item);
+            nBytesSent += (*it).second.nBytesSent;
+            nBytesRecv += (*it).second.nBytesRecv;
+        }
+        obj.push_back(Pair("bytessent", (boost::uint64_t)nBytesSent));
+        obj.push_back(Pair("bytesrecv", (boost::uint64_t)nBytesRecv));
+        obj.push_back(Pair("sendqueue", (boost::uint64_t)info.nSendQueueSize));
+        obj.push_back(Pair("senddropped", (boost::uint64_t)info.nSendDropped));
+        obj.push_back(Pair("traffic", traffic));
         
         ret.push_back(obj);
     }
@@ -746,6 +770,27 @@ Value CRPCMod::RPCSendTransaction(const Array& params,bool fHelp)
     return rawTx.GetHash().GetHex();
 }
 
+Value CRPCMod::RPCGetSigCacheInfo(const Array& params,bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+    {
+        throw runtime_error(
+            "getsigcacheinfo\n"
+            "Returns the size and hit rate of signature verification cache.");
+    }
+    CSignatureCacheStatus status;
+    CSignatureCache::GetInstance().GetStatus(status);
+
+    uint64 nLookup = status.nHit + status.nMiss;
+    Object ret;
+    ret.push_back(Pair("count",(boost::uint64_t)status.nCount));
+    ret.push_back(Pair("maxcount",(boost::uint64_t)status.nMaxCount));
+    ret.push_back(Pair("hit",(boost::uint64_t)status.nHit));
+    ret.push_back(Pair("miss",(boost::uint64_t)status.nMiss));
+    ret.push_back(Pair("hitrate",(nLookup != 0 ? (double)status.nHit / nLookup : 0.0)));
+    return ret;
+}
+
 Value CRPCMod::RPCListKey(const Array& params,bool fHelp)
 {
     if (fHelp || params.size() != 0)
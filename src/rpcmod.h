@@ -67,6 +67,7 @@ private:
     json_spirit::Value RPCRemovePendingTx(const json_spirit::Array& params,bool fHelp);
     json_spirit::Value RPCGetTransaction(const json_spirit::Array& params,bool fHelp);
     json_spirit::Value RPCSendTransaction(const json_spirit::Array& params,bool fHelp);
+    json_spirit::Value RPCGetSigCacheInfo(const json_spirit::Array& params,bool fHelp);
     /* Wallet */
     json_spirit::Value RPCListKey(const json_spirit::Array& params,bool fHelp);
     json_spirit::Value RPCGetNewKey(const json_spirit::Array& params,bool fHelp);
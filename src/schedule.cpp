@@ -77,6 +77,153 @@ void COrphan::RemoveBranch(const uint256& root,std::vector<uint256>& vBranch)
     }
 }
 
+///////////////////////////////
+// CHeaderChain
+
+void CHeaderChain::Clear()
+{
+    for (map<uint256,CBlockIndex*>::iterator it = mapIndex.begin();it != mapIndex.end();++it)
+    {
+        delete (*it).second;
+    }
+    mapIndex.clear();
+    pIndexBest = NULL;
+    vBestChain.clear();
+    nBaseHeight = 0;
+    nSyncCursor = 0;
+    mapPeer.clear();
+}
+
+CBlockIndex* CHeaderChain::GetIndex(const uint256& hash) const
+{
+    map<uint256,CBlockIndex*>::const_iterator it = mapIndex.find(hash);
+    return (it != mapIndex.end() ? (*it).second : NULL);
+}
+
+CBlockIndex* CHeaderChain::AddNew(const uint256& hash,const CBlock& header,CBlockIndex* pIndexPrev)
+{
+    if (IsFull() || IsInvalid(hash) || IsInvalid(header.hashPrev))
+    {
+        return NULL;
+    }
+
+    CBlock block(header);
+    CBlockIndex* pIndexNew = new CBlockIndex(block,0,0);
+    map<uint256,CBlockIndex*>::iterator mi = mapIndex.insert(make_pair(hash,pIndexNew)).first;
+    pIndexNew->phashBlock = &((*mi).first);
+
+    // same accumulation as the storage index, so trust and work spacing are comparable
+    pIndexNew->pPrev = pIndexPrev;
+    pIndexNew->nHeight = pIndexPrev->nHeight + 1;
+    pIndexNew->pOrigin = pIndexPrev->pOrigin;
+    pIndexNew->nRandBeacon = header.GetBlockBeacon() ^ pIndexPrev->pOrigin->nRandBeacon;
+    pIndexNew->nMoneySupply = pIndexPrev->nMoneySupply + header.txMint.nAmount;
+    pIndexNew->nChainTrust = pIndexPrev->nChainTrust + header.GetBlockTrust();
+    pIndexNew->UpdateWork();
+
+    if (pIndexBest == NULL || pIndexNew->nChainTrust > pIndexBest->nChainTrust)
+    {
+        UpdateBestChain(pIndexNew);
+    }
+    return pIndexNew;
+}
+
+void CHeaderChain::Invalidate(const uint256& hash)
+{
+    setInvalid.insert(hash);
+    Clear();
+}
+
+void CHeaderChain::SetPeerBest(uint64 nPeerNonce,CBlockIndex* pIndex)
+{
+    map<uint64,pair<CBlockIndex*,int> >::iterator it = mapPeer.find(nPeerNonce);
+    if (it == mapPeer.end() || (*it).second.first->nChainTrust < pIndex->nChainTrust)
+    {
+        mapPeer[nPeerNonce] = make_pair(pIndex,GetAgreedHeight(pIndex));
+    }
+}
+
+void CHeaderChain::RemovePeer(uint64 nPeerNonce)
+{
+    mapPeer.erase(nPeerNonce);
+}
+
+void CHeaderChain::GetPeer(set<uint64>& setPeer) const
+{
+    for (map<uint64,pair<CBlockIndex*,int> >::const_iterator it = mapPeer.begin();it != mapPeer.end();++it)
+    {
+        setPeer.insert((*it).first);
+    }
+}
+
+void CHeaderChain::GetKnownPeer(const CBlockIndex* pIndex,set<uint64>& setKnownPeer) const
+{
+    for (map<uint64,pair<CBlockIndex*,int> >::const_iterator it = mapPeer.begin();it != mapPeer.end();++it)
+    {
+        if ((*it).second.second >= (int)pIndex->nHeight)
+        {
+            setKnownPeer.insert((*it).first);
+        }
+    }
+}
+
+CBlockIndex* CHeaderChain::GetSyncIndex() const
+{
+    return (nSyncCursor < vBestChain.size() ? vBestChain[nSyncCursor] : NULL);
+}
+
+void CHeaderChain::GetSyncWindow(size_t nMaxCount,vector<CBlockIndex*>& vWindow) const
+{
+    for (size_t i = nSyncCursor;i < vBestChain.size() && vWindow.size() < nMaxCount;i++)
+    {
+        vWindow.push_back(vBestChain[i]);
+    }
+}
+
+bool CHeaderChain::IsOnBestChain(const CBlockIndex* pIndex) const
+{
+    int nPos = (int)pIndex->nHeight - nBaseHeight;
+    return (nPos >= 0 && nPos < (int)vBestChain.size() && vBestChain[nPos] == pIndex);
+}
+
+int CHeaderChain::GetAgreedHeight(CBlockIndex* pIndex) const
+{
+    while (pIndex != NULL && mapIndex.count(pIndex->GetBlockHash()))
+    {
+        if (IsOnBestChain(pIndex))
+        {
+            return pIndex->nHeight;
+        }
+        pIndex = pIndex->pPrev;
+    }
+    return -1;
+}
+
+void CHeaderChain::UpdateBestChain(CBlockIndex* pIndexNew)
+{
+    pIndexBest = pIndexNew;
+    if (!vBestChain.empty() && pIndexNew->pPrev == vBestChain.back())
+    {
+        vBestChain.push_back(pIndexNew);
+        return;
+    }
+
+    // switched to another branch, rebuild the path and the agreement of peers
+    vBestChain.clear();
+    for (CBlockIndex* pIndex = pIndexNew;pIndex != NULL && mapIndex.count(pIndex->GetBlockHash());pIndex = pIndex->pPrev)
+    {
+        vBestChain.push_back(pIndex);
+    }
+    reverse(vBestChain.begin(),vBestChain.end());
+    nBaseHeight = vBestChain[0]->nHeight;
+    nSyncCursor = 0;
+
+    for (map<uint64,pair<CBlockIndex*,int> >::iterator it = mapPeer.begin();it != mapPeer.end();++it)
+    {
+        (*it).second.second = GetAgreedHeight((*it).second.first);
+    }
+}
+
 ///////////////////////////////
 // CSchedule
 
@@ -85,12 +232,19 @@ bool CSchedule::Exists(const network::CInv& inv)
     return (!!mapState.count(inv));
 }
 
+bool CSchedule::IsAssigned(const network::CInv& inv,uint64 nPeerNonce)
+{
+    CInvStateMap::iterator it = mapState.find(inv);
+    return (it != mapState.end() && (*it).second.nAssigned == nPeerNonce && !(*it).second.IsReceived());
+}
+
 void CSchedule::GetKnownPeer(const network::CInv& inv,set<uint64>& setKnownPeer)
 {
-    map<network::CInv,CInvState>::iterator it = mapState.find(inv);
+    CInvStateMap::iterator it = mapState.find(inv);
     if (it != mapState.end())
     {
-        setKnownPeer = (*it).second.setKnownPeer;
+        setKnownPeer.clear();
+        GetKnownPeer((*it).second,setKnownPeer);
     }
 }
 
@@ -99,68 +253,74 @@ void CSchedule::RemovePeer(uint64 nPeerNonce,set<uint64>& setSchedPeer)
     map<uint64,CInvPeer>::iterator it = mapPeer.find(nPeerNonce);
     if (it != mapPeer.end())
     {
+        size_t nSlot = (*it).second.nSlot;
         vector<network::CInv> vInvKnown;
         (*it).second.GetKnownInv(vInvKnown);
         BOOST_FOREACH(const network::CInv& inv,vInvKnown)
         {
-            CInvState& state = mapState[inv];
-            state.setKnownPeer.erase(nPeerNonce);
-            if (state.setKnownPeer.empty())
+            CInvStateMap::iterator mi = mapState.find(inv);
+            if (mi == mapState.end())
+            {
+                continue;
+            }
+            CInvState& state = (*mi).second;
+            state.ResetKnownPeer(nSlot);
+            if (!state.HasKnownPeer())
             {
                 RemoveOrphan(inv);
-                mapState.erase(inv);
+                mapState.erase(mi);
             }
             else if (state.nAssigned == nPeerNonce)
             {
                 state.nAssigned = 0;
                 state.objReceived =  CNil();
-                setSchedPeer.insert(state.setKnownPeer.begin(),state.setKnownPeer.end());
+                GetKnownPeer(state,setSchedPeer);
             }
         }
+        vSlotPeer[nSlot] = 0;
+        vFreeSlot.push_back(nSlot);
         mapPeer.erase(it);
     }
 }
 
 void CSchedule::AddNewInv(const network::CInv& inv,uint64 nPeerNonce)
 {
-    CInvPeer& peer = mapPeer[nPeerNonce];
+    CInvPeer& peer = GetPeer(nPeerNonce);
     size_t nMaxPeerInv = (inv.nType == network::CInv::MSG_TX ? MAX_PEER_TX_INV_COUNT : MAX_PEER_BLOCK_INV_COUNT); 
     if (mapState.size() < MAX_INV_COUNT && peer.GetCount(inv.nType) < nMaxPeerInv)
     {
-        mapState[inv].setKnownPeer.insert(nPeerNonce);
+        mapState[inv].SetKnownPeer(peer.nSlot);
         peer.AddNewInv(inv);
     }
 }
 
 void CSchedule::RemoveInv(const network::CInv& inv,set<uint64>& setKnownPeer)
 {
-    map<network::CInv,CInvState>::iterator it = mapState.find(inv);
+    CInvStateMap::iterator it = mapState.find(inv);
     if (it != mapState.end())
     {
-        BOOST_FOREACH(const uint64& nPeerNonce,(*it).second.setKnownPeer)
-        {
-            mapPeer[nPeerNonce].RemoveInv(inv);
-        }
+        RemoveKnownInv(inv,(*it).second,setKnownPeer);
         if ((*it).second.IsReceived())
         {
             RemoveOrphan(inv); 
         }
-        setKnownPeer.insert((*it).second.setKnownPeer.begin(),(*it).second.setKnownPeer.end());
         mapState.erase(it);
     }
 }
 
 bool CSchedule::ReceiveBlock(uint64 nPeerNonce,const uint256& hash,const CBlock& block,set<uint64>& setSchedPeer)
 {
-    map<network::CInv,CInvState>::iterator it = mapState.find(network::CInv(network::CInv::MSG_BLOCK,hash));
+    CInvStateMap::iterator it = mapState.find(network::CInv(network::CInv::MSG_BLOCK,hash));
     if (it != mapState.end())
     {
         CInvState& state = (*it).second;
         if (state.nAssigned == nPeerNonce && !state.IsReceived())
         {
             state.objReceived = block;
-            setSchedPeer.insert(state.setKnownPeer.begin(),state.setKnownPeer.end());
-            mapPeer[nPeerNonce].Completed((*it).first);
+            GetKnownPeer(state,setSchedPeer);
+            CInvPeer& peer = mapPeer[nPeerNonce];
+            peer.Completed((*it).first);
+            peer.BlockReceived(walleve::GetTimeMillis() - state.nAssignTime);
             return true;
         }
     }
@@ -169,14 +329,14 @@ bool CSchedule::ReceiveBlock(uint64 nPeerNonce,const uint256& hash,const CBlock&
 
 bool CSchedule::ReceiveTx(uint64 nPeerNonce,const uint256& txid,const CTransaction& tx,set<uint64>& setSchedPeer)
 {
-    map<network::CInv,CInvState>::iterator it = mapState.find(network::CInv(network::CInv::MSG_TX,txid));
+    CInvStateMap::iterator it = mapState.find(network::CInv(network::CInv::MSG_TX,txid));
     if (it != mapState.end())
     {
         CInvState& state = (*it).second;
         if (state.nAssigned == nPeerNonce && !state.IsReceived())
         {
             state.objReceived = tx;
-            setSchedPeer.insert(state.setKnownPeer.begin(),state.setKnownPeer.end());
+            GetKnownPeer(state,setSchedPeer);
             mapPeer[nPeerNonce].Completed((*it).first);
             return true;
         }
@@ -184,9 +344,62 @@ bool CSchedule::ReceiveTx(uint64 nPeerNonce,const uint256& txid,const CTransacti
     return false;
 }
 
+bool CSchedule::IsLateBlock(uint64 nPeerNonce,const uint256& hash)
+{
+    map<uint64,CInvPeer>::iterator it = mapPeer.find(nPeerNonce);
+    return (it != mapPeer.end() && (*it).second.RemoveStalled(hash));
+}
+
+bool CSchedule::ReassignStalledBlock(const uint256& hash,set<uint64>& setSchedPeer)
+{
+    network::CInv inv(network::CInv::MSG_BLOCK,hash);
+    CInvStateMap::iterator it = mapState.find(inv);
+    if (it == mapState.end())
+    {
+        return false;
+    }
+    CInvState& state = (*it).second;
+    if (state.nAssigned == 0 || state.IsReceived() || state.GetKnownPeerCount() < 2
+        || !IsAssignStalled(state))
+    {
+        return false;
+    }
+    return ReassignBlock(hash,setSchedPeer);
+}
+
+bool CSchedule::ReassignBlock(const uint256& hash,set<uint64>& setSchedPeer)
+{
+    network::CInv inv(network::CInv::MSG_BLOCK,hash);
+    CInvStateMap::iterator it = mapState.find(inv);
+    if (it == mapState.end())
+    {
+        return false;
+    }
+    CInvState& state = (*it).second;
+    if (state.nAssigned == 0 || state.IsReceived() || state.GetKnownPeerCount() < 2)
+    {
+        return false;
+    }
+
+    CInvPeer& peer = mapPeer[state.nAssigned];
+    peer.Completed(inv);
+    peer.BlockStalled(hash);
+    state.nAssigned = 0;
+    set<uint64> setKnownPeer;
+    GetKnownPeer(state,setKnownPeer);
+    BOOST_FOREACH(const uint64 nPeerNonce,setKnownPeer)
+    {
+        if (!mapPeer[nPeerNonce].IsStalled(hash))
+        {
+            setSchedPeer.insert(nPeerNonce);
+        }
+    }
+    return true;
+}
+
 CBlock* CSchedule::GetBlock(const uint256& hash,uint64& nNonceSender)
 {
-    map<network::CInv,CInvState>::iterator it = mapState.find(network::CInv(network::CInv::MSG_BLOCK,hash));
+    CInvStateMap::iterator it = mapState.find(network::CInv(network::CInv::MSG_BLOCK,hash));
     if (it != mapState.end())
     {
         CInvState& state = (*it).second;
@@ -201,7 +414,7 @@ CBlock* CSchedule::GetBlock(const uint256& hash,uint64& nNonceSender)
 
 CTransaction* CSchedule::GetTransaction(const uint256& txid,uint64& nNonceSender)
 {
-    map<network::CInv,CInvState>::iterator it = mapState.find(network::CInv(network::CInv::MSG_TX,txid));
+    CInvStateMap::iterator it = mapState.find(network::CInv(network::CInv::MSG_TX,txid));
     if (it != mapState.end())
     {
         CInvState& state = (*it).second;
@@ -241,15 +454,10 @@ void CSchedule::InvalidateBlock(const uint256& hash,set<uint64>& setMisbehavePee
     BOOST_FOREACH(const uint256& hashInvalid,vInvalid)
     {
         network::CInv inv(network::CInv::MSG_BLOCK,hashInvalid);
-        map<network::CInv,CInvState>::iterator it = mapState.find(inv);
+        CInvStateMap::iterator it = mapState.find(inv);
         if (it != mapState.end())
         {
-            CInvState& state = (*it).second;
-            BOOST_FOREACH(const uint64& nPeerNonce,state.setKnownPeer)
-            {
-                mapPeer[nPeerNonce].RemoveInv(inv);
-            }
-            setMisbehavePeer.insert(state.setKnownPeer.begin(),state.setKnownPeer.end());
+            RemoveKnownInv(inv,(*it).second,setMisbehavePeer);
             mapState.erase(it);
         }
     }
@@ -263,22 +471,17 @@ void CSchedule::InvalidateTx(const uint256& txid,set<uint64>& setMisbehavePeer)
     BOOST_FOREACH(const uint256& hashInvalid,vInvalid)
     {
         network::CInv inv(network::CInv::MSG_TX,hashInvalid);
-        map<network::CInv,CInvState>::iterator it = mapState.find(inv);
+        CInvStateMap::iterator it = mapState.find(inv);
         if (it != mapState.end())
         {
-            CInvState& state = (*it).second;
-            BOOST_FOREACH(const uint64& nPeerNonce,state.setKnownPeer)
-            {
-                mapPeer[nPeerNonce].RemoveInv(inv);
-            }
-            setMisbehavePeer.insert(state.setKnownPeer.begin(),state.setKnownPeer.end());
+            RemoveKnownInv(inv,(*it).second,setMisbehavePeer);
             mapState.erase(it);
         }
     }
     RemoveInv(network::CInv(network::CInv::MSG_TX,txid),setMisbehavePeer);
 }
 
-bool CSchedule::ScheduleBlockInv(uint64 nPeerNonce,vector<network::CInv>& vInv,size_t nMaxCount,bool& fMissingPrev,bool& fEmpty)
+bool CSchedule::ScheduleBlockInv(uint64 nPeerNonce,vector<network::CInv>& vInv,bool& fMissingPrev,bool& fEmpty)
 {
     fMissingPrev = false;
     fEmpty = true;
@@ -288,11 +491,14 @@ bool CSchedule::ScheduleBlockInv(uint64 nPeerNonce,vector<network::CInv>& vInv,s
     {
         CInvPeer& peer = (*it).second;
         fEmpty = peer.Empty(network::CInv::MSG_BLOCK); 
-        if (!peer.IsAssigned())
+        size_t nInFlight = peer.GetAssigned(network::CInv::MSG_BLOCK).size();
+        if (peer.GetAssigned(network::CInv::MSG_TX).empty() && nInFlight < peer.GetBlockWindow())
         {
             bool fReceivedAll;
         
-            if (!ScheduleKnownInv(nPeerNonce,peer,network::CInv::MSG_BLOCK,vInv,nMaxCount,fReceivedAll))
+            // blocks are kept in flight up to the window of the peer
+            if (!ScheduleKnownInv(nPeerNonce,peer,network::CInv::MSG_BLOCK,vInv,peer.GetBlockWindow() - nInFlight,fReceivedAll)
+                && nInFlight == 0)
             {
                 fMissingPrev = fReceivedAll;
                 return (!fReceivedAll || peer.GetCount(network::CInv::MSG_BLOCK) < MAX_PEER_BLOCK_INV_COUNT);
@@ -319,6 +525,53 @@ bool CSchedule::ScheduleTxInv(uint64 nPeerNonce,vector<network::CInv>& vInv,size
     return true;
 }
 
+CInvPeer& CSchedule::GetPeer(uint64 nPeerNonce)
+{
+    map<uint64,CInvPeer>::iterator it = mapPeer.find(nPeerNonce);
+    if (it == mapPeer.end())
+    {
+        size_t nSlot = vSlotPeer.size();
+        if (!vFreeSlot.empty())
+        {
+            nSlot = vFreeSlot.back();
+            vFreeSlot.pop_back();
+            vSlotPeer[nSlot] = nPeerNonce;
+        }
+        else
+        {
+            vSlotPeer.push_back(nPeerNonce);
+        }
+        it = mapPeer.insert(make_pair(nPeerNonce,CInvPeer(nSlot))).first;
+    }
+    return (*it).second;
+}
+
+void CSchedule::GetKnownPeer(const CInvState& state,set<uint64>& setKnownPeer)
+{
+    const boost::dynamic_bitset<>& bs = state.bsKnownPeer;
+    for (size_t i = bs.find_first();i != bs.npos;i = bs.find_next(i))
+    {
+        setKnownPeer.insert(vSlotPeer[i]);
+    }
+}
+
+void CSchedule::RemoveKnownInv(const network::CInv& inv,const CInvState& state,set<uint64>& setKnownPeer)
+{
+    const boost::dynamic_bitset<>& bs = state.bsKnownPeer;
+    for (size_t i = bs.find_first();i != bs.npos;i = bs.find_next(i))
+    {
+        mapPeer[vSlotPeer[i]].RemoveInv(inv);
+        setKnownPeer.insert(vSlotPeer[i]);
+    }
+}
+
+bool CSchedule::IsAssignStalled(const CInvState& state)
+{
+    CInvPeer& peer = mapPeer[state.nAssigned];
+    int64 nTimeout = max((int64)MIN_BLOCK_STALL_TIMEOUT,peer.GetBlockLatency() * 4);
+    return (walleve::GetTimeMillis() - state.nAssignTime >= nTimeout);
+}
+
 void CSchedule::RemoveOrphan(const network::CInv& inv)
 {
     if (inv.nType == network::CInv::MSG_TX)
@@ -336,14 +589,25 @@ bool CSchedule::ScheduleKnownInv(uint64 nPeerNonce,CInvPeer& peer,uint32 type,
 {
     size_t nReceived = 0;
     vInv.clear();
-    list<uint256>& listKnown = peer.GetKnownList(type);
+    CInvKnownList& listKnown = peer.GetKnownList(type);
+    int64 nTime = walleve::GetTimeMillis();
     BOOST_FOREACH(const uint256& hash,listKnown)
     {
         network::CInv inv(type,hash);
         CInvState& state = mapState[inv];
-        if (state.nAssigned == 0)
+        if (type == network::CInv::MSG_BLOCK && state.nAssigned != 0 && state.nAssigned != nPeerNonce
+            && !state.IsReceived() && !peer.IsStalled(hash) && IsAssignStalled(state))
+        {
+            // blocks announced by inv are taken from a stalled peer here, as header sync does
+            CInvPeer& peerStalled = mapPeer[state.nAssigned];
+            peerStalled.Completed(inv);
+            peerStalled.BlockStalled(hash);
+            state.nAssigned = 0;
+        }
+        if (state.nAssigned == 0 && !(type == network::CInv::MSG_BLOCK && peer.IsStalled(hash)))
         {
             state.nAssigned = nPeerNonce;
+            state.nAssignTime = nTime;
             vInv.push_back(inv);
             peer.Assign(inv);
             if (vInv.size() >= nMaxCount)
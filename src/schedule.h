@@ -13,19 +13,36 @@
 
 #include <boost/foreach.hpp>
 #include <boost/variant.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/dynamic_bitset.hpp>
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/identity.hpp>
 
 namespace multiverse
 {
 
+// known inv of a peer in announced order, with hashed lookup for removal
+typedef boost::multi_index_container<
+  uint256,
+  boost::multi_index::indexed_by<
+    boost::multi_index::sequenced<>,
+    boost::multi_index::hashed_unique<boost::multi_index::identity<uint256>,crypto::CCryptoSaltedHasher>
+  >
+> CInvKnownList;
+
 class CInvPeer
 {
     class CInvPeerState
     {
     public:
-        std::list<uint256> listKnown;
+        CInvKnownList listKnown;
         std::set<uint256> setAssigned;
     };
 public:
+    enum {MIN_BLOCK_WINDOW = 8,MAX_BLOCK_WINDOW = 32};
+    CInvPeer(std::size_t nSlotIn=0) : nSlot(nSlotIn),nBlockWindow(MIN_BLOCK_WINDOW),nBlockLatency(0) {}
     bool Empty(uint32 type)
     {
         return GetKnownList(type).empty(); 
@@ -34,7 +51,7 @@ public:
     { 
         return GetKnownList(type).size(); 
     }
-    std::list<uint256>& GetKnownList(uint32 type)
+    CInvKnownList& GetKnownList(uint32 type)
     {
         return invKnown[type - network::CInv::MSG_TX].listKnown;
     }
@@ -55,14 +72,21 @@ public:
     }
     void AddNewInv(const network::CInv& inv)
     {
-        std::list<uint256>& listKnown = GetKnownList(inv.nType);
-        listKnown.remove(inv.nHash);
-        listKnown.push_back(inv.nHash);
+        CInvKnownList& listKnown = GetKnownList(inv.nType);
+        std::pair<CInvKnownList::iterator,bool> ret = listKnown.push_back(inv.nHash);
+        if (!ret.second)
+        {
+            listKnown.relocate(listKnown.end(),ret.first);
+        }
     }
     void RemoveInv(const network::CInv& inv)
     {
-        GetKnownList(inv.nType).remove(inv.nHash);
+        GetKnownList(inv.nType).get<1>().erase(inv.nHash);
         GetAssigned(inv.nType).erase(inv.nHash);
+        if (inv.nType == network::CInv::MSG_BLOCK)
+        {
+            setStalled.erase(inv.nHash);
+        }
     }
     void Assign(const network::CInv& inv)
     {
@@ -76,8 +100,36 @@ public:
     {
         return (!invKnown[0].setAssigned.empty() || !invKnown[1].setAssigned.empty());
     }
+    std::size_t GetBlockWindow() const { return nBlockWindow; }
+    int64 GetBlockLatency() const { return nBlockLatency; }
+    void BlockReceived(int64 nLatency)
+    {
+        // window grows while blocks arrive in the usual time and shrinks otherwise
+        if (nBlockLatency == 0 || nLatency <= nBlockLatency * 2)
+        {
+            nBlockWindow = std::min(nBlockWindow + 1,(std::size_t)MAX_BLOCK_WINDOW);
+        }
+        else if (nBlockWindow > MIN_BLOCK_WINDOW)
+        {
+            nBlockWindow--;
+        }
+        nBlockLatency = (nBlockLatency == 0 ? nLatency : (nBlockLatency * 7 + nLatency) / 8);
+    }
+    void BlockStalled(const uint256& hash)
+    {
+        nBlockWindow = std::max(nBlockWindow / 2,(std::size_t)MIN_BLOCK_WINDOW);
+        setStalled.insert(hash);
+    }
+    bool IsStalled(const uint256& hash) const { return (!!setStalled.count(hash)); }
+    bool RemoveStalled(const uint256& hash) { return (setStalled.erase(hash) != 0); }
 public:
     CInvPeerState invKnown[2];
+    // bit position of this peer in the known peer set of inv states
+    std::size_t nSlot;
+    std::size_t nBlockWindow;
+    int64 nBlockLatency;
+    // blocks taken away from this peer until the inv is removed, a late copy of them is not a misbehavior
+    std::set<uint256> setStalled;
 };
 
 class COrphan
@@ -94,27 +146,86 @@ protected:
     std::multimap<uint256,uint256> mapOrphanByPrev;
 };
 
+class CHeaderChain
+{
+public:
+    CHeaderChain() : pIndexBest(NULL),nBaseHeight(0),nSyncCursor(0) {}
+    ~CHeaderChain() { Clear(); }
+    void Clear();
+    bool IsEmpty() const { return mapIndex.empty(); }
+    bool IsFull() const { return (mapIndex.size() >= MAX_HEADER_COUNT); }
+    bool IsInvalid(const uint256& hash) const { return (!!setInvalid.count(hash)); }
+    CBlockIndex* GetIndex(const uint256& hash) const;
+    CBlockIndex* GetBest() const { return pIndexBest; }
+    CBlockIndex* AddNew(const uint256& hash,const CBlock& header,CBlockIndex* pIndexPrev);
+    void Invalidate(const uint256& hash);
+    void SetPeerBest(uint64 nPeerNonce,CBlockIndex* pIndex);
+    void RemovePeer(uint64 nPeerNonce);
+    void GetPeer(std::set<uint64>& setPeer) const;
+    void GetKnownPeer(const CBlockIndex* pIndex,std::set<uint64>& setKnownPeer) const;
+    CBlockIndex* GetSyncIndex() const;
+    void SkipSyncIndex() { nSyncCursor++; }
+    void GetSyncWindow(std::size_t nMaxCount,std::vector<CBlockIndex*>& vWindow) const;
+protected:
+    bool IsOnBestChain(const CBlockIndex* pIndex) const;
+    int GetAgreedHeight(CBlockIndex* pIndex) const;
+    void UpdateBestChain(CBlockIndex* pIndexNew);
+protected:
+    enum {MAX_HEADER_COUNT = 128 * 1024};
+    std::map<uint256,CBlockIndex*> mapIndex;
+    std::set<uint256> setInvalid;
+    CBlockIndex* pIndexBest;
+    // headers of the best chain above the local storage, vBestChain[i] is at height nBaseHeight + i
+    std::vector<CBlockIndex*> vBestChain;
+    int nBaseHeight;
+    std::size_t nSyncCursor;
+    // best header and the highest height agreed with vBestChain of each peer
+    std::map<uint64,std::pair<CBlockIndex*,int> > mapPeer;
+};
+
 class CSchedule
 {
     typedef boost::variant<CNil,CBlock,CTransaction> CInvObject;
     class CInvState
     {
     public:
-        CInvState() : nAssigned(0),objReceived(CNil()) {}
+        CInvState() : nAssigned(0),nAssignTime(0),objReceived(CNil()) {}
         bool IsReceived() {return (objReceived.type() != typeid(CNil));}
+        bool HasKnownPeer() const { return bsKnownPeer.any(); }
+        std::size_t GetKnownPeerCount() const { return bsKnownPeer.count(); }
+        void SetKnownPeer(std::size_t nSlot)
+        {
+            if (nSlot >= bsKnownPeer.size())
+            {
+                bsKnownPeer.resize(nSlot + 1);
+            }
+            bsKnownPeer.set(nSlot);
+        }
+        void ResetKnownPeer(std::size_t nSlot)
+        {
+            if (nSlot < bsKnownPeer.size())
+            {
+                bsKnownPeer.reset(nSlot);
+            }
+        }
     public:
         uint64 nAssigned;
+        int64 nAssignTime;
         CInvObject objReceived;
-        std::set<uint64> setKnownPeer;
+        boost::dynamic_bitset<> bsKnownPeer;
     };
 public:
     bool Exists(const network::CInv& inv);
+    bool IsAssigned(const network::CInv& inv,uint64 nPeerNonce);
     void GetKnownPeer(const network::CInv& inv,std::set<uint64>& setKnownPeer);
     void RemovePeer(uint64 nPeerNonce,std::set<uint64>& setSchedPeer);
     void AddNewInv(const network::CInv& inv,uint64 nPeerNonce);
     void RemoveInv(const network::CInv& inv,std::set<uint64>& setKnownPeer);
     bool ReceiveBlock(uint64 nPeerNonce,const uint256& hash,const CBlock& block,std::set<uint64>& setSchedPeer);
     bool ReceiveTx(uint64 nPeerNonce,const uint256& txid,const CTransaction& tx,std::set<uint64>& setSchedPeer);
+    bool IsLateBlock(uint64 nPeerNonce,const uint256& hash);
+    bool ReassignStalledBlock(const uint256& hash,std::set<uint64>& setSchedPeer);
+    bool ReassignBlock(const uint256& hash,std::set<uint64>& setSchedPeer);
     CBlock* GetBlock(const uint256& hash,uint64& nNonceSender);
     CTransaction* GetTransaction(const uint256& txid,uint64& nNonceSender);
     void AddOrphanBlockPrev(const uint256& hash,const uint256& prev);
@@ -123,18 +234,27 @@ public:
     void GetNextTx(const uint256& txid,std::vector<uint256>& vNext,std::set<uint256>& setTx);
     void InvalidateBlock(const uint256& hash,std::set<uint64>& setMisbehavePeer);
     void InvalidateTx(const uint256& txid,std::set<uint64>& setMisbehavePeer);
-    bool ScheduleBlockInv(uint64 nPeerNonce,std::vector<network::CInv>& vInv,std::size_t nMaxCount,bool& fMissingPrev,bool& fEmpty);
+    bool ScheduleBlockInv(uint64 nPeerNonce,std::vector<network::CInv>& vInv,bool& fMissingPrev,bool& fEmpty);
     bool ScheduleTxInv(uint64 nPeerNonce,std::vector<network::CInv>& vInv,std::size_t nMaxCount);
 protected:
+    CInvPeer& GetPeer(uint64 nPeerNonce);
+    void GetKnownPeer(const CInvState& state,std::set<uint64>& setKnownPeer);
+    void RemoveKnownInv(const network::CInv& inv,const CInvState& state,std::set<uint64>& setKnownPeer);
     void RemoveOrphan(const network::CInv& inv);
+    bool IsAssignStalled(const CInvState& state);
     bool ScheduleKnownInv(uint64 nPeerNonce,CInvPeer& peer,uint32 type,
                                             std::vector<network::CInv>& vInv,std::size_t nMaxCount,bool& fReceivedAll);
 protected:
     enum {MAX_INV_COUNT = 409600,MAX_PEER_BLOCK_INV_COUNT = 256,MAX_PEER_TX_INV_COUNT = 8192};
+    enum {MIN_BLOCK_STALL_TIMEOUT = 5000};
+    typedef boost::unordered_map<network::CInv,CInvState,network::CInvHasher> CInvStateMap;
     COrphan orphanBlock;
     COrphan orphanTx;
     std::map<uint64,CInvPeer> mapPeer;
-    std::map<network::CInv,CInvState> mapState;
+    CInvStateMap mapState;
+    // peer nonce of each slot, 0 for a free slot
+    std::vector<uint64> vSlotPeer;
+    std::vector<std::size_t> vFreeSlot;
 };
 
 } // namespace multiverse
@@ -581,10 +581,11 @@ MvErr CService::SubmitWork(const vector<unsigned char>& vchWorkData,CTemplatePtr
 
     size_t nSigSize = templMint->GetTemplateDataSize() + 64 + 2;
     size_t nMaxTxSize = MAX_BLOCK_SIZE - GetSerializeSize(block) - nSigSize;
-    int64 nTotalTxFee = 0;
-    pTxPool->ArrangeBlockTx(pCoreProtocol->GetGenesisBlockHash(),nMaxTxSize,block.vtx,nTotalTxFee);
-    block.hashMerkle = block.CalcMerkleTreeRoot();
-    block.txMint.nAmount += nTotalTxFee;
+    CArrangedBlockTxPtr spArranged;
+    pTxPool->GetArrangedBlockTx(pCoreProtocol->GetGenesisBlockHash(),nMaxTxSize,spArranged);
+    block.vtx = spArranged->vtx;
+    block.hashMerkle = spArranged->GetMerkleRoot();
+    block.txMint.nAmount += spArranged->nTotalTxFee;
 
     hashBlock = block.GetHash();
     vector<unsigned char> vchMintSig;
@@ -95,6 +95,7 @@ void CTxPoolView::InvalidateSpent(const CTxOutPoint& out,vector<uint256>& vInvol
                 }
                 mapTx.erase(txidNextTx);
                 vInvolvedTx.push_back(txidNextTx);
+                spArranged.reset();
             }
         }
     }
@@ -103,7 +104,7 @@ void CTxPoolView::InvalidateSpent(const CTxOutPoint& out,vector<uint256>& vInvol
 void CTxPoolView::GetFilteredTx(map<size_t,pair<uint256,CPooledTx*> >& mapFilteredTx,
                                 const CDestination& sendTo,const CDestination& destIn)
 {
-    for (map<uint256,CPooledTx*>::iterator mi = mapTx.begin();mi != mapTx.end(); ++mi)
+    for (CPooledTxLinkMap::iterator mi = mapTx.begin();mi != mapTx.end(); ++mi)
     {
         CPooledTx* pPooledTx = (*mi).second;
         if ((destIn.IsNull() && sendTo.IsNull()) || sendTo == pPooledTx->sendTo
@@ -120,7 +121,7 @@ void CTxPoolView::ArrangeBlockTx(map<size_t,pair<uint256,CPooledTx*> >& mapArran
     mapArrangedTx.clear();
 
     multimap<int64,CTxPoolCandidate> mapCandidate;
-    for (map<uint256,CPooledTx*>::iterator it = mapTx.begin();it != mapTx.end();++it)
+    for (CPooledTxLinkMap::iterator it = mapTx.begin();it != mapTx.end();++it)
     {
         nTotalSize += (*it).second->nSerializeSize;
 
@@ -154,7 +155,7 @@ void CTxPoolView::ArrangeBlockTx(map<size_t,pair<uint256,CPooledTx*> >& mapArran
                         const uint256& txidPrev = txin.prevout.hash;
                         if (!candidate.Have(txidPrev))
                         {
-                            map<uint256,CPooledTx*>::iterator mi = mapTx.find(txidPrev);
+                            CPooledTxLinkMap::iterator mi = mapTx.find(txidPrev);
                             if (mi != mapTx.end() && !mapArrangedTx.count((*mi).second->nSequenceNumber))
                             {
                                 candidate.AddNewTx(*mi);
@@ -190,13 +191,50 @@ void CTxPoolView::ArrangeBlockTx(map<size_t,pair<uint256,CPooledTx*> >& mapArran
     }
     else
     {
-        for (map<uint256,CPooledTx*>::iterator it = mapTx.begin();it != mapTx.end();++it)
+        for (CPooledTxLinkMap::iterator it = mapTx.begin();it != mapTx.end();++it)
         {
             mapArrangedTx.insert(make_pair((*it).second->nSequenceNumber,*it));
         }
     }
 }
  
+void CTxPoolView::Rearrange(size_t nMaxSize)
+{
+    map<size_t,pair<uint256,CPooledTx*> > mapArrangedTx;
+    ArrangeBlockTx(mapArrangedTx,nMaxSize);
+
+    nArrangedMaxSize = nMaxSize;
+    spArranged.reset(new CArrangedBlockTx(nMaxSize));
+    spArranged->vtx.reserve(mapArrangedTx.size());
+    for (map<size_t,pair<uint256,CPooledTx*> >::iterator it = mapArrangedTx.begin();
+         it != mapArrangedTx.end();++it)
+    {
+        const CPooledTx* pPooledTx = (*it).second.second;
+        spArranged->AddTx(*pPooledTx,(*it).second.first,pPooledTx->nTxFee,pPooledTx->nSerializeSize);
+    }
+    spArranged->fComplete = (mapArrangedTx.size() == mapTx.size());
+}
+
+void CTxPoolView::AppendArranged(const uint256& txid,const CPooledTx& tx)
+{
+    if (!spArranged)
+    {
+        return;
+    }
+    // a new tx has the highest sequence number, while every pooled tx fits
+    // in the block it simply goes to the end, otherwise arrange again on demand
+    if (!spArranged->fComplete || spArranged->nTotalSize + tx.nSerializeSize > spArranged->nMaxSize)
+    {
+        spArranged.reset();
+        return;
+    }
+    if (!spArranged.unique())
+    {
+        spArranged.reset(new CArrangedBlockTx(*spArranged));
+    }
+    spArranged->AddTx(tx,txid,tx.nTxFee,tx.nSerializeSize);
+}
+ 
 //////////////////////////////
 // CTxPool 
 
@@ -204,6 +242,7 @@ CTxPool::CTxPool()
 {
     pCoreProtocol = NULL;
     pWorldLine = NULL;
+    nSyncCount = 0;
 }
 
 CTxPool::~CTxPool()
@@ -247,11 +286,17 @@ bool CTxPool::WalleveHandleInvoke()
         WalleveLog("Failed to load txpool database\n");
         return false;
     }  
+    if (!workerAdmission.Start())
+    {
+        WalleveLog("Failed to start txpool admission workers\n");
+        return false;
+    }
     return true;
 }
 
 void CTxPool::WalleveHandleHalt()
 {
+    workerAdmission.Stop();
     dbTxPool.Deinitialize();
     Clear();
 }
@@ -264,6 +309,8 @@ bool CTxPool::Exists(const uint256& txid)
 
 void CTxPool::Clear()
 {
+    // waits for a running synchronization, which keeps its pool view across an unlock
+    boost::unique_lock<boost::mutex> slock(mtxSync);
     boost::unique_lock<boost::shared_mutex> wlock(rwAccess);
     mapPoolView.clear();
     mapTx.clear();
@@ -282,50 +329,63 @@ size_t CTxPool::Count(const uint256& fork) const
 
 MvErr CTxPool::Push(CTransaction& tx,uint256& hashFork,CDestination& destIn,int64& nValueIn)
 {
-    boost::unique_lock<boost::shared_mutex> wlock(rwAccess);
-    uint256 txid = tx.GetHash();
-    
-    if (mapTx.count(txid))
-    {
-        return MV_ERR_ALREADY_HAVE;
-    }
-    
-    if (tx.IsMintTx())
+    CTxAdmission admission(&tx);
+    MvErr err = Admit(admission);
+    if (err == MV_OK)
     {
-        return MV_ERR_TRANSACTION_INVALID;
+        hashFork = admission.hashFork;
+        destIn = admission.destIn;
+        nValueIn = admission.nValueIn;
     }
+    return err;
+}   
 
-    int nHeight;
-    if (!pWorldLine->GetBlockLocation(tx.hashAnchor,hashFork,nHeight))
-    {
-        return MV_ERR_TRANSACTION_INVALID;
+void CTxPool::Push(vector<CTxAdmission>& vAdmission)
+{
+    // txs spending an output of an earlier tx in the batch are deferred,
+    // they are prepared in order after their predecessors are committed
+    set<uint256> setBatchTx;
+    vector<bool> vDeferred(vAdmission.size(),false);
+    vector<size_t> vIndex;
+    for (size_t i = 0;i < vAdmission.size();i++)
+    {
+        CTxAdmission& admission = vAdmission[i];
+        admission.txid = admission.pTx->GetHash();
+        BOOST_FOREACH(const CTxIn& txin,admission.pTx->vInput)
+        {
+            if (setBatchTx.count(txin.prevout.hash))
+            {
+                vDeferred[i] = true;
+                break;
+            }
+        }
+        if (!vDeferred[i])
+        {
+            vIndex.push_back(i);
+        }
+        setBatchTx.insert(admission.txid);
     }
-    
-    CTxPoolView& txView = mapPoolView[hashFork];    
-    MvErr err = AddNew(txView,txid,tx,hashFork,nHeight);
-    if (err == MV_OK)
+
+    workerAdmission.ForEach(vIndex.size(),boost::bind(&CTxPool::PrepareBatch,this,&vAdmission,&vIndex,_1));
+
+    for (size_t i = 0;i < vAdmission.size();i++)
     {
-        CPooledTx* pPooledTx = txView.Get(txid);
-        if (pPooledTx == NULL)
+        CTxAdmission& admission = vAdmission[i];
+        if (vDeferred[i])
         {
-            return MV_ERR_NOT_FOUND;
+            admission.err = Admit(admission);
         }
-        destIn = pPooledTx->destIn;
-        nValueIn = pPooledTx->nValueIn;
-        vector<pair<uint256,CAssembledTx> > vDBAddNew;
-        vDBAddNew.push_back(make_pair(txid,*static_cast<CAssembledTx*>(pPooledTx)));
-        if (!dbTxPool.UpdateTx(hashFork,vDBAddNew))
+        else if (admission.err == MV_OK && !Commit(admission))
         {
-            return MV_ERR_SYS_DATABASE_ERROR;
+            admission.err = Admit(admission);
         }
     }
-    return err;
-}   
+}
 
 void CTxPool::Pop(const uint256& txid)
 {
     boost::unique_lock<boost::shared_mutex> wlock(rwAccess);
-    map<uint256,CPooledTx>::iterator it = mapTx.find(txid);
+    CPooledTxMap::iterator it = mapTx.find(txid);
     if (it == mapTx.end())
     {
         return;
@@ -338,6 +398,8 @@ void CTxPool::Pop(const uint256& txid)
         return;
     }
     vector<uint256> vInvalidTx;
+    nSyncCount++;
+
     CTxPoolView& txView = mapPoolView[hashFork];    
     txView.Remove(txid);
     txView.InvalidateSpent(CTxOutPoint(txid,0),vInvalidTx);
@@ -346,6 +408,7 @@ void CTxPool::Pop(const uint256& txid)
     {
         mapTx.erase(txidInvalid);
     }
+    txView.Rearrange();
 
     vector<pair<uint256,CAssembledTx> > vDBAddNew;
     vector<uint256> vDBRemove;
@@ -357,7 +420,7 @@ void CTxPool::Pop(const uint256& txid)
 bool CTxPool::Get(const uint256& txid,CTransaction& tx) const
 {
     boost::shared_lock<boost::shared_mutex> rlock(rwAccess);
-    map<uint256,CPooledTx>::const_iterator it = mapTx.find(txid);
+    CPooledTxMap::const_iterator it = mapTx.find(txid);
     if (it != mapTx.end())
     {
         tx = (*it).second;
@@ -422,16 +485,29 @@ bool CTxPool::FilterTx(CTxFilter& filter)
 
 void CTxPool::ArrangeBlockTx(const uint256& hashFork,size_t nMaxSize,vector<CTransaction>& vtx,int64& nTotalTxFee)
 {
-    boost::shared_lock<boost::shared_mutex> rlock(rwAccess);
+    CArrangedBlockTxPtr spArranged;
+    GetArrangedBlockTx(hashFork,nMaxSize,spArranged);
+    vtx.insert(vtx.end(),spArranged->vtx.begin(),spArranged->vtx.end());
+    nTotalTxFee = spArranged->nTotalTxFee;
+}
+
+void CTxPool::GetArrangedBlockTx(const uint256& hashFork,size_t nMaxSize,CArrangedBlockTxPtr& spArranged)
+{
+    {
+        boost::shared_lock<boost::shared_mutex> rlock(rwAccess);
+        map<uint256,CTxPoolView>::iterator it = mapPoolView.find(hashFork);
+        if (it != mapPoolView.end() && (*it).second.GetArrangedBlockTx(nMaxSize,spArranged))
+        {
+            return;
+        }
+    }
+
+    boost::unique_lock<boost::shared_mutex> wlock(rwAccess);
     CTxPoolView& txView = mapPoolView[hashFork];
-    map<size_t,pair<uint256,CPooledTx*> > mapArrangedTx;
-    txView.ArrangeBlockTx(mapArrangedTx,nMaxSize);
-    nTotalTxFee = 0;
-    for (map<size_t,pair<uint256,CPooledTx*> >::iterator it = mapArrangedTx.begin();
-         it != mapArrangedTx.end();++it)
+    if (!txView.GetArrangedBlockTx(nMaxSize,spArranged))
     {
-        vtx.push_back(*static_cast<CTransaction*>((*it).second.second));
-        nTotalTxFee += (*it).second.second->nTxFee;
+        txView.Rearrange(nMaxSize);
+        txView.GetArrangedBlockTx(nMaxSize,spArranged);
     }
 }
 
@@ -475,8 +551,11 @@ bool CTxPool::SynchronizeWorldLine(CWorldLineUpdate& update,CTxSetChange& change
 
     change.hashFork = update.hashFork;
 
+    boost::unique_lock<boost::mutex> slock(mtxSync);
     boost::unique_lock<boost::shared_mutex> wlock(rwAccess);
     
+    nSyncCount++;
+
     vector<uint256> vInvalidTx;
     CTxPoolView& txView = mapPoolView[update.hashFork];
 
@@ -515,33 +594,26 @@ bool CTxPool::SynchronizeWorldLine(CWorldLineUpdate& update,CTxSetChange& change
         nHeight++;
     }
 
+    // txs of removed blocks are re-verified in parallel without holding the pool lock,
+    // parents first, the lock-held phases only move entries between states
     vector<pair<uint256,vector<CTxIn> > > vTxRemove;
-    BOOST_FOREACH(CBlockEx& block,update.vBlockRemove)
+    vector<CTxAdmission> vResurrect;
+    map<uint256,CAssembledTx> mapResurrect;
+    BOOST_REVERSE_FOREACH(CBlockEx& block,update.vBlockRemove)
     {
-        for (int i = block.vtx.size() - 1; i >= 0; i--)
+        for (std::size_t i = 0;i < block.vtx.size();i++)
         {
             CTransaction& tx = block.vtx[i];
+            CTxContxt& txContxt = block.vTxContxt[i];
             uint256 txid = tx.GetHash();
             if (!update.setTxUpdate.count(txid))
             {
-                uint256 spent0,spent1;
-                
-                txView.GetSpent(CTxOutPoint(txid,0),spent0);
-                txView.GetSpent(CTxOutPoint(txid,1),spent1);
-                if (AddNew(txView,txid,tx,update.hashFork,update.nLastBlockHeight) == MV_OK)
-                {
-                    if (spent0 != 0) txView.SetSpent(CTxOutPoint(txid,0),spent0);
-                    if (spent1 != 0) txView.SetSpent(CTxOutPoint(txid,1),spent0);
-
-                    change.mapTxUpdate.insert(make_pair(txid,-1));
-                    vDBAddNew.push_back(make_pair(txid,mapTx[txid]));
-                }
-                else
-                {
-                    txView.InvalidateSpent(CTxOutPoint(txid,0),vInvalidTx);
-                    txView.InvalidateSpent(CTxOutPoint(txid,1),vInvalidTx);
-                    vTxRemove.push_back(make_pair(txid,tx.vInput));
-                }
+                vResurrect.push_back(CTxAdmission(&tx));
+                CTxAdmission& admission = vResurrect.back();
+                admission.txid = txid;
+                admission.hashFork = update.hashFork;
+                admission.nForkHeight = update.nLastBlockHeight;
+                mapResurrect.insert(make_pair(txid,CAssembledTx(tx,-1,txContxt.destIn,txContxt.GetValueIn())));
             }
         }
         uint256 txidMint = block.txMint.GetHash();
@@ -551,10 +623,67 @@ bool CTxPool::SynchronizeWorldLine(CWorldLineUpdate& update,CTxSetChange& change
         vTxRemove.push_back(make_pair(txidMint,block.txMint.vInput));
     }
 
+    if (!vResurrect.empty())
+    {
+        wlock.unlock();
+        workerAdmission.ForEach(vResurrect.size(),boost::bind(&CTxPool::PrepareResurrect,this,&vResurrect,&mapResurrect,_1));
+        wlock.lock();
+        nSyncCount++;
+    }
+
+    // the pool may have changed while unlocked: a tx admitted meanwhile is kept as it is,
+    // the spent state of the others is checked again under the lock
+    BOOST_FOREACH(CTxAdmission& admission,vResurrect)
+    {
+        const uint256& txid = admission.txid;
+        CTransaction& tx = *admission.pTx;
+        if (mapTx.count(txid))
+        {
+            continue;
+        }
+        if (admission.err == MV_OK)
+        {
+            for (std::size_t i = 0;i < tx.vInput.size();i++)
+            {
+                const CTxOutPoint& prevout = tx.vInput[i].prevout;
+                CTxOutput output;
+                if (txView.IsSpent(prevout)
+                    || (admission.vPrevOutput[i].IsNull() && !txView.GetUnspent(prevout,output)))
+                {
+                    admission.err = MV_ERR_TRANSACTION_CONFLICTING_INPUT;
+                    break;
+                }
+            }
+        }
+        if (admission.err == MV_OK)
+        {
+            uint256 spent0,spent1;
+
+            txView.GetSpent(CTxOutPoint(txid,0),spent0);
+            txView.GetSpent(CTxOutPoint(txid,1),spent1);
+
+            CPooledTxMap::iterator mi;
+            mi = mapTx.insert(make_pair(txid,CPooledTx(tx,-1,GetSequenceNumber(),admission.destIn,admission.nValueIn))).first;
+            txView.AddNew(txid,(*mi).second);
+
+            if (spent0 != 0) txView.SetSpent(CTxOutPoint(txid,0),spent0);
+            if (spent1 != 0) txView.SetSpent(CTxOutPoint(txid,1),spent1);
+
+            change.mapTxUpdate.insert(make_pair(txid,-1));
+            vDBAddNew.push_back(make_pair(txid,(*mi).second));
+        }
+        else
+        {
+            txView.InvalidateSpent(CTxOutPoint(txid,0),vInvalidTx);
+            txView.InvalidateSpent(CTxOutPoint(txid,1),vInvalidTx);
+            vTxRemove.push_back(make_pair(txid,tx.vInput));
+        }
+    }
+
     change.vTxRemove.reserve(vInvalidTx.size() + vTxRemove.size());
     BOOST_REVERSE_FOREACH(const uint256& txid,vInvalidTx)
     {
-        map<uint256,CPooledTx>::iterator it = mapTx.find(txid);
+        CPooledTxMap::iterator it = mapTx.find(txid);
         if (it != mapTx.end())
         {
             change.vTxRemove.push_back(make_pair(txid,(*it).second.vInput));
@@ -563,6 +692,7 @@ bool CTxPool::SynchronizeWorldLine(CWorldLineUpdate& update,CTxSetChange& change
         } 
     }
     change.vTxRemove.insert(change.vTxRemove.end(),vTxRemove.begin(),vTxRemove.end());
+    txView.Rearrange();
     if (!vDBAddNew.empty() || !vDBRemove.empty())
     {
         return dbTxPool.UpdateTx(update.hashFork,vDBAddNew,vDBRemove);
@@ -572,7 +702,7 @@ bool CTxPool::SynchronizeWorldLine(CWorldLineUpdate& update,CTxSetChange& change
 
 bool CTxPool::LoadTx(const uint256& txid,const uint256& hashFork,const CAssembledTx& tx)
 {
-    map<uint256,CPooledTx>::iterator mi = mapTx.insert(make_pair(txid,CPooledTx(tx,GetSequenceNumber()))).first;
+    CPooledTxMap::iterator mi = mapTx.insert(make_pair(txid,CPooledTx(tx,GetSequenceNumber()))).first;
     mapPoolView[hashFork].AddNew(txid,(*mi).second);
     return true;
 }
@@ -585,37 +715,190 @@ bool CTxPool::LoadDB()
     return dbTxPool.WalkThroughTx(walker);
 }
 
-MvErr CTxPool::AddNew(CTxPoolView& txView,const uint256& txid,CTransaction& tx,const uint256& hashFork,int nForkHeight)
+MvErr CTxPool::Admit(CTxAdmission& admission)
+{
+    MvErr err;
+    do
+    {
+        err = Prepare(admission);
+    } while (err == MV_OK && !Commit(admission));
+    return admission.err;
+}
+
+MvErr CTxPool::Prepare(CTxAdmission& admission)
 {
-    vector<CTxOutput> vPrevOutput;
-    if (!pWorldLine->GetTxUnspent(hashFork,tx.vInput,vPrevOutput))
+    CTransaction& tx = *admission.pTx;
+    admission.txid = tx.GetHash();
+    // stays failed unless every check below ran, a worker may stop half way
+    admission.err = MV_FAILED;
+
+    if (tx.IsMintTx())
+    {
+        return (admission.err = MV_ERR_TRANSACTION_INVALID);
+    }
+
+    MvErr err = pCoreProtocol->ValidateTransaction(tx);
+    if (err != MV_OK)
+    {
+        return (admission.err = err);
+    }
+
+    if (!pWorldLine->GetBlockLocation(tx.hashAnchor,admission.hashFork,admission.nForkHeight))
+    {
+        return (admission.err = MV_ERR_TRANSACTION_INVALID);
+    }
+
     {
-        return MV_ERR_SYS_STORAGE_ERROR;
+        boost::shared_lock<boost::shared_mutex> rlock(rwAccess);
+        if (mapTx.count(admission.txid))
+        {
+            return (admission.err = MV_ERR_ALREADY_HAVE);
+        }
+        admission.nSyncCount = nSyncCount;
+    }
+
+    vector<CTxOutput>& vPrevOutput = admission.vPrevOutput;
+    vPrevOutput.clear();
+    if (!pWorldLine->GetTxUnspent(admission.hashFork,tx.vInput,vPrevOutput))
+    {
+        return (admission.err = MV_ERR_SYS_STORAGE_ERROR);
     }
-    int64 nValueIn = 0;
-    for (int i = 0;i < tx.vInput.size();i++)
+
+    set<uint256> setMissingPrevTx;
     {
-        if (txView.IsSpent(tx.vInput[i].prevout))
+        boost::shared_lock<boost::shared_mutex> rlock(rwAccess);
+        map<uint256,CTxPoolView>::iterator it = mapPoolView.find(admission.hashFork);
+        for (size_t i = 0;i < tx.vInput.size();i++)
         {
-            return MV_ERR_TRANSACTION_CONFLICTING_INPUT;
+            const CTxOutPoint& prevout = tx.vInput[i].prevout;
+            if (it != mapPoolView.end() && (*it).second.IsSpent(prevout))
+            {
+                return (admission.err = MV_ERR_TRANSACTION_CONFLICTING_INPUT);
+            }
+            if (vPrevOutput[i].IsNull()
+                && (it == mapPoolView.end() || !(*it).second.GetUnspent(prevout,vPrevOutput[i])))
+            {
+                if (mapTx.count(prevout.hash))
+                {
+                    return (admission.err = MV_ERR_TRANSACTION_CONFLICTING_INPUT);
+                }
+                setMissingPrevTx.insert(prevout.hash);
+            }
         }
-        if (vPrevOutput[i].IsNull() && !txView.GetUnspent(tx.vInput[i].prevout,vPrevOutput[i]))
+    }
+    BOOST_FOREACH(const uint256& prev,setMissingPrevTx)
+    {
+        if (!pWorldLine->ExistsTx(prev))
         {
-            return MV_ERR_TRANSACTION_CONFLICTING_INPUT;
+            return (admission.err = MV_ERR_MISSING_PREV);
         }
-        nValueIn += vPrevOutput[i].nAmount;
     }
-    
-    MvErr err = pCoreProtocol->VerifyTransaction(tx,vPrevOutput,nForkHeight);
+    if (!setMissingPrevTx.empty())
+    {
+        return (admission.err = MV_ERR_TRANSACTION_CONFLICTING_INPUT);
+    }
+
+    // signature verification runs without holding the pool lock
+    err = pCoreProtocol->VerifyTransaction(tx,vPrevOutput,admission.nForkHeight);
     if (err != MV_OK)
     {
-        return err;
+        return (admission.err = err);
     }
-    
-    CDestination destIn = vPrevOutput[0].destTo;
-    map<uint256,CPooledTx>::iterator mi;
-    mi = mapTx.insert(make_pair(txid,CPooledTx(tx,-1,GetSequenceNumber(),destIn,nValueIn))).first;
-    txView.AddNew(txid,(*mi).second);
 
-    return MV_OK;
+    admission.destIn = vPrevOutput[0].destTo;
+    admission.nValueIn = 0;
+    BOOST_FOREACH(const CTxOutput& output,vPrevOutput)
+    {
+        admission.nValueIn += output.nAmount;
+    }
+    return (admission.err = MV_OK);
+}
+
+bool CTxPool::Commit(CTxAdmission& admission)
+{
+    CTransaction& tx = *admission.pTx;
+    const uint256& txid = admission.txid;
+
+    boost::unique_lock<boost::shared_mutex> wlock(rwAccess);
+
+    // the worldline moved on since the inputs were fetched, prepare again
+    if (admission.nSyncCount != nSyncCount)
+    {
+        return false;
+    }
+
+    if (mapTx.count(txid))
+    {
+        admission.err = MV_ERR_ALREADY_HAVE;
+        return true;
+    }
+
+    CTxPoolView& txView = mapPoolView[admission.hashFork];
+    for (size_t i = 0;i < tx.vInput.size();i++)
+    {
+        const CTxOutPoint& prevout = tx.vInput[i].prevout;
+        CTxOutput output;
+        if (txView.IsSpent(prevout)
+            || (txView.Exists(prevout.hash) && !txView.GetUnspent(prevout,output)))
+        {
+            admission.err = MV_ERR_TRANSACTION_CONFLICTING_INPUT;
+            return true;
+        }
+    }
+
+    CPooledTxMap::iterator mi;
+    mi = mapTx.insert(make_pair(txid,CPooledTx(tx,-1,GetSequenceNumber(),admission.destIn,admission.nValueIn))).first;
+    CPooledTx* pPooledTx = &(*mi).second;
+    txView.AddNew(txid,*pPooledTx);
+
+    vector<pair<uint256,CAssembledTx> > vDBAddNew;
+    vDBAddNew.push_back(make_pair(txid,*static_cast<CAssembledTx*>(pPooledTx)));
+    admission.err = (dbTxPool.UpdateTx(admission.hashFork,vDBAddNew) ? MV_OK : MV_ERR_SYS_DATABASE_ERROR);
+    return true;
+}
+
+void CTxPool::PrepareBatch(vector<CTxAdmission>* pvAdmission,const vector<size_t>* pvIndex,size_t n)
+{
+    Prepare((*pvAdmission)[(*pvIndex)[n]]);
+}
+
+void CTxPool::PrepareResurrect(vector<CTxAdmission>* pvResurrect,const map<uint256,CAssembledTx>* pmapResurrect,size_t n)
+{
+    CTxAdmission& admission = (*pvResurrect)[n];
+    CTransaction& tx = *admission.pTx;
+    admission.err = MV_FAILED;
+
+    vector<CTxOutput>& vPrevOutput = admission.vPrevOutput;
+    if (!pWorldLine->GetTxUnspent(admission.hashFork,tx.vInput,vPrevOutput))
+    {
+        admission.err = MV_ERR_SYS_STORAGE_ERROR;
+        return;
+    }
+
+    // inputs created by another resurrected tx are checked against the pool at insertion
+    vector<CTxOutput> vInput(vPrevOutput);
+    for (size_t i = 0;i < tx.vInput.size();i++)
+    {
+        if (vInput[i].IsNull())
+        {
+            const CTxOutPoint& prevout = tx.vInput[i].prevout;
+            map<uint256,CAssembledTx>::const_iterator it = pmapResurrect->find(prevout.hash);
+            if (it == pmapResurrect->end() || (vInput[i] = (*it).second.GetOutput(prevout.n)).IsNull())
+            {
+                admission.err = MV_ERR_TRANSACTION_CONFLICTING_INPUT;
+                return;
+            }
+        }
+    }
+
+    admission.err = pCoreProtocol->VerifyTransaction(tx,vInput,admission.nForkHeight);
+    if (admission.err == MV_OK)
+    {
+        admission.destIn = vInput[0].destTo;
+        admission.nValueIn = 0;
+        BOOST_FOREACH(const CTxOutput& output,vInput)
+        {
+            admission.nValueIn += output.nAmount;
+        }
+    }
 }
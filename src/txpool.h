@@ -8,6 +8,9 @@
 #include "mvbase.h"
 #include "txpooldb.h"
 
+#include <boost/unordered_map.hpp>
+#include <boost/pool/singleton_pool.hpp>
+
 namespace multiverse
 {
 
@@ -36,6 +39,53 @@ public:
     }
 };
 
+// Single-object allocations (hash nodes) come from a per-size slab pool,
+// bucket arrays fall back to the default allocator
+class CTxPoolAllocatorTag {};
+template <typename T>
+class CTxPoolAllocator : public std::allocator<T>
+{
+public:
+    typedef boost::singleton_pool<CTxPoolAllocatorTag,sizeof(T)> CSlab;
+    CTxPoolAllocator() throw() {}
+    CTxPoolAllocator(const CTxPoolAllocator& a) throw() : std::allocator<T>(a) {}
+    template <typename U>
+    CTxPoolAllocator(const CTxPoolAllocator<U>& a) throw() : std::allocator<T>(a) {}
+    ~CTxPoolAllocator() throw() {}
+    template<typename _Other> 
+    struct rebind { typedef CTxPoolAllocator<_Other> other; };
+
+    T* allocate(std::size_t n,const void *hint = 0)
+    {
+        if (n != 1)
+        {
+            return std::allocator<T>::allocate(n,hint);
+        }
+        T* p = static_cast<T*>(CSlab::malloc());
+        if (p == NULL)
+        {
+            throw std::bad_alloc();
+        }
+        return p;
+    }
+    void deallocate(T* p,std::size_t n)
+    {
+        if (n != 1)
+        {
+            std::allocator<T>::deallocate(p,n);
+        }
+        else
+        {
+            CSlab::free(p);
+        }
+    }
+};
+
+typedef boost::unordered_map<uint256,CPooledTx,crypto::CCryptoSaltedHasher,std::equal_to<uint256>,
+                             CTxPoolAllocator<std::pair<const uint256,CPooledTx> > > CPooledTxMap;
+typedef boost::unordered_map<uint256,CPooledTx*,crypto::CCryptoSaltedHasher,std::equal_to<uint256>,
+                             CTxPoolAllocator<std::pair<const uint256,CPooledTx*> > > CPooledTxLinkMap;
+
 class CTxPoolView
 {
 public:
@@ -51,7 +101,10 @@ public:
     public:
         uint256 txidNextTx;
     };
+    typedef boost::unordered_map<CTxOutPoint,CSpent,CTxOutPointHasher,std::equal_to<CTxOutPoint>,
+                                 CTxPoolAllocator<std::pair<const CTxOutPoint,CSpent> > > CSpentMap;
 public:
+    CTxPoolView() : nArrangedMaxSize(0) {}
     std::size_t Count() const { return mapTx.size(); }
     bool Exists(const uint256& txid) const
     {
@@ -59,12 +112,12 @@ public:
     }
     CPooledTx* Get(uint256 txid) const
     {
-        std::map<uint256,CPooledTx*>::const_iterator mi = mapTx.find(txid);
+        CPooledTxLinkMap::const_iterator mi = mapTx.find(txid);
         return (mi != mapTx.end() ? (*mi).second : NULL);
     }
     bool IsSpent(const CTxOutPoint& out) const
     {
-        std::map<CTxOutPoint,CSpent>::const_iterator it = mapSpent.find(out);
+        CSpentMap::const_iterator it = mapSpent.find(out);
         if (it != mapSpent.end())
         {
             return (*it).second.IsSpent();
@@ -73,7 +126,7 @@ public:
     }
     bool GetUnspent(const CTxOutPoint& out,CTxOutput& unspent) const
     {
-        std::map<CTxOutPoint,CSpent>::const_iterator it = mapSpent.find(out);
+        CSpentMap::const_iterator it = mapSpent.find(out);
         if (it != mapSpent.end() && !(*it).second.IsSpent())
         {
             unspent = static_cast<CTxOutput>((*it).second);
@@ -83,7 +136,7 @@ public:
     }
     bool GetSpent(const CTxOutPoint& out,uint256& txidNextTxRet) const 
     { 
-        std::map<CTxOutPoint,CSpent>::const_iterator it = mapSpent.find(out);
+        CSpentMap::const_iterator it = mapSpent.find(out);
         if (it != mapSpent.end())
         {
             txidNextTxRet = (*it).second.txidNextTx;
@@ -125,6 +178,7 @@ public:
         {
             mapSpent[CTxOutPoint(txid,1)].SetUnspent(output);
         }
+        AppendArranged(txid,tx);
     }
     void Remove(const uint256& txid)
     {
@@ -136,20 +190,44 @@ public:
                 SetUnspent(pTx->vInput[i].prevout);
             }
             mapTx.erase(txid);
+            spArranged.reset();
         } 
     }
     void Clear() 
     {
         mapTx.clear();
         mapSpent.clear();
+        spArranged.reset();
     }
     void InvalidateSpent(const CTxOutPoint& out,std::vector<uint256>& vInvolvedTx);
     void GetFilteredTx(std::map<std::size_t,std::pair<uint256,CPooledTx*> >& mapFilteredTx,
                        const CDestination& sendTo=CDestination(),const CDestination& destIn=CDestination());
     void ArrangeBlockTx(std::map<std::size_t,std::pair<uint256,CPooledTx*> >& mapArrangedTx,std::size_t nMaxSize);
+    bool GetArrangedBlockTx(std::size_t nMaxSize,CArrangedBlockTxPtr& spArrangedRet) const
+    {
+        if (spArranged && spArranged->IsUsable(nMaxSize))
+        {
+            spArrangedRet = spArranged;
+            return true;
+        }
+        return false;
+    }
+    void Rearrange(std::size_t nMaxSize);
+    void Rearrange()
+    {
+        if (!spArranged && nArrangedMaxSize != 0)
+        {
+            Rearrange(nArrangedMaxSize);
+        }
+    }
+protected:
+    void AppendArranged(const uint256& txid,const CPooledTx& tx);
 public:
-    std::map<uint256,CPooledTx*> mapTx;
-    std::map<CTxOutPoint,CSpent> mapSpent;
+    CPooledTxLinkMap mapTx;
+    CSpentMap mapSpent;
+protected:
+    boost::shared_ptr<CArrangedBlockTx> spArranged;
+    std::size_t nArrangedMaxSize;
 };
 
 class CTxPool : public ITxPool
@@ -161,12 +239,14 @@ public:
     void Clear();
     std::size_t Count(const uint256& fork) const;
     MvErr Push(CTransaction& tx,uint256& hashFork,CDestination& destIn,int64& nValueIn);
+    void Push(std::vector<CTxAdmission>& vAdmission);
     void Pop(const uint256& txid);
     bool Get(const uint256& txid,CTransaction& tx) const;
     void ListTx(const uint256& hashFork,std::vector<std::pair<uint256,std::size_t> >& vTxPool);
     void ListTx(const uint256& hashFork,std::vector<uint256>& vTxPool);
     bool FilterTx(CTxFilter& filter);
     void ArrangeBlockTx(const uint256& hashFork,std::size_t nMaxSize,std::vector<CTransaction>& vtx,int64& nTotalTxFee);
+    void GetArrangedBlockTx(const uint256& hashFork,std::size_t nMaxSize,CArrangedBlockTxPtr& spArranged);
     bool FetchInputs(const uint256& hashFork,const CTransaction& tx,std::vector<CTxOutput>& vUnspent);
     bool SynchronizeWorldLine(CWorldLineUpdate& update,CTxSetChange& change);
     bool LoadTx(const uint256& txid,const uint256& hashFork,const CAssembledTx& tx);
@@ -176,7 +256,11 @@ protected:
     bool WalleveHandleInvoke();
     void WalleveHandleHalt();
     bool LoadDB();
-    MvErr AddNew(CTxPoolView& txView,const uint256& txid,CTransaction& tx,const uint256& hashFork,int nForkHeight);
+    MvErr Admit(CTxAdmission& admission);
+    MvErr Prepare(CTxAdmission& admission);
+    bool Commit(CTxAdmission& admission);
+    void PrepareBatch(std::vector<CTxAdmission>* pvAdmission,const std::vector<std::size_t>* pvIndex,std::size_t n);
+    void PrepareResurrect(std::vector<CTxAdmission>* pvResurrect,const std::map<uint256,CAssembledTx>* pmapResurrect,std::size_t n);
     std::size_t GetSequenceNumber()
     {
         if (mapTx.empty())
@@ -188,11 +272,14 @@ protected:
 protected:
     storage::CTxPoolDB dbTxPool;
     mutable boost::shared_mutex rwAccess;
+    boost::mutex mtxSync;
     ICoreProtocol* pCoreProtocol;
     IWorldLine* pWorldLine;
     std::map<uint256,CTxPoolView> mapPoolView;
-    std::map<uint256,CPooledTx> mapTx;
+    CPooledTxMap mapTx;
     std::size_t nLastSequenceNumber;
+    std::size_t nSyncCount;
+    walleve::CWalleveWorkers workerAdmission;
 };
 
 } // namespace multiverse
@@ -44,15 +44,21 @@ void DisplayUsage()
             "  -dnsseed         \t  "   + _("Find peers using DNS lookup (default: 1)") + "\n" +
             "  -banscore=<n>    \t  "   + _("Threshold for disconnecting misbehaving peers (default: 100)") + "\n" +
             "  -bantime=<n>     \t  "   + _("Number of seconds to keep misbehaving peers from reconnecting (default: 86400)") + "\n" +
+            "  -peeruploadrate=<n>\t  " + _("Limit upload to each peer to <n> KB per second (default: 0 = unlimited)") + "\n" +
+            "  -netthreads=<n>  \t  "   + _("Run peer network io on <n> threads (default: 1)") + "\n" +
+            "  -compress        \t  "   + _("Compress messages of 1 KB or more to peers that support it (default: 1)") + "\n" +
+            "  -fastchecksum    \t  "   + _("Use CRC32C message checksums with peers that support it, block and tx payloads then carry no transport checksum (default: 1)") + "\n" +
             "  -paytxfee=<amt>  \t  "   + _("Fee per KB to add to transactions you send") + "\n" +
 #if !defined(WIN32)
             "  -daemon          \t\t  " + _("Run in the background as a daemon and accept commands") + "\n" +
 #endif
             "  -testnet         \t\t  " + _("Use the test network") + "\n" +
+            "  -assumevalid=<hash>\t  " + _("Skip signature checks of ancestors of this block during initial sync") + "\n" +
             "  -debug           \t\t  " + _("Output extra debugging information") + "\n" +
             "  -rpcuser=<user>  \t  "   + _("Username for JSON-RPC connections") + "\n" +
             "  -rpcpassword=<pw>\t  "   + _("Password for JSON-RPC connections") + "\n" +
             "  -rpcport=<port>  \t\t  " + _("Listen for JSON-RPC connections on <port> (default: 6802)") + "\n" +
+            "  -rpcthreads=<n>  \t  "   + _("Run JSON-RPC server io on <n> threads (default: 1)") + "\n" +
             "  -rpcallowip=<ip> \t\t  " + _("Allow JSON-RPC connections from specified IP address") + "\n" +
             "  -rpcconnect=<ip> \t  "   + _("Send commands to node running on <ip> (default: 127.0.0.1)") + "\n" +
             "  -keypool=<n>     \t  "   + _("Set key pool size to <n> (default: 100)") + "\n" +
@@ -427,12 +427,15 @@ bool CWallet::GetBalance(const CDestination& dest,const uint256& hashFork,int nF
 bool CWallet::SignTransaction(const CDestination& destIn,CTransaction& tx,bool& fCompleted) const
 {
     boost::shared_lock<boost::shared_mutex> rlock(rwKeyStore);
-    return SignDestination(destIn,tx.GetSignatureHash(),tx.vchSig,fCompleted);
+    bool fSigned = SignDestination(destIn,tx.GetSignatureHash(),tx.vchSig,fCompleted);
+    tx.InvalidateHash();
+    return fSigned;
 }
 
 bool CWallet::ArrangeInputs(const CDestination& destIn,const uint256& hashFork,int nForkHeight,CTransaction& tx)
 {
     tx.vInput.clear();
+    tx.InvalidateHash();
     size_t nNoInputSize = GetSerializeSize(tx);
     int nMaxInput = (MAX_TX_SIZE - MAX_SIGNATURE_SIZE - 4) / 33;
     int64 nTargeValue = tx.nAmount + tx.nTxFee;
@@ -620,7 +623,7 @@ bool CWallet::SynchronizeTxSet(CTxSetChange& change)
     vector<uint256> vRemove;
     BOOST_FOREACH(const uint256& txid,setTxUpdate)
     {
-        map<uint256,CWalletTx>::iterator it = mapWalletTx.find(txid);
+        CWalletTxMap::iterator it = mapWalletTx.find(txid);
         if (it != mapWalletTx.end())
         {
             CWalletTx& wtx = (*it).second;
@@ -664,7 +667,7 @@ bool CWallet::ClearTx()
 
 CWalletTx* CWallet::LoadWalletTx(const uint256& txid)
 {
-    map<uint256,CWalletTx>::iterator it = mapWalletTx.find(txid);
+    CWalletTxMap::iterator it = mapWalletTx.find(txid);
     if (it == mapWalletTx.end())
     {
         CWalletTx wtx;
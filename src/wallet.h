@@ -9,6 +9,7 @@
 #include "walletdb.h"
 #include "wallettx.h"
 #include <boost/thread/thread.hpp>
+#include <boost/unordered_map.hpp>
 
 namespace multiverse
 {
@@ -77,6 +78,7 @@ public:
 class CWallet : public IWallet
 {
 public:
+    typedef boost::unordered_map<uint256,CWalletTx,crypto::CCryptoSaltedHasher> CWalletTxMap;
     CWallet();
     ~CWallet();
     bool IsMine(const CDestination& dest);
@@ -136,7 +138,7 @@ protected:
     mutable boost::shared_mutex rwWalletTx;
     std::map<crypto::CPubKey,CWalletKeyStore> mapKeyStore;
     std::map<CTemplateId,CTemplatePtr> mapTemplatePtr;
-    std::map<uint256,CWalletTx> mapWalletTx;
+    CWalletTxMap mapWalletTx;
     std::map<CDestination,CWalletUnspent> mapWalletUnspent;
 };
 
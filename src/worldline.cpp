@@ -149,6 +149,11 @@ bool CWorldLine::GetBlock(const uint256& hashBlock,CBlock& block)
     return cntrBlock.Retrieve(hashBlock,block);
 }
 
+bool CWorldLine::GetBlockRaw(const uint256& hashBlock,vector<char>& vRaw)
+{
+    return cntrBlock.RetrieveRaw(hashBlock,vRaw);
+}
+
 bool CWorldLine::Exists(const uint256& hashBlock)
 {
     return cntrBlock.Exists(hashBlock);
@@ -178,6 +183,17 @@ bool CWorldLine::GetTxUnspent(const uint256& hashFork,const vector<CTxIn>& vInpu
         return false;
     }
     
+    vector<CTxOutPoint> vPrevOut;
+    vPrevOut.reserve(vInput.size());
+    BOOST_FOREACH(const CTxIn& txin,vInput)
+    {
+        vPrevOut.push_back(txin.prevout);
+    }
+    if (!view.PrefetchUnspent(vPrevOut))
+    {
+        return false;
+    }
+
     for (std::size_t i = 0;i < vInput.size();i++)
     {
         view.RetrieveUnspent(vInput[i].prevout,vOutput[i]);
@@ -231,6 +247,12 @@ MvErr CWorldLine::AddNewBlock(CBlock& block,CWorldLineUpdate& update)
     
     view.AddTx(block.txMint.GetHash(),block.txMint);
 
+    if (!PrefetchBlockUnspent(view,block))
+    {
+        WalleveLog("AddNewBlock Prefetch Unspent Error : %s \n",hash.ToString().c_str());
+        return MV_ERR_SYS_STORAGE_ERROR;
+    }
+
     CBlockEx blockex(block);
     vector<CTxContxt>& vTxContxt = blockex.vTxContxt;
 
@@ -246,16 +268,18 @@ MvErr CWorldLine::AddNewBlock(CBlock& block,CWorldLineUpdate& update)
             WalleveLog("AddNewBlock Get txContxt Error(%s) : %s \n",MvErrString(err),txid.ToString().c_str());
             return err;
         }
-        err = pCoreProtocol->VerifyBlockTx(tx,txContxt,pIndexPrev);
-        if (err != MV_OK)
-        {
-            WalleveLog("AddNewBlock Verify BlockTx Error(%s) : %s \n",MvErrString(err),txid.ToString().c_str());
-            return err;
-        }
         vTxContxt.push_back(txContxt);
         view.AddTx(txid,tx,txContxt.destIn,txContxt.GetValueIn());
     }
 
+    size_t nInvalidTx = 0;
+    err = pCoreProtocol->VerifyBlockTx(blockex,pIndexPrev,nInvalidTx);
+    if (err != MV_OK)
+    {
+        WalleveLog("AddNewBlock Verify BlockTx Error(%s) : %s \n",MvErrString(err),block.vtx[nInvalidTx].GetHash().ToString().c_str());
+        return err;
+    }
+
     CBlockIndex* pIndexNew;
     if (!cntrBlock.AddNew(hash,blockex,&pIndexNew))
     {
@@ -278,6 +302,12 @@ MvErr CWorldLine::AddNewBlock(CBlock& block,CWorldLineUpdate& update)
         WalleveLog("AddNewBlock Storage Commit BlockView Error : %s \n",hash.ToString().c_str());
         return MV_ERR_SYS_STORAGE_ERROR;
     }
+
+    // assumed-valid entries up to the connected height are either connected or on a lost branch
+    if (pIndexNew->IsPrimary())
+    {
+        pCoreProtocol->PruneAssumeValidBlock(pIndexNew->nHeight);
+    }
    
     update = CWorldLineUpdate(pIndexNew);
     view.GetTxUpdated(update.setTxUpdate);
@@ -320,6 +350,38 @@ bool CWorldLine::GetBlockInv(const uint256& hashFork,const CBlockLocator& locato
     return cntrBlock.GetForkBlockInv(hashFork,locator,vBlockHash,nMaxCount);
 }
 
+bool CWorldLine::GetBlockHeaders(const uint256& hashFork,const CBlockLocator& locator,vector<CBlock>& vHeader,size_t nMaxCount)
+{
+    vector<uint256> vBlockHash;
+    if (!cntrBlock.GetForkBlockInv(hashFork,locator,vBlockHash,nMaxCount))
+    {
+        return false;
+    }
+    vHeader.reserve(vBlockHash.size());
+    BOOST_FOREACH(const uint256& hash,vBlockHash)
+    {
+        // only the head is read, so the cost does not depend on block size. vchSig stays empty,
+        // it is not covered by the block hash and not checked on headers
+        CBlock block;
+        if (!cntrBlock.RetrieveHeader(hash,block))
+        {
+            return false;
+        }
+        // the inventory ends with the fork tip when it is truncated, headers must stay contiguous
+        if (!vHeader.empty() && block.hashPrev != vHeader.back().GetHash())
+        {
+            break;
+        }
+        vHeader.push_back(block);
+    }
+    return true;
+}
+
+bool CWorldLine::GetBlockIndex(const uint256& hashBlock,CBlockIndex** ppIndex)
+{
+    return cntrBlock.RetrieveIndex(hashBlock,ppIndex);
+}
+
 bool CWorldLine::CheckContainer()
 {
     if (cntrBlock.IsEmpty())
@@ -380,6 +442,24 @@ MvErr CWorldLine::GetTxContxt(storage::CBlockView& view,const CTransaction& tx,C
     return MV_OK; 
 }
 
+bool CWorldLine::PrefetchBlockUnspent(storage::CBlockView& view,const CBlock& block)
+{
+    set<uint256> setBlockTx;
+    vector<CTxOutPoint> vPrevOut;
+    BOOST_FOREACH(const CTransaction& tx,block.vtx)
+    {
+        BOOST_FOREACH(const CTxIn& txin,tx.vInput)
+        {
+            if (!setBlockTx.count(txin.prevout.hash))
+            {
+                vPrevOut.push_back(txin.prevout);
+            }
+        }
+        setBlockTx.insert(tx.GetHash());
+    }
+    return view.PrefetchUnspent(vPrevOut);
+}
+
 bool CWorldLine::GetBlockChanges(const CBlockIndex* pIndexNew,const CBlockIndex* pIndexFork,
                                  vector<CBlockEx>& vBlockAddNew,vector<CBlockEx>& vBlockRemove)
 {
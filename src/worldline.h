@@ -22,6 +22,7 @@ public:
     bool GetBlockHash(const uint256& hashFork,int nHeight,uint256& hashBlock);
     bool GetLastBlock(const uint256& hashFork,uint256& hashBlock,int& nHeight,int64& nTime);
     bool GetBlock(const uint256& hashBlock,CBlock& block);
+    bool GetBlockRaw(const uint256& hashBlock,std::vector<char>& vRaw);
     bool Exists(const uint256& hashBlock);
     bool GetTransaction(const uint256& txid,CTransaction& tx);
     bool ExistsTx(const uint256& txid);
@@ -33,6 +34,8 @@ public:
     bool GetProofOfWorkTarget(const uint256& hashPrev,int nAlgo,int& nBits,int64& nReward);
     bool GetBlockLocator(const uint256& hashFork,CBlockLocator& locator);
     bool GetBlockInv(const uint256& hashFork,const CBlockLocator& locator,std::vector<uint256>& vBlockHash,std::size_t nMaxCount);
+    bool GetBlockHeaders(const uint256& hashFork,const CBlockLocator& locator,std::vector<CBlock>& vHeader,std::size_t nMaxCount);
+    bool GetBlockIndex(const uint256& hashBlock,CBlockIndex** ppIndex);
 protected:
     bool WalleveHandleInitialize();
     void WalleveHandleDeinitialize();
@@ -42,6 +45,7 @@ protected:
     bool RebuildContainer();
     bool InsertGenesisBlock(CBlock& block);
     MvErr GetTxContxt(storage::CBlockView& view,const CTransaction& tx,CTxContxt& txContxt);
+    bool PrefetchBlockUnspent(storage::CBlockView& view,const CBlock& block);
     bool GetBlockChanges(const CBlockIndex* pIndexNew,const CBlockIndex* pIndexFork,
                          std::vector<CBlockEx>& vBlockAddNew,std::vector<CBlockEx>& vBlockRemove);
 protected:
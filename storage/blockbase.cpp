@@ -13,6 +13,9 @@ using namespace multiverse::storage;
 #define BLOCKFILE_PREFIX	"block"
 #define LOGFILE_NAME            "storage.log"
 
+// a stored block head (fields up to txMint) fits in this many bytes unless txMint carries large data
+static const uint32 BLOCK_HEAD_READ_SIZE = 4096;
+
 //////////////////////////////
 // CBlockBaseDBWalker
 
@@ -49,6 +52,31 @@ public:
     CBlockBase* pBlockBase;
 };
 
+//////////////////////////////
+// CBlockHeadLoader
+
+// Loads the fields of a stored block up to txMint, vtx and vchSig are left undecoded
+class CBlockHeadLoader
+{
+    friend class walleve::CWalleveStream;
+public:
+    CBlockHeadLoader(CBlock& blockIn) : block(blockIn) {}
+protected:
+    template <typename O>
+    void WalleveSerialize(walleve::CWalleveStream& s,O& opt)
+    {
+        s.Serialize(block.nVersion,opt);
+        s.Serialize(block.nType,opt);
+        s.Serialize(block.nTimeStamp,opt);
+        s.Serialize(block.hashPrev,opt);
+        s.Serialize(block.hashMerkle,opt);
+        s.Serialize(block.vchProof,opt);
+        s.Serialize(block.txMint,opt);
+    }
+protected:
+    CBlock& block;
+};
+
 //////////////////////////////
 // CBlockView
  
@@ -111,7 +139,7 @@ void CBlockView::Deinitialize()
 
 bool CBlockView::ExistsTx(const uint256& txid) const
 {
-    map<uint256,CTransaction>::const_iterator it = mapTx.find(txid);
+    CTxMap::const_iterator it = mapTx.find(txid);
     if (it != mapTx.end())
     {
         return (!(*it).second.IsNull());
@@ -121,7 +149,7 @@ bool CBlockView::ExistsTx(const uint256& txid) const
 
 bool CBlockView::RetrieveTx(const uint256& txid,CTransaction& tx)
 {
-    map<uint256,CTransaction>::const_iterator it = mapTx.find(txid);
+    CTxMap::const_iterator it = mapTx.find(txid);
     if (it != mapTx.end())
     {
         tx = (*it).second;
@@ -132,7 +160,7 @@ bool CBlockView::RetrieveTx(const uint256& txid,CTransaction& tx)
 
 bool CBlockView::RetrieveUnspent(const CTxOutPoint& out,CTxOutput& unspent)
 {
-    map<CTxOutPoint,CUnspent>::const_iterator it = mapUnspent.find(out);
+    CUnspentMap::const_iterator it = mapUnspent.find(out);
     if (it != mapUnspent.end())
     {
         unspent = (*it).second;
@@ -142,6 +170,43 @@ bool CBlockView::RetrieveUnspent(const CTxOutPoint& out,CTxOutput& unspent)
     return pBlockBase->GetTxUnspent(hashFork,out,unspent);
 }
 
+// Outputs not changed by the view are resolved in batched queries and kept
+// as unmodified entries, missing ones as null entries
+bool CBlockView::PrefetchUnspent(const vector<CTxOutPoint>& vOut)
+{
+    vector<CTxOutPoint> vQuery;
+    vQuery.reserve(vOut.size());
+    BOOST_FOREACH(const CTxOutPoint& out,vOut)
+    {
+        if (!mapUnspent.count(out))
+        {
+            vQuery.push_back(out);
+        }
+    }
+    if (vQuery.empty())
+    {
+        return true;
+    }
+
+    map<CTxOutPoint,CTxOutput> mapFetched;
+    if (!pBlockBase->GetTxUnspent(hashFork,vQuery,mapFetched))
+    {
+        return false;
+    }
+    BOOST_FOREACH(const CTxOutPoint& out,vQuery)
+    {
+        CUnspent& unspent = mapUnspent[out];
+        map<CTxOutPoint,CTxOutput>::iterator it = mapFetched.find(out);
+        if (it != mapFetched.end())
+        {
+            unspent.destTo = (*it).second.destTo;
+            unspent.nAmount = (*it).second.nAmount;
+            unspent.nLockUntil = (*it).second.nLockUntil;
+        }
+    }
+    return true;
+}
+
 void CBlockView::AddTx(const uint256& txid,const CTransaction& tx,const CDestination& destIn,int64 nValueIn)
 {
     mapTx[txid] = tx;
@@ -181,7 +246,7 @@ void CBlockView::GetUnspentChanges(vector<CTxUnspent>& vAddNew,vector<CTxOutPoin
     vAddNew.reserve(mapUnspent.size());
     vRemove.reserve(mapUnspent.size());
 
-    for (map<CTxOutPoint,CUnspent>::iterator it = mapUnspent.begin();it != mapUnspent.end();++it)
+    for (CUnspentMap::iterator it = mapUnspent.begin();it != mapUnspent.end();++it)
     {
         const CTxOutPoint& out = (*it).first;
         const CUnspent& unspent = (*it).second;
@@ -333,6 +398,7 @@ bool CBlockBase::AddNew(const uint256& hash,CBlockEx& block,CBlockIndex** ppInde
         {
             return false;
         }
+        pIndexNew->nBlockSize = GetSerializeSize(static_cast<const CBlock&>(block));
 
         if (!dbBlock.AddNewBlock(CBlockOutline(pIndexNew)))
         {
@@ -378,6 +444,55 @@ bool CBlockBase::Retrieve(const uint256& hash,CBlock& block)
     return true;    
 }
 
+bool CBlockBase::RetrieveHeader(const uint256& hash,CBlock& block)
+{
+    block.SetNull();
+
+    CBlockIndex* pIndex;
+    {
+        CWalleveReadLock rlock(rwAccess);
+        if (!(pIndex = GetIndex(hash)))
+        {
+            return false;
+        }
+    }
+    CBlockHeadLoader loader(block);
+    if (!tsBlock.ReadHead(loader,pIndex->nFile,pIndex->nOffset,BLOCK_HEAD_READ_SIZE)
+        && !tsBlock.Read(loader,pIndex->nFile,pIndex->nOffset))
+    {
+        return false;
+    }
+    block.InvalidateHash();
+    return true;
+}
+
+bool CBlockBase::RetrieveRaw(const uint256& hash,vector<char>& vRaw)
+{
+    CBlockIndex* pIndex;
+    uint32 nBlockSize;
+    {
+        CWalleveReadLock rlock(rwAccess);
+        if (!(pIndex = GetIndex(hash)))
+        {
+            return false;
+        }
+        nBlockSize = pIndex->nBlockSize;
+    }
+    if (nBlockSize == 0)
+    {
+        // indexes loaded from db do not know the size, found out once by decoding
+        CBlock block;
+        if (!tsBlock.Read(block,pIndex->nFile,pIndex->nOffset))
+        {
+            return false;
+        }
+        nBlockSize = GetSerializeSize(block);
+        CWalleveWriteLock wlock(rwAccess);
+        pIndex->nBlockSize = nBlockSize;
+    }
+    return tsBlock.ReadRaw(vRaw,pIndex->nFile,pIndex->nOffset,nBlockSize);
+}
+
 bool CBlockBase::Retrieve(const CBlockIndex* pIndex,CBlock& block)
 {
     block.SetNull();
@@ -662,7 +777,7 @@ bool CBlockBase::LoadIndex(CBlockOutline& outline)
     {
         return false;
     }
-    map<uint256, CBlockIndex*>::iterator mi;
+    CBlockIndexMap::iterator mi;
     mi = mapIndex.insert(make_pair(hash, pIndexNew)).first;
     pIndexNew->phashBlock = &((*mi).first);
     pIndexNew->pPrev = NULL;
@@ -681,6 +796,7 @@ bool CBlockBase::LoadIndex(CBlockOutline& outline)
             pIndexNew->pOrigin = pIndexNew->pPrev->pOrigin;
         }
     }
+    pIndexNew->UpdateWork();
     return true;
 }
 
@@ -780,7 +896,7 @@ bool CBlockBase::GetForkBlockInv(const uint256& hashFork,const CBlockLocator& lo
 
 CBlockIndex* CBlockBase::GetIndex(const uint256& hash) const
 {
-    map<uint256,CBlockIndex*>::const_iterator mi = mapIndex.find(hash);
+    CBlockIndexMap::const_iterator mi = mapIndex.find(hash);
     return (mi != mapIndex.end() ? (*mi).second : NULL);
 }
 
@@ -816,14 +932,14 @@ CBlockIndex* CBlockBase::AddNewIndex(const uint256& hash,CBlock& block,uint32 nF
     CBlockIndex* pIndexNew = new CBlockIndex(block,nFile,nOffset);
     if (pIndexNew != NULL)
     {
-        map<uint256, CBlockIndex*>::iterator mi = mapIndex.insert(make_pair(hash, pIndexNew)).first;
+        CBlockIndexMap::iterator mi = mapIndex.insert(make_pair(hash, pIndexNew)).first;
         pIndexNew->phashBlock = &((*mi).first);
     
         int64 nMoneySupply = block.txMint.nAmount;
         uint64 nChainTrust = block.GetBlockTrust();
         uint64 nRandBeacon = block.GetBlockBeacon();
         CBlockIndex* pIndexPrev = NULL;
-        map<uint256, CBlockIndex*>::iterator miPrev = mapIndex.find(block.hashPrev);
+        CBlockIndexMap::iterator miPrev = mapIndex.find(block.hashPrev);
         if (miPrev != mapIndex.end())
         {
             pIndexPrev = (*miPrev).second;
@@ -840,6 +956,7 @@ CBlockIndex* CBlockBase::AddNewIndex(const uint256& hash,CBlock& block,uint32 nF
         pIndexNew->nMoneySupply = nMoneySupply;
         pIndexNew->nChainTrust = nChainTrust;
         pIndexNew->nRandBeacon = nRandBeacon;
+        pIndexNew->UpdateWork();
     }
     return pIndexNew;
 }
@@ -923,6 +1040,11 @@ bool CBlockBase::GetTxUnspent(const uint256 fork,const CTxOutPoint& out,CTxOutpu
     return dbBlock.RetrieveTxUnspent(fork,out,unspent);
 }
 
+bool CBlockBase::GetTxUnspent(const uint256 fork,const vector<CTxOutPoint>& vOut,map<CTxOutPoint,CTxOutput>& mapUnspent)
+{
+    return dbBlock.RetrieveTxUnspent(fork,vOut,mapUnspent);
+}
+
 bool CBlockBase::GetTxNewIndex(CBlockView& view,CBlockIndex* pIndexNew,vector<pair<uint256,CTxIndex> >& vTxNew)
 {
     vector<CBlockIndex*> vPath;
@@ -968,7 +1090,7 @@ bool CBlockBase::GetTxNewIndex(CBlockView& view,CBlockIndex* pIndexNew,vector<pa
 
 void CBlockBase::ClearCache()
 {
-    map<uint256, CBlockIndex *>::iterator mi;
+    CBlockIndexMap::iterator mi;
     for (mi = mapIndex.begin(); mi != mapIndex.end(); ++mi)
     {
         delete (*mi).second;
@@ -11,6 +11,7 @@
 #include "walleve/walleve.h"
 
 #include <map>
+#include <boost/unordered_map.hpp>
 #include <boost/thread/thread.hpp>
 #include <boost/smart_ptr/shared_ptr.hpp>
 
@@ -116,6 +117,8 @@ public:
         void Disable() { SetNull(); nOpt--; }
         bool IsModified() const { return (nOpt != 0); }
     };
+    typedef boost::unordered_map<uint256,CTransaction,crypto::CCryptoSaltedHasher> CTxMap;
+    typedef boost::unordered_map<CTxOutPoint,CUnspent,CTxOutPointHasher> CUnspentMap;
     CBlockView();
     ~CBlockView();
     void Initialize(CBlockBase* pBlockBaseIn,CBlockFork* pBlockForkIn,
@@ -127,6 +130,7 @@ public:
     bool ExistsTx(const uint256& txid) const;
     bool RetrieveTx(const uint256& txid,CTransaction& tx);
     bool RetrieveUnspent(const CTxOutPoint& out,CTxOutput& unspent);
+    bool PrefetchUnspent(const std::vector<CTxOutPoint>& vOut);
     void AddTx(const uint256& txid,const CTransaction& tx,const CDestination& destIn=CDestination(),int64 nValueIn=0);
     void AddTx(const uint256& txid,const CAssembledTx& tx) { AddTx(txid,tx,tx.destIn,tx.nValueIn); }
     void RemoveTx(const uint256& txid,const CTransaction& tx,const CTxContxt& txContxt=CTxContxt());
@@ -138,8 +142,8 @@ protected:
     CBlockFork* pBlockFork;
     uint256 hashFork;
     bool fCommittable;
-    std::map<uint256,CTransaction> mapTx;
-    std::map<CTxOutPoint,CUnspent> mapUnspent;
+    CTxMap mapTx;
+    CUnspentMap mapUnspent;
     std::vector<uint256> vTxRemove;
     std::vector<uint256> vTxAddNew;
 };
@@ -148,6 +152,7 @@ class CBlockBase
 {
     friend class CBlockView;
 public:
+    typedef boost::unordered_map<uint256,CBlockIndex*,crypto::CCryptoSaltedHasher> CBlockIndexMap;
     CBlockBase();
     ~CBlockBase();
     bool Initialize(const CMvDBConfig& dbConfig,int nMaxDBConn,
@@ -162,6 +167,8 @@ public:
     bool Retrieve(const CBlockIndex* pIndex,CBlock& block);
     bool Retrieve(const uint256& hash,CBlockEx& block);
     bool Retrieve(const CBlockIndex* pIndex,CBlockEx& block);
+    bool RetrieveHeader(const uint256& hash,CBlock& block);
+    bool RetrieveRaw(const uint256& hash,std::vector<char>& vRaw);
     bool RetrieveIndex(const uint256& hash,CBlockIndex** ppIndex);
     bool RetrieveFork(const uint256& hash,CBlockIndex** ppIndex);
     bool RetrieveTx(const uint256& txid,CTransaction& tx);
@@ -188,6 +195,7 @@ protected:
     bool UpdateDelegate(const uint256& hash,CBlockEx& block);
     bool UpdateEnroll(CBlockIndex* pIndexNew,std::vector<std::pair<uint256,CTxIndex> >& vTxNew);
     bool GetTxUnspent(const uint256 fork,const CTxOutPoint& out,CTxOutput& unspent);
+    bool GetTxUnspent(const uint256 fork,const std::vector<CTxOutPoint>& vOut,std::map<CTxOutPoint,CTxOutput>& mapUnspent);
     bool GetTxNewIndex(CBlockView& view,CBlockIndex* pIndexNew,std::vector<std::pair<uint256,CTxIndex> >& vTxNew);
     void ClearCache();
     bool LoadDB();
@@ -222,7 +230,7 @@ protected:
     bool fDebugLog;
     CBlockDB dbBlock;
     CTimeSeries tsBlock;
-    std::map<uint256,CBlockIndex*> mapIndex;
+    CBlockIndexMap mapIndex;
     std::map<uint256,CBlockFork> mapFork;
 };
 
@@ -8,6 +8,8 @@
 using namespace std;
 using namespace multiverse::storage;
 
+#define MAX_UNSPENT_QUERY       512
+
 //////////////////////////////
 // CBlockDB
 
@@ -540,6 +542,48 @@ bool CBlockDB::RetrieveTxUnspent(const uint256& fork,const CTxOutPoint& out,CTxO
     } 
 }
 
+bool CBlockDB::RetrieveTxUnspent(const uint256& fork,const vector<CTxOutPoint>& vOut,map<CTxOutPoint,CTxOutput>& mapUnspent)
+{
+    CMvDBInst db(&dbPool);
+    if (!db.Available())
+    {
+        return false;
+    }
+
+    map<uint256,int>::iterator it = mapForkIndex.find(fork);
+    if (it == mapForkIndex.end())
+    {
+        return false;
+    }
+    int nIndex = (*it).second;
+
+    for (size_t nBegin = 0;nBegin < vOut.size();nBegin += MAX_UNSPENT_QUERY)
+    {
+        size_t nEnd = min(nBegin + (size_t)MAX_UNSPENT_QUERY,vOut.size());
+        ostringstream oss;
+        oss << "SELECT txid,nout,dest,amount,lockuntil FROM unspent" << nIndex
+            << " WHERE (txid,nout) IN (";
+        for (size_t i = nBegin;i < nEnd;i++)
+        {
+            oss << (i != nBegin ? ",(\'" : "(\'") << db->ToEscString(vOut[i].hash) << "\'," << ((int)vOut[i].n) << ")";
+        }
+        oss << ")";
+        CMvDBRes res(*db,oss.str());
+        while (res.GetRow())
+        {
+            CTxOutPoint out;
+            CTxOutput unspent;
+            if (!res.GetField(0,out.hash) || !res.GetField(1,out.n) || !res.GetField(2,unspent.destTo)
+                || !res.GetField(3,unspent.nAmount) || !res.GetField(4,unspent.nLockUntil))
+            {
+                return false;
+            }
+            mapUnspent.insert(make_pair(out,unspent));
+        }
+    }
+    return true;
+}
+
 bool CBlockDB::FilterTx(CBlockDBTxFilter& filter)
 {
     CMvDBInst db(&dbPool);
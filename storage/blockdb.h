@@ -68,6 +68,7 @@ public:
     bool RetrieveTxPos(const uint256& txid,uint32& nFile,uint32& nOffset);
     bool RetrieveTxLocation(const uint256& txid,uint256& hashAnchor,int& nBlockHeight);
     bool RetrieveTxUnspent(const uint256& fork,const CTxOutPoint& out,CTxOutput& unspent);
+    bool RetrieveTxUnspent(const uint256& fork,const std::vector<CTxOutPoint>& vOut,std::map<CTxOutPoint,CTxOutput>& mapUnspent);
     bool FilterTx(CBlockDBTxFilter& filter);
     bool RetrieveDelegate(const uint256& hash,int64 nMinAmount,std::map<CDestination,int64>& mapDelegate);
     bool RetrieveEnroll(const uint256& hashAnchor,const std::set<uint256>& setBlockRange, 
@@ -101,12 +101,89 @@ bool CTimeSeries::GetLastFilePath(uint32& nFile,std::string& strPath)
     return false;
 }
 
+bool CTimeSeries::ReadRaw(vector<char>& vData,uint32 nFile,uint32 nOffset,uint32 nSize)
+{
+    boost::unique_lock<boost::mutex> lock(mtxFile);
+
+    vData.resize(nSize);
+    if (nSize == 0)
+    {
+        return true;
+    }
+
+    // copy the leading nSize bytes of the record without decoding
+    map<CDiskPos,pair<size_t,uint32> >::iterator it = mapCachePos.find(CDiskPos(nFile,nOffset));
+    if (it != mapCachePos.end() && nSize <= (*it).second.second)
+    {
+        try
+        {
+            const char* pData = cacheStream.GetData((*it).second.first,nSize);
+            if (pData != NULL)
+            {
+                memcpy(&vData[0],pData,nSize);
+                return true;
+            }
+            if (cacheStream.Seek((*it).second.first))
+            {
+                cacheStream.Read(&vData[0],nSize);
+                return true;
+            }
+        }
+        catch (...) {}
+        ResetCache();
+    }
+
+    string pathFile;
+    if (!GetFilePath(nFile,pathFile))
+    {
+        return false;
+    }
+    try
+    {
+        walleve::CWalleveFileStream fs(pathFile.c_str());
+        uint32 nRecordSize = 0;
+        fs.Seek(nOffset - sizeof(uint32));
+        fs >> nRecordSize;
+        if (fs.IsEOF() || nSize > nRecordSize)
+        {
+            return false;
+        }
+        fs.Read(&vData[0],nSize);
+        return (!fs.IsEOF());
+    }
+    catch (...) {}
+    return false;
+}
+
 void CTimeSeries::ResetCache()
 {
     cacheStream.Clear();
     mapCachePos.clear(); 
 }
 
+bool CTimeSeries::WriteToCache(const char* pData,uint32 nSize,const CDiskPos& diskpos)
+{
+    if (mapCachePos.count(diskpos))
+    {
+        return true;
+    }
+    if (!VacateCache(nSize))
+    {
+        return false;
+    }
+    try
+    {
+        std::size_t nPos;
+        cacheStream << diskpos << nSize;
+        nPos = cacheStream.GetWritePos();
+        cacheStream.Write(pData,nSize);
+        mapCachePos.insert(make_pair(diskpos,make_pair(nPos,nSize)));
+        return true;
+    }
+    catch (...) {}
+    return false;
+}
+
 bool CTimeSeries::VacateCache(uint32 nNeeded)
 {
     const size_t nHdrSize = 12;
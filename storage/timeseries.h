@@ -60,20 +60,23 @@ public:
         {
             return false;
         }
+        // Serialize once into an exact sized buffer, shared by the file and the cache
+        walleve::CWalleveVectorStream ss(walleve::GetSerializeSize(t));
         try
         {
+            ss << t;
+            uint32 nSize = ss.GetSize();
             walleve::CWalleveFileStream fs(pathFile.c_str());
             fs.SeekToEnd();
-            uint32 nSize = fs.GetSerializeSize(t);
             fs << nMagicNum << nSize;
             nOffset = fs.GetCurPos();
-            fs << t;
+            fs.Write(ss.GetData(),nSize);
         }
         catch (...) 
         {
             return false;
         }
-        if (!WriteToCache(t,CDiskPos(nFile,nOffset)))
+        if (!WriteToCache(ss.GetData(),ss.GetSize(),CDiskPos(nFile,nOffset)))
         {
             ResetCache();
         }
@@ -81,6 +84,13 @@ public:
     }
     template <typename T>
     bool Read(T& t,uint32 nFile,uint32 nOffset)
+    {
+        return ReadHead(t,nFile,nOffset,MAX_FILE_SIZE);
+    }
+    // Decode t from at most nMaxSize leading bytes of the record, for types loading only its head.
+    // Only whole records are put in the cache
+    template <typename T>
+    bool ReadHead(T& t,uint32 nFile,uint32 nOffset,uint32 nMaxSize)
     {
         boost::unique_lock<boost::mutex> lock(mtxFile);
 
@@ -96,22 +106,37 @@ public:
         }
         try
         {
-            // Open history file to read
+            // Open history file to read, load the whole record and decode it from memory
             walleve::CWalleveFileStream fs(pathFile.c_str());
-            fs.Seek(nOffset);
-            fs >> t;
+            uint32 nSize = 0;
+            fs.Seek(nOffset - sizeof(uint32));
+            fs >> nSize;
+            if (fs.IsEOF() || nSize > MAX_FILE_SIZE)
+            {
+                return false;
+            }
+            uint32 nRead = std::min(nSize,nMaxSize);
+            std::vector<char> vBuf(nRead);
+            fs.Read(&vBuf[0],nRead);
+            if (fs.IsEOF())
+            {
+                return false;
+            }
+            walleve::CWalleveSpanStream ss(&vBuf[0],nRead);
+            ss >> t;
+
+            if (nRead == nSize && !WriteToCache(&vBuf[0],nSize,CDiskPos(nFile,nOffset)))
+            {
+                ResetCache();
+            }
         }
         catch(...)
         {
             return false;
         }
-
-        if (!WriteToCache(t,CDiskPos(nFile,nOffset)))
-        {
-            ResetCache();
-        }
         return true;
     }
+    bool ReadRaw(std::vector<char>& vData,uint32 nFile,uint32 nOffset,uint32 nSize);
     template <typename T>
     bool WalkThrough(CTSWalker<T>& walker,uint32& nLastFile,uint32& nLastPos)
     {
@@ -162,45 +187,32 @@ protected:
     bool GetLastFilePath(uint32& nFile,std::string& strPath);
     void ResetCache();
     bool VacateCache(uint32 nNeeded);
-    template <typename T>
-    bool WriteToCache(const T& t,const CDiskPos& diskpos)
-    {
-        if (mapCachePos.count(diskpos))
-        {
-            return true;
-        }
-        uint32 nSize = cacheStream.GetSerializeSize(t);
-        if (!VacateCache(nSize))
-        {
-            return false;
-        }
-        try
-        {
-            std::size_t nPos;
-            cacheStream << diskpos << nSize;
-            nPos = cacheStream.GetWritePos();
-            cacheStream << t;
-            mapCachePos.insert(std::make_pair(diskpos,nPos));
-            return true;
-        }
-        catch (...) {}
-        return false;
-    }
+    bool WriteToCache(const char* pData,uint32 nSize,const CDiskPos& diskpos);
     template <typename T>
     bool ReadFromCache(T& t,const CDiskPos& diskpos)
     {
-        std::map<CDiskPos,size_t>::iterator it = mapCachePos.find(diskpos);
+        std::map<CDiskPos,std::pair<std::size_t,uint32> >::iterator it = mapCachePos.find(diskpos);
         if (it != mapCachePos.end())
         {
-            if (cacheStream.Seek((*it).second))
+            std::size_t nPos = (*it).second.first;
+            uint32 nSize = (*it).second.second;
+            try
             {
-                try
+                // Decode in place unless the record wraps around the end of the buffer
+                const char* pData = cacheStream.GetData(nPos,nSize);
+                if (pData != NULL)
+                {
+                    walleve::CWalleveSpanStream ss(pData,nSize);
+                    ss >> t;
+                    return true;
+                }
+                if (cacheStream.Seek(nPos))
                 {
                     cacheStream >> t;
                     return true;
                 }
-                catch (...) {}
             }
+            catch (...) {}
             ResetCache();
         }
         return false;
@@ -212,7 +224,7 @@ protected:
     std::string strPrefix;
     uint32 nLastFile;
     walleve::CWalleveCircularStream cacheStream;
-    std::map<CDiskPos,std::size_t> mapCachePos;
+    std::map<CDiskPos,std::pair<std::size_t,uint32> > mapCachePos;
     static const uint32 nMagicNum;
 };
 
@@ -0,0 +1,252 @@
+// Copyright (c) 2017-2018 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "core.h"
+
+#include <iostream>
+#include <map>
+#include <vector>
+
+using namespace std;
+using namespace multiverse;
+
+// Blocks connected with the signature checks of assumed-valid ancestors skipped
+// must leave the same unspent set as full validation, and only those blocks skip
+
+static const int BLOCK_COUNT = 24;
+static const int BLOCK_TX_COUNT = 40;
+
+class CTestChain
+{
+public:
+    CTestChain()
+    {
+        key.Renew();
+        dest = CDestination(key.GetPubKey());
+        keyOther.Renew();
+
+        txMint.nType = CTransaction::TX_WORK;
+        txMint.sendTo = dest;
+        txMint.nAmount = 1000000 * COIN;
+
+        vIndex.resize(BLOCK_COUNT + 1);
+        vIndex[0].nHeight = 0;
+        vector<CTxOutPoint> vUnspent;
+        vUnspent.push_back(CTxOutPoint(txMint.GetHash(),0));
+        map<CTxOutPoint,int64> mapValue;
+        mapValue[vUnspent[0]] = txMint.nAmount;
+
+        // every tx splits one output of dest in two, so later blocks spend earlier ones
+        uint256 hashPrev = 0;
+        for (int h = 1;h <= BLOCK_COUNT;h++)
+        {
+            CBlock block;
+            block.nType = CBlock::BLOCK_PRIMARY;
+            block.nTimeStamp = 1500000000 + h * 60;
+            block.hashPrev = hashPrev;
+            vector<CTxOutPoint> vNext;
+            for (int i = 0;i < BLOCK_TX_COUNT && !vUnspent.empty();i++)
+            {
+                CTxOutPoint prevout = vUnspent.front();
+                vUnspent.erase(vUnspent.begin());
+                int64 nValueIn = mapValue[prevout];
+
+                CTransaction tx;
+                tx.vInput.push_back(CTxIn(prevout));
+                tx.sendTo = dest;
+                tx.nTxFee = 100;
+                tx.nAmount = (nValueIn - tx.nTxFee) / 2;
+                key.Sign(tx.GetSignatureHash(),tx.vchSig);
+                block.vtx.push_back(tx);
+
+                uint256 txid = tx.GetHash();
+                vNext.push_back(CTxOutPoint(txid,0));
+                vNext.push_back(CTxOutPoint(txid,1));
+                mapValue[CTxOutPoint(txid,0)] = tx.nAmount;
+                mapValue[CTxOutPoint(txid,1)] = nValueIn - tx.nAmount - tx.nTxFee;
+            }
+            vUnspent.insert(vUnspent.end(),vNext.begin(),vNext.end());
+            block.hashMerkle = block.CalcMerkleTreeRoot();
+            vBlock.push_back(block);
+            hashPrev = block.GetHash();
+            vIndex[h].nHeight = h;
+        }
+    }
+    // Connect the chain the way CWorldLine::AddNewBlock does, return the height of the first rejected block
+    int Connect(ICoreProtocol* pCore,const vector<CBlock>& vBlockIn,
+                map<CTxOutPoint,CTxOutput>& mapUnspent,bool fPrune)
+    {
+        storage::CBlockView view;
+        view.AddTx(txMint.GetHash(),txMint);
+        for (size_t n = 0;n < vBlockIn.size();n++)
+        {
+            CBlockEx blockex(vBlockIn[n]);
+            storage::CBlockView viewBlock(view);
+            BOOST_FOREACH(const CTransaction& tx,blockex.vtx)
+            {
+                CTxContxt txContxt;
+                BOOST_FOREACH(const CTxIn& txin,tx.vInput)
+                {
+                    CTxOutput output;
+                    if (!viewBlock.RetrieveUnspent(txin.prevout,output))
+                    {
+                        return (int)n + 1;
+                    }
+                    txContxt.destIn = output.destTo;
+                    txContxt.vInputValue.push_back(make_pair(output.nAmount,output.nLockUntil));
+                }
+                blockex.vTxContxt.push_back(txContxt);
+                viewBlock.AddTx(tx.GetHash(),tx,txContxt.destIn,txContxt.GetValueIn());
+            }
+            size_t nInvalidTx = 0;
+            if (pCore->VerifyBlockTx(blockex,&vIndex[n],nInvalidTx) != MV_OK)
+            {
+                return (int)n + 1;
+            }
+            view = viewBlock;
+            if (fPrune)
+            {
+                pCore->PruneAssumeValidBlock(vIndex[n + 1].nHeight);
+            }
+        }
+
+        vector<CTxUnspent> vAddNew;
+        vector<CTxOutPoint> vRemove;
+        view.GetUnspentChanges(vAddNew,vRemove);
+        mapUnspent.clear();
+        BOOST_FOREACH(const CTxUnspent& unspent,vAddNew)
+        {
+            mapUnspent[unspent] = unspent.output;
+        }
+        return 0;
+    }
+    void AssumeValid(ICoreProtocol* pCore,int nHeight)
+    {
+        vector<pair<int,uint256> > vAssume;
+        for (int h = nHeight;h >= 1;h--)
+        {
+            vAssume.push_back(make_pair(h,vBlock[h - 1].GetHash()));
+        }
+        pCore->AddAssumeValidBlock(vAssume);
+    }
+    // Re-sign a tx of the block with another key, the block hash changes with its merkle root,
+    // blocks above are not connectable any more
+    vector<CBlock> BadSignatureAt(int nHeight)
+    {
+        vector<CBlock> vBad(vBlock.begin(),vBlock.begin() + nHeight);
+        CBlock& block = vBad.back();
+        CTransaction& tx = block.vtx[block.vtx.size() / 2];
+        keyOther.Sign(tx.GetSignatureHash(),tx.vchSig);
+        tx.InvalidateHash();
+        block.hashMerkle = block.CalcMerkleTreeRoot();
+        block.InvalidateHash();
+        return vBad;
+    }
+public:
+    crypto::CKey key;
+    crypto::CKey keyOther;
+    CDestination dest;
+    CTransaction txMint;
+    vector<CBlock> vBlock;
+    vector<CBlockIndex> vIndex;
+};
+
+static bool SameUnspent(const map<CTxOutPoint,CTxOutput>& a,const map<CTxOutPoint,CTxOutput>& b)
+{
+    if (a.size() != b.size())
+    {
+        return false;
+    }
+    map<CTxOutPoint,CTxOutput>::const_iterator ia = a.begin(),ib = b.begin();
+    for (;ia != a.end();++ia,++ib)
+    {
+        if (!((*ia).first == (*ib).first) || (*ia).second.destTo != (*ib).second.destTo
+            || (*ia).second.nAmount != (*ib).second.nAmount || (*ia).second.nLockUntil != (*ib).second.nLockUntil)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    CTestChain chain;
+    int nFailed = 0;
+
+    // full validation
+    map<CTxOutPoint,CTxOutput> mapFull;
+    {
+        CMvCoreProtocol core;
+        if (chain.Connect(&core,chain.vBlock,mapFull,false) != 0 || mapFull.empty())
+        {
+            cerr << "full validation rejected the chain\n";
+            nFailed++;
+        }
+    }
+
+    // whole chain assumed valid
+    {
+        CMvCoreProtocol core;
+        chain.AssumeValid(&core,BLOCK_COUNT);
+        map<CTxOutPoint,CTxOutput> mapAssume;
+        if (chain.Connect(&core,chain.vBlock,mapAssume,true) != 0 || !SameUnspent(mapFull,mapAssume))
+        {
+            cerr << "unspent set differs with assumed-valid blocks\n";
+            nFailed++;
+        }
+    }
+
+    // a bad signature above the assumed-valid block is still found
+    {
+        CMvCoreProtocol core;
+        chain.AssumeValid(&core,BLOCK_COUNT / 2);
+        map<CTxOutPoint,CTxOutput> mapAssume;
+        if (chain.Connect(&core,chain.BadSignatureAt(BLOCK_COUNT / 2 + 1),mapAssume,true) != BLOCK_COUNT / 2 + 1)
+        {
+            cerr << "bad signature above the assumed-valid block accepted\n";
+            nFailed++;
+        }
+    }
+
+    // a block with another hash at an assumed height is verified
+    {
+        CMvCoreProtocol core;
+        chain.AssumeValid(&core,BLOCK_COUNT);
+        map<CTxOutPoint,CTxOutput> mapAssume;
+        if (chain.Connect(&core,chain.BadSignatureAt(3),mapAssume,true) != 3)
+        {
+            cerr << "bad signature in a block off the assumed chain accepted\n";
+            nFailed++;
+        }
+    }
+
+    // an assumed-valid block is not verified, its entry is pruned once the height is connected
+    {
+        CMvCoreProtocol core;
+        vector<CBlock> vBad = chain.BadSignatureAt(5);
+        vector<pair<int,uint256> > vAssume(1,make_pair(5,vBad[4].GetHash()));
+        core.AddAssumeValidBlock(vAssume);
+        map<CTxOutPoint,CTxOutput> mapAssume;
+        if (chain.Connect(&core,vBad,mapAssume,false) != 0)
+        {
+            cerr << "assumed-valid block verified\n";
+            nFailed++;
+        }
+        core.PruneAssumeValidBlock(5);
+        if (chain.Connect(&core,vBad,mapAssume,false) != 5)
+        {
+            cerr << "assumed-valid entry not pruned\n";
+            nFailed++;
+        }
+    }
+
+    if (nFailed != 0)
+    {
+        cerr << nFailed << " assume valid case(s) failed\n";
+        return 1;
+    }
+    cout << "assume valid : ok\n";
+    return 0;
+}
@@ -0,0 +1,87 @@
+// Copyright (c) 2017-2018 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto.h"
+
+#include <iostream>
+#include <vector>
+#include <string.h>
+#include <sodium.h>
+
+using namespace std;
+using namespace multiverse::crypto;
+
+// CryptoHashMerkleLevel against crypto_generichash of every concatenated pair,
+// leaf counts cover empty, single, partial and full 4 lanes groups and odd tails
+
+static uint256 ReferencePairHash(const uint256& left,const uint256& right)
+{
+    unsigned char buf[64];
+    uint256 hash;
+    memcpy(buf,left.begin(),32);
+    memcpy(buf + 32,right.begin(),32);
+    crypto_generichash(hash.begin(),sizeof(hash),buf,sizeof(buf),NULL,0);
+    return hash;
+}
+
+static bool CheckLevel(size_t nChild)
+{
+    vector<uint256> vChild(nChild);
+    for (size_t i = 0;i < nChild;i++)
+    {
+        randombytes_buf(vChild[i].begin(),sizeof(uint256));
+    }
+
+    // one extra slot on each side catches writes out of the level
+    size_t nParent = (nChild + 1) / 2;
+    uint256 sentinel;
+    randombytes_buf(sentinel.begin(),sizeof(sentinel));
+    vector<uint256> vParent(nParent + 2,sentinel);
+
+    CryptoHashMerkleLevel(nChild != 0 ? &vChild[0] : NULL,nChild,&vParent[1]);
+
+    bool fOK = true;
+    if (vParent[0] != sentinel || vParent[nParent + 1] != sentinel)
+    {
+        cerr << "leaves " << nChild << " : write out of range\n";
+        fOK = false;
+    }
+    for (size_t i = 0;i < nParent;i++)
+    {
+        const uint256& right = vChild[min(i * 2 + 1,nChild - 1)];
+        if (vParent[i + 1] != ReferencePairHash(vChild[i * 2],right)
+            || vParent[i + 1] != CryptoHash(vChild[i * 2],right))
+        {
+            cerr << "leaves " << nChild << " : parent " << i << " mismatched\n";
+            fOK = false;
+        }
+    }
+    return fOK;
+}
+
+int main()
+{
+    if (sodium_init() < 0)
+    {
+        cerr << "sodium_init failed\n";
+        return 1;
+    }
+
+    static const size_t nLeaves[] = {0,1,2,3,4,5,6,7,8,9,10,15,16,17,31,33,64,101};
+    int nFailed = 0;
+    for (size_t i = 0;i < sizeof(nLeaves) / sizeof(nLeaves[0]);i++)
+    {
+        if (!CheckLevel(nLeaves[i]))
+        {
+            nFailed++;
+        }
+    }
+    if (nFailed != 0)
+    {
+        cerr << nFailed << " merkle level case(s) failed\n";
+        return 1;
+    }
+    cout << "merkle level : ok\n";
+    return 0;
+}
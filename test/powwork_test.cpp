@@ -0,0 +1,172 @@
+// Copyright (c) 2017-2018 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "block.h"
+
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+
+using namespace std;
+
+// Proof-of-work spacing cached by CBlockIndex::UpdateWork against the full walk
+// GetProofOfWorkTarget used to do, on a chain with mixed algos, stake blocks and forks
+
+static const int ALGO_COUNT = 2;
+
+static bool WalkWork(CBlockIndex* pIndexPrev,int nAlgo,CBlockIndex*& pLast,int64& nSpacing,int64& nWeight)
+{
+    CBlockIndex* pIndex = pIndexPrev;
+    while ((!pIndex->IsProofOfWork() || pIndex->nProofAlgo != nAlgo) && pIndex->pPrev != NULL)
+    {
+        pIndex = pIndex->pPrev;
+    }
+    if (!pIndex->IsProofOfWork())
+    {
+        return false;
+    }
+    pLast = pIndex;
+    nSpacing = 0;
+    nWeight = 0;
+    int nWIndex = CBlockIndex::WORK_ADJUST_COUNT - 1;
+    while (pIndex->IsProofOfWork())
+    {
+        nSpacing += (pIndex->GetBlockTime() - pIndex->pPrev->GetBlockTime()) << nWIndex;
+        nWeight += (1ULL) << nWIndex;
+        if (!nWIndex--)
+        {
+            break;
+        }
+        pIndex = pIndex->pPrev;
+        while ((!pIndex->IsProofOfWork() || pIndex->nProofAlgo != nAlgo) && pIndex->pPrev != NULL)
+        {
+            pIndex = pIndex->pPrev;
+        }
+    }
+    return true;
+}
+
+static CBlockIndex* NewIndex(vector<CBlockIndex*>& vIndex,CBlockIndex* pPrev)
+{
+    CBlockIndex* pIndex = new CBlockIndex();
+    vIndex.push_back(pIndex);
+    pIndex->pPrev = pPrev;
+    if (pPrev == NULL)
+    {
+        pIndex->nType = CBlock::BLOCK_GENESIS;
+        pIndex->nMintType = CTransaction::TX_GENESIS;
+        pIndex->nTimeStamp = 1500000000;
+    }
+    else
+    {
+        pIndex->nType = CBlock::BLOCK_PRIMARY;
+        pIndex->nHeight = pPrev->nHeight + 1;
+        pIndex->nTimeStamp = pPrev->nTimeStamp + 1 + rand() % 120;
+        // mostly work, runs of stake and of the other algo in between
+        if (rand() % 4 == 0)
+        {
+            pIndex->nMintType = CTransaction::TX_STAKE;
+        }
+        else
+        {
+            pIndex->nMintType = CTransaction::TX_WORK;
+            pIndex->nProofAlgo = 1 + (rand() % 5 == 0 ? 1 : 0);
+            pIndex->nProofBits = 16 + rand() % 8;
+        }
+    }
+    pIndex->UpdateWork();
+    return pIndex;
+}
+
+static bool CheckIndex(CBlockIndex* pIndex)
+{
+    bool fOK = true;
+    for (int nAlgo = 1;nAlgo <= ALGO_COUNT;nAlgo++)
+    {
+        CBlockIndex* pLast = NULL;
+        int64 nSpacing = 0,nWeight = 0;
+        bool fFound = WalkWork(pIndex,nAlgo,pLast,nSpacing,nWeight);
+        CBlockIndex* pWork = pIndex->GetLastWork(nAlgo);
+        if (!fFound)
+        {
+            if (pWork != NULL)
+            {
+                cerr << "height " << pIndex->nHeight << " algo " << nAlgo << " : unexpected last work\n";
+                fOK = false;
+            }
+            continue;
+        }
+        if (pWork != pLast)
+        {
+            cerr << "height " << pIndex->nHeight << " algo " << nAlgo << " : last work mismatched\n";
+            fOK = false;
+        }
+        else if (pWork->nWorkSpacing != nSpacing || pWork->nWorkWeight != nWeight
+                 || pWork->nProofBits != pLast->nProofBits)
+        {
+            cerr << "height " << pIndex->nHeight << " algo " << nAlgo << " : spacing "
+                 << pWork->nWorkSpacing << "/" << pWork->nWorkWeight << " expected "
+                 << nSpacing << "/" << nWeight << "\n";
+            fOK = false;
+        }
+    }
+    return fOK;
+}
+
+int main()
+{
+    srand(35);
+
+    vector<CBlockIndex*> vIndex;
+    vector<CBlockIndex*> vMain;
+    vMain.push_back(NewIndex(vIndex,NULL));
+    // leading stake blocks leave no work of either algo
+    for (int i = 0;i < 5;i++)
+    {
+        CBlockIndex* pIndex = NewIndex(vIndex,vMain.back());
+        pIndex->nMintType = CTransaction::TX_STAKE;
+        pIndex->nProofAlgo = 0;
+        pIndex->UpdateWork();
+        vMain.push_back(pIndex);
+    }
+    for (int i = 0;i < 500;i++)
+    {
+        vMain.push_back(NewIndex(vIndex,vMain.back()));
+    }
+
+    // forks share ancestors with the main chain, their own blocks must not leak into it
+    vector<CBlockIndex*> vFork;
+    for (int i = 0;i < 20;i++)
+    {
+        CBlockIndex* pIndex = vMain[rand() % vMain.size()];
+        for (int j = 0;j < 40;j++)
+        {
+            pIndex = NewIndex(vIndex,pIndex);
+            vFork.push_back(pIndex);
+        }
+    }
+
+    int nFailed = 0;
+    for (size_t i = 0;i < vMain.size();i++)
+    {
+        nFailed += (CheckIndex(vMain[i]) ? 0 : 1);
+    }
+    for (size_t i = 0;i < vFork.size();i++)
+    {
+        nFailed += (CheckIndex(vFork[i]) ? 0 : 1);
+    }
+
+    for (size_t i = 0;i < vIndex.size();i++)
+    {
+        delete vIndex[i];
+    }
+
+    if (nFailed != 0)
+    {
+        cerr << nFailed << " block index(es) failed\n";
+        return 1;
+    }
+    cout << "proof-of-work spacing : ok\n";
+    return 0;
+}
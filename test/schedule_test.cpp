@@ -0,0 +1,206 @@
+// Copyright (c) 2017-2018 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "schedule.h"
+
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+
+using namespace std;
+using namespace multiverse;
+
+// CSchedule under a tx inv flood : every peer announces MAX_PEER_TX_INV_COUNT txs,
+// then invs and peers go away. Inv states and peer slots must be released with them
+
+static const int PEER_COUNT = 64;
+static const size_t TX_POOL_SIZE = 64 * 1024;
+
+class CTestSchedule : public CSchedule
+{
+public:
+    static size_t GetMaxPeerTxInv() { return MAX_PEER_TX_INV_COUNT; }
+    size_t GetStateCount() const { return mapState.size(); }
+    size_t GetPeerCount() const { return mapPeer.size(); }
+    size_t GetSlotCount() const { return vSlotPeer.size(); }
+    size_t GetFreeSlotCount() const { return vFreeSlot.size(); }
+    // known peer bits, known lists, assignments and the slot table must agree
+    bool CheckConsistency()
+    {
+        bool fOK = true;
+        size_t nKnown = 0;
+        for (CInvStateMap::iterator it = mapState.begin();it != mapState.end();++it)
+        {
+            const network::CInv& inv = (*it).first;
+            const boost::dynamic_bitset<>& bs = (*it).second.bsKnownPeer;
+            if (bs.none())
+            {
+                fOK = Fail("inv state without known peer");
+            }
+            for (size_t i = bs.find_first();i != bs.npos;i = bs.find_next(i))
+            {
+                map<uint64,CInvPeer>::iterator mi;
+                if (i >= vSlotPeer.size() || vSlotPeer[i] == 0
+                    || (mi = mapPeer.find(vSlotPeer[i])) == mapPeer.end())
+                {
+                    fOK = Fail("known peer bit of a free slot");
+                    continue;
+                }
+                if (!(*mi).second.GetKnownList(inv.nType).get<1>().count(inv.nHash))
+                {
+                    fOK = Fail("known peer bit without known inv");
+                }
+                nKnown++;
+            }
+            uint64 nAssigned = (*it).second.nAssigned;
+            if (nAssigned != 0 && (!mapPeer.count(nAssigned) || !mapPeer[nAssigned].GetAssigned(inv.nType).count(inv.nHash))
+                && !(*it).second.IsReceived())
+            {
+                fOK = Fail("assigned to an unknown peer");
+            }
+        }
+        size_t nListed = 0;
+        for (map<uint64,CInvPeer>::iterator it = mapPeer.begin();it != mapPeer.end();++it)
+        {
+            CInvPeer& peer = (*it).second;
+            if (peer.nSlot >= vSlotPeer.size() || vSlotPeer[peer.nSlot] != (*it).first)
+            {
+                fOK = Fail("peer not in its slot");
+            }
+            nListed += peer.GetCount(network::CInv::MSG_TX) + peer.GetCount(network::CInv::MSG_BLOCK);
+            if (peer.GetCount(network::CInv::MSG_TX) > MAX_PEER_TX_INV_COUNT)
+            {
+                fOK = Fail("peer over its tx inv limit");
+            }
+        }
+        if (nKnown != nListed)
+        {
+            fOK = Fail("known peer bits and known lists differ in size");
+        }
+        if (mapPeer.size() + vFreeSlot.size() != vSlotPeer.size())
+        {
+            fOK = Fail("slots leaked");
+        }
+        for (size_t i = 0;i < vFreeSlot.size();i++)
+        {
+            if (vSlotPeer[vFreeSlot[i]] != 0)
+            {
+                fOK = Fail("free slot in use");
+            }
+        }
+        return fOK;
+    }
+protected:
+    bool Fail(const char* pszWhat)
+    {
+        cerr << pszWhat << "\n";
+        return false;
+    }
+};
+
+static uint256 TxHash(size_t n)
+{
+    return uint256((uint64)(n + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+static uint64 PeerNonce(int nPeer,int nRound)
+{
+    return ((uint64)(nRound + 1) << 32) | (uint64)(nPeer + 1);
+}
+
+static void Flood(CTestSchedule& sched,int nRound)
+{
+    // every peer announces more than its limit, mostly txs also known by other peers
+    for (int i = 0;i < PEER_COUNT;i++)
+    {
+        size_t nStart = rand() % TX_POOL_SIZE;
+        for (size_t n = 0;n < CTestSchedule::GetMaxPeerTxInv() + 100;n++)
+        {
+            sched.AddNewInv(network::CInv(network::CInv::MSG_TX,TxHash((nStart + n) % TX_POOL_SIZE)),
+                            PeerNonce(i,nRound));
+        }
+    }
+}
+
+static void Consume(CTestSchedule& sched,int nRound)
+{
+    // a share of the txs is fetched, received and accepted, the others stay known
+    for (int i = 0;i < PEER_COUNT;i += 3)
+    {
+        uint64 nNonce = PeerNonce(i,nRound);
+        vector<network::CInv> vInv;
+        sched.ScheduleTxInv(nNonce,vInv,256);
+        BOOST_FOREACH(const network::CInv& inv,vInv)
+        {
+            set<uint64> setSchedPeer,setKnownPeer;
+            CTransaction tx;
+            if (sched.ReceiveTx(nNonce,inv.nHash,tx,setSchedPeer))
+            {
+                sched.RemoveInv(inv,setKnownPeer);
+            }
+        }
+    }
+}
+
+int main()
+{
+    srand(45);
+
+    CTestSchedule sched;
+    int nFailed = 0;
+    // time spent in the schedule itself, consistency checks excluded
+    int64 nElapsed = 0;
+    for (int nRound = 0;nRound < 3;nRound++)
+    {
+        int64 nStart = walleve::GetTimeMillis();
+        Flood(sched,nRound);
+        nElapsed += walleve::GetTimeMillis() - nStart;
+        nFailed += (sched.CheckConsistency() ? 0 : 1);
+        if (sched.GetPeerCount() != (size_t)PEER_COUNT || sched.GetStateCount() == 0)
+        {
+            cerr << "round " << nRound << " : " << sched.GetPeerCount() << " peers, "
+                 << sched.GetStateCount() << " inv states\n";
+            nFailed++;
+        }
+
+        nStart = walleve::GetTimeMillis();
+        Consume(sched,nRound);
+        nElapsed += walleve::GetTimeMillis() - nStart;
+        nFailed += (sched.CheckConsistency() ? 0 : 1);
+
+        // peers of this round leave, the next round takes their slots
+        for (int i = 0;i < PEER_COUNT;i++)
+        {
+            set<uint64> setSchedPeer;
+            nStart = walleve::GetTimeMillis();
+            sched.RemovePeer(PeerNonce(i,nRound),setSchedPeer);
+            nElapsed += walleve::GetTimeMillis() - nStart;
+            if (i % 16 == 0)
+            {
+                nFailed += (sched.CheckConsistency() ? 0 : 1);
+            }
+        }
+        if (sched.GetStateCount() != 0 || sched.GetPeerCount() != 0)
+        {
+            cerr << "round " << nRound << " : " << sched.GetStateCount() << " inv states and "
+                 << sched.GetPeerCount() << " peers left\n";
+            nFailed++;
+        }
+        if (sched.GetSlotCount() != (size_t)PEER_COUNT || sched.GetFreeSlotCount() != (size_t)PEER_COUNT)
+        {
+            cerr << "round " << nRound << " : " << sched.GetSlotCount() << " slots, "
+                 << sched.GetFreeSlotCount() << " free\n";
+            nFailed++;
+        }
+    }
+
+    if (nFailed != 0)
+    {
+        cerr << nFailed << " schedule check(s) failed\n";
+        return 1;
+    }
+    cout << "schedule tx flood : ok (" << 3 * PEER_COUNT * (CTestSchedule::GetMaxPeerTxInv() + 100)
+         << " invs in " << nElapsed << " ms)\n";
+    return 0;
+}
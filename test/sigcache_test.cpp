@@ -0,0 +1,121 @@
+// Copyright (c) 2017-2018 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "sigcache.h"
+#include "crypto.h"
+
+#include <iostream>
+#include <vector>
+
+using namespace std;
+using namespace multiverse::crypto;
+
+// CSignatureCache filled well past nMaxCount must stay bounded and keep
+// the latest half of its capacity, whatever the salted hashes of the entries
+
+static const size_t MAX_COUNT = 1000;
+static const size_t INSERT_COUNT = MAX_COUNT * 10 + 7;
+
+class CTestSig
+{
+public:
+    CTestSig()
+    {
+        CryptoGetRand256(hash);
+        uint256 key;
+        CryptoGetRand256(key);
+        dest = CDestination(CPubKey(key));
+        uint256 r,s;
+        CryptoGetRand256(r);
+        CryptoGetRand256(s);
+        vchSig.assign(r.begin(),r.end());
+        vchSig.insert(vchSig.end(),s.begin(),s.end());
+    }
+public:
+    uint256 hash;
+    CDestination dest;
+    vector<unsigned char> vchSig;
+};
+
+int main()
+{
+    CSignatureCache sigCache(MAX_COUNT);
+    vector<CTestSig> vSig(INSERT_COUNT);
+
+    int nFailed = 0;
+    for (size_t i = 0;i < vSig.size();i++)
+    {
+        sigCache.AddNew(vSig[i].hash,vSig[i].dest,vSig[i].vchSig);
+
+        // the latest entries survive every eviction
+        size_t nRecent = min(i + 1,MAX_COUNT / 2);
+        for (size_t k = i + 1 - nRecent;k <= i;k += 97)
+        {
+            if (!sigCache.Exists(vSig[k].hash,vSig[k].dest,vSig[k].vchSig))
+            {
+                cerr << "insert " << i << " : entry " << k << " evicted\n";
+                nFailed++;
+                break;
+            }
+        }
+
+        CSignatureCacheStatus status;
+        sigCache.GetStatus(status);
+        if (status.nCount > MAX_COUNT)
+        {
+            cerr << "insert " << i << " : " << status.nCount << " entries over the limit\n";
+            nFailed++;
+        }
+    }
+
+    for (size_t i = INSERT_COUNT - MAX_COUNT / 2;i < INSERT_COUNT;i++)
+    {
+        if (!sigCache.Exists(vSig[i].hash,vSig[i].dest,vSig[i].vchSig))
+        {
+            cerr << "recent entry " << i << " evicted\n";
+            nFailed++;
+        }
+    }
+
+    // a re-added entry does not push others out
+    CSignatureCacheStatus status;
+    sigCache.GetStatus(status);
+    size_t nCount = status.nCount;
+    const CTestSig& sigLast = vSig.back();
+    sigCache.AddNew(sigLast.hash,sigLast.dest,sigLast.vchSig);
+    sigCache.GetStatus(status);
+    if (status.nCount != nCount)
+    {
+        cerr << "re-added entry changed the count\n";
+        nFailed++;
+    }
+
+    // the oldest entries are gone, so lookups miss
+    size_t nOld = 0;
+    for (size_t i = 0;i < MAX_COUNT;i++)
+    {
+        nOld += (sigCache.Exists(vSig[i].hash,vSig[i].dest,vSig[i].vchSig) ? 1 : 0);
+    }
+    if (nOld != 0)
+    {
+        cerr << nOld << " old entries not evicted\n";
+        nFailed++;
+    }
+
+    sigCache.Clear();
+    sigCache.GetStatus(status);
+    if (status.nCount != 0 || sigCache.Exists(sigLast.hash,sigLast.dest,sigLast.vchSig))
+    {
+        cerr << "entries left after clear\n";
+        nFailed++;
+    }
+
+    if (nFailed != 0)
+    {
+        cerr << nFailed << " signature cache case(s) failed\n";
+        return 1;
+    }
+    cout << "signature cache : ok\n";
+    return 0;
+}
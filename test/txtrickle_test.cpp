@@ -0,0 +1,256 @@
+// Copyright (c) 2017-2018 The Multiverse developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "netchn.h"
+
+#include <iostream>
+#include <map>
+#include <vector>
+#include <stdlib.h>
+
+using namespace std;
+using namespace multiverse;
+
+// Tx inv relay : announcing the whole pool to every peer on each admitted tx,
+// against queueing admitted txs per peer and trickling them by fee rate.
+// Both must announce every tx once to each peer, the trickle with far less work
+// and far fewer inv messages
+
+static const int PEER_COUNT = 8;
+static const size_t TX_COUNT = 2000;
+// admissions between two trickle ticks, a peer is flushed every few ticks
+static const size_t TICK_TX_COUNT = 10;
+static const int PEER_FLUSH_TICKS = 5;
+static const size_t MAX_TX_TRICKLE_COUNT = 1024;
+// serialized inv message : header, count and 36 bytes per inv
+static const size_t INV_MESSAGE_SIZE = 24 + 3;
+static const size_t INV_SIZE = 36;
+
+class CRelayStat
+{
+public:
+    CRelayStat() : nElapsed(0),nMessage(0),nInv(0),nDuplicated(0),fOrdered(true) {}
+    void Receive(int nPeer,const vector<network::CInv>& vInv,const map<uint256,int64>& mapFeeRate)
+    {
+        if (vInv.empty())
+        {
+            return;
+        }
+        nMessage++;
+        nInv += vInv.size();
+        for (size_t i = 0;i < vInv.size();i++)
+        {
+            if (!mapAnnounced[vInv[i].nHash].insert(nPeer).second)
+            {
+                nDuplicated++;
+            }
+            if (i > 0 && (*mapFeeRate.find(vInv[i - 1].nHash)).second < (*mapFeeRate.find(vInv[i].nHash)).second)
+            {
+                fOrdered = false;
+            }
+        }
+    }
+    size_t GetBytes() const { return nMessage * INV_MESSAGE_SIZE + nInv * INV_SIZE; }
+    size_t GetMissing(const vector<uint256>& vTx) const
+    {
+        size_t nMissing = 0;
+        BOOST_FOREACH(const uint256& txid,vTx)
+        {
+            map<uint256,set<int> >::const_iterator it = mapAnnounced.find(txid);
+            nMissing += PEER_COUNT - (it != mapAnnounced.end() ? (*it).second.size() : 0);
+        }
+        return nMissing;
+    }
+public:
+    int64 nElapsed;
+    size_t nMessage;
+    size_t nInv;
+    size_t nDuplicated;
+    bool fOrdered;
+    map<uint256,set<int> > mapAnnounced;
+};
+
+static uint256 TxHash(size_t n)
+{
+    return uint256((uint64)(n + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+static void RelayFullPool(const uint256& hashFork,const vector<uint256>& vTx,
+                          const map<uint256,int64>& mapFeeRate,CRelayStat& stat)
+{
+    vector<CNetChannelPeer> vPeer(PEER_COUNT,CNetChannelPeer(0,hashFork));
+    vector<uint256> vTxPool;
+    for (size_t n = 0;n < vTx.size();n++)
+    {
+        vTxPool.push_back(vTx[n]);
+        for (int i = 0;i < PEER_COUNT;i++)
+        {
+            vector<network::CInv> vInv;
+            int64 nStart = walleve::GetTimeMillis();
+            vPeer[i].MakeTxInv(hashFork,vTxPool,vInv,network::CInv::MAX_INV_COUNT);
+            stat.nElapsed += walleve::GetTimeMillis() - nStart;
+            stat.Receive(i,vInv,mapFeeRate);
+        }
+    }
+}
+
+static void Flush(vector<CNetChannelPeer>& vPeer,const uint256& hashFork,int nTick,
+                  const map<uint256,int64>& mapFeeRate,CRelayStat& stat,bool fAll)
+{
+    for (int i = 0;i < PEER_COUNT;i++)
+    {
+        if (fAll || (nTick + i) % PEER_FLUSH_TICKS == 0)
+        {
+            vector<network::CInv> vInv;
+            int64 nStart = walleve::GetTimeMillis();
+            vPeer[i].MakePendingTxInv(hashFork,vInv,MAX_TX_TRICKLE_COUNT);
+            stat.nElapsed += walleve::GetTimeMillis() - nStart;
+            stat.Receive(i,vInv,mapFeeRate);
+        }
+    }
+}
+
+static void RelayTrickle(const uint256& hashFork,const vector<uint256>& vTx,
+                         const map<uint256,int64>& mapFeeRate,CRelayStat& stat)
+{
+    vector<CNetChannelPeer> vPeer(PEER_COUNT,CNetChannelPeer(0,hashFork));
+    int nTick = 0;
+    for (size_t n = 0;n < vTx.size();n++)
+    {
+        vector<pair<uint256,int64> > vTxFeeRate(1,make_pair(vTx[n],(*mapFeeRate.find(vTx[n])).second));
+        int64 nStart = walleve::GetTimeMillis();
+        for (int i = 0;i < PEER_COUNT;i++)
+        {
+            vPeer[i].AddPendingTx(hashFork,vTxFeeRate);
+        }
+        stat.nElapsed += walleve::GetTimeMillis() - nStart;
+        if ((n + 1) % TICK_TX_COUNT == 0)
+        {
+            Flush(vPeer,hashFork,nTick++,mapFeeRate,stat,false);
+        }
+    }
+    Flush(vPeer,hashFork,nTick,mapFeeRate,stat,true);
+}
+
+static int CheckQueue(const uint256& hashFork)
+{
+    int nFailed = 0;
+    CNetChannelPeer peer(0,hashFork);
+
+    // a tx learned from the peer is not announced back
+    vector<uint256> vKnown(1,TxHash(0));
+    peer.AddKnownTx(hashFork,vKnown);
+    vector<pair<uint256,int64> > vTxFeeRate(1,make_pair(TxHash(0),(int64)1000));
+    peer.AddPendingTx(hashFork,vTxFeeRate);
+    vector<network::CInv> vInv;
+    peer.MakePendingTxInv(hashFork,vInv,MAX_TX_TRICKLE_COUNT);
+    if (!vInv.empty())
+    {
+        cerr << "known tx announced\n";
+        nFailed++;
+    }
+
+    // a peer that is never flushed keeps the highest fee rate txs, up to the cap
+    size_t nMaxCount = 1024 * 8;
+    vTxFeeRate.clear();
+    for (size_t n = 1;n <= nMaxCount * 3;n++)
+    {
+        vTxFeeRate.push_back(make_pair(TxHash(n),(int64)n));
+    }
+    peer.AddPendingTx(hashFork,vTxFeeRate);
+    const set<pair<int64,uint256> >& setPending = (*peer.mapSubscribedFork.find(hashFork)).second.setPendingTx;
+    if (setPending.size() != nMaxCount || (*setPending.begin()).first != (int64)(nMaxCount * 2 + 1))
+    {
+        cerr << setPending.size() << " pending txs kept, lowest fee rate "
+             << (setPending.empty() ? 0 : (*setPending.begin()).first) << "\n";
+        nFailed++;
+    }
+
+    // a flush never exceeds its limit, and drains the queue
+    size_t nFlushed = 0;
+    while (!setPending.empty())
+    {
+        vInv.clear();
+        peer.MakePendingTxInv(hashFork,vInv,MAX_TX_TRICKLE_COUNT);
+        if (vInv.empty() || vInv.size() > MAX_TX_TRICKLE_COUNT)
+        {
+            cerr << vInv.size() << " invs in one flush\n";
+            nFailed++;
+            break;
+        }
+        nFlushed += vInv.size();
+    }
+    if (nFlushed != nMaxCount)
+    {
+        cerr << nFlushed << " pending txs flushed\n";
+        nFailed++;
+    }
+
+    // txs of a fork the peer has not subscribed are ignored
+    uint256 hashOther = TxHash(nMaxCount * 4);
+    peer.AddPendingTx(hashOther,vTxFeeRate);
+    vInv.clear();
+    peer.MakePendingTxInv(hashOther,vInv,MAX_TX_TRICKLE_COUNT);
+    if (!vInv.empty() || peer.IsSubscribed(hashOther))
+    {
+        cerr << "txs of an unsubscribed fork announced\n";
+        nFailed++;
+    }
+    return nFailed;
+}
+
+int main()
+{
+    srand(48);
+
+    uint256 hashFork = TxHash(1000000);
+    vector<uint256> vTx;
+    map<uint256,int64> mapFeeRate;
+    for (size_t n = 0;n < TX_COUNT;n++)
+    {
+        vTx.push_back(TxHash(n));
+        mapFeeRate[vTx.back()] = rand() % 100000;
+    }
+
+    int nFailed = CheckQueue(hashFork);
+
+    CRelayStat statFull,statTrickle;
+    RelayFullPool(hashFork,vTx,mapFeeRate,statFull);
+    RelayTrickle(hashFork,vTx,mapFeeRate,statTrickle);
+
+    if (statFull.GetMissing(vTx) != 0 || statTrickle.GetMissing(vTx) != 0)
+    {
+        cerr << "missed announcements : full pool " << statFull.GetMissing(vTx)
+             << ", trickle " << statTrickle.GetMissing(vTx) << "\n";
+        nFailed++;
+    }
+    if (statFull.nDuplicated != 0 || statTrickle.nDuplicated != 0)
+    {
+        cerr << "duplicated announcements : full pool " << statFull.nDuplicated
+             << ", trickle " << statTrickle.nDuplicated << "\n";
+        nFailed++;
+    }
+    if (!statTrickle.fOrdered)
+    {
+        cerr << "trickled invs not ordered by fee rate\n";
+        nFailed++;
+    }
+    if (statTrickle.nMessage * 5 > statFull.nMessage || statTrickle.GetBytes() >= statFull.GetBytes())
+    {
+        cerr << "trickle sent " << statTrickle.nMessage << " messages, full pool " << statFull.nMessage << "\n";
+        nFailed++;
+    }
+
+    if (nFailed != 0)
+    {
+        cerr << nFailed << " tx trickle check(s) failed\n";
+        return 1;
+    }
+    cout << "tx trickle : ok (" << PEER_COUNT << " peers, " << TX_COUNT << " txs)\n"
+         << "  full pool : " << statFull.nElapsed << " ms, " << statFull.nMessage << " messages, "
+         << statFull.GetBytes() << " bytes\n"
+         << "  trickle   : " << statTrickle.nElapsed << " ms, " << statTrickle.nMessage << " messages, "
+         << statTrickle.GetBytes() << " bytes\n";
+    return 0;
+}
@@ -14,11 +14,13 @@ using namespace walleve;
 // IWalleveBase
 
 IWalleveBase::IWalleveBase()
+: pWalleveDocker(NULL)
 {
     walleveStatus = WALLEVE_STATUS_OUTDOCKER;
 }
 
 IWalleveBase::IWalleveBase(const string& walleveOwnKeyIn)
+: pWalleveDocker(NULL)
 {
     walleveStatus = WALLEVE_STATUS_OUTDOCKER;
     walleveOwnKey = walleveOwnKeyIn;
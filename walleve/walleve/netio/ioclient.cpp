@@ -14,10 +14,12 @@ using boost::asio::ip::tcp;
 
 ///////////////////////////////
 // CIOClient
-CIOClient::CIOClient(CIOContainer *pContainerIn)
-: pContainer(pContainerIn)
+CIOClient::CIOClient(CIOContainer *pContainerIn,boost::asio::io_service& ioservice)
+: pContainer(pContainerIn), ioStrand(ioservice)
 {
     nRefCount = 0;
+    fStrand = false;
+    fOpen = false;
 }
 
 CIOClient::~CIOClient()
@@ -26,7 +28,7 @@ CIOClient::~CIOClient()
 
 const tcp::endpoint CIOClient::GetRemote()
 {
-    if (epRemote == tcp::endpoint())
+    if (epRemote == tcp::endpoint() && !fStrand)
     {
         try
         {
@@ -41,21 +43,25 @@ const tcp::endpoint CIOClient::GetRemote()
 
 const tcp::endpoint CIOClient::GetLocal()
 {
-    try
-    {
-        return SocketGetLocal();
-    }
-    catch (...)
+    if (!fStrand)
     {
+        try
+        {
+            epLocal = SocketGetLocal();
+        }
+        catch (...)
+        {
+            epLocal = tcp::endpoint();
+        }
     }
-    return (tcp::endpoint());
+    return epLocal;
 }
 
 void CIOClient::Close()
 {
-    if (IsSocketOpen())
+    if (IsOpen())
     {
-        CloseSocket();
+        CloseConnection();
         epRemote = tcp::endpoint();
         Release();
     }
@@ -71,55 +77,138 @@ void CIOClient::Release()
 
 void CIOClient::Shutdown()
 {
-    CloseSocket();
+    CloseConnection();
     epRemote = tcp::endpoint();
 }
 
 void CIOClient::Accept(tcp::acceptor& acceptor,CallBackConn fnAccepted)
 {
+    fStrand = false;
     ++nRefCount;
     AsyncAccept(acceptor,fnAccepted);
 }
 
 void CIOClient::Connect(const tcp::endpoint& epRemote,CallBackConn fnConnected)
 {
+    fStrand = false;
     ++nRefCount;
     AsyncConnect(epRemote,fnConnected);
 }
 
 void CIOClient::Read(CWalleveBufStream& ssRecv,size_t nLength,CallBackFunc fnCompleted)
 {
+    EnterStrand();
     ++nRefCount;
-    AsyncRead(ssRecv,nLength,fnCompleted);
+    CallBackIO fnIO = boost::bind(&CIOClient::HandleIOCompleted,this,fnCompleted,
+                                  boost::asio::placeholders::error,
+                                  boost::asio::placeholders::bytes_transferred);
+    ioStrand.dispatch(boost::bind(&CIOClient::AsyncRead,this,boost::ref(ssRecv),nLength,fnIO));
+}
+
+/* fnFrame runs on ioStrand after every read and gives the length of the next part,
+   the owner's strand only gets fnCompleted once the whole frame is in */
+void CIOClient::ReadFrame(CWalleveBufStream& ssRecv,size_t nLength,CallBackFrame fnFrame,CallBackFunc fnCompleted)
+{
+    EnterStrand();
+    ++nRefCount;
+    CallBackIO fnIO = boost::bind(&CIOClient::HandleFrameCompleted,this,boost::ref(ssRecv),fnFrame,fnCompleted,0,
+                                  boost::asio::placeholders::error,
+                                  boost::asio::placeholders::bytes_transferred);
+    ioStrand.dispatch(boost::bind(&CIOClient::AsyncRead,this,boost::ref(ssRecv),nLength,fnIO));
 }
 
 void CIOClient::ReadUntil(CWalleveBufStream& ssRecv,const string& delim,CallBackFunc fnCompleted)
 {
+    EnterStrand();
     ++nRefCount;
-    AsyncReadUntil(ssRecv,delim,fnCompleted);
+    ioStrand.dispatch(boost::bind(&CIOClient::AsyncReadUntil,this,boost::ref(ssRecv),delim,fnCompleted));
 }
 
 void CIOClient::Write(CWalleveBufStream& ssSend,CallBackFunc fnCompleted)
 {
+    EnterStrand();
     ++nRefCount;
-    AsyncWrite(ssSend,fnCompleted);
+    ioStrand.dispatch(boost::bind(&CIOClient::AsyncWrite,this,boost::ref(ssSend),fnCompleted));
+}
+
+bool CIOClient::IsOpen()
+{
+    return (fStrand ? fOpen : IsSocketOpen());
+}
+
+/* Accept and connect run on the owner's strand. From the first read or write on,
+   the socket belongs to ioStrand and the owner only keeps its view of it in fOpen */
+void CIOClient::EnterStrand()
+{
+    if (!fStrand)
+    {
+        GetRemote();
+        GetLocal();
+        fOpen = IsSocketOpen();
+        fStrand = true;
+    }
+}
+
+void CIOClient::CloseConnection()
+{
+    if (fStrand && pContainer->IsIoRunning())
+    {
+        fOpen = false;
+        ++nRefCount;
+        ioStrand.dispatch(boost::bind(&CIOClient::HandleClose,this));
+    }
+    else
+    {
+        fOpen = false;
+        CloseSocket();
+    }
+    epLocal = tcp::endpoint();
+}
+
+void CIOClient::HandleClose()
+{
+    CloseSocket();
+    pContainer->GetIoStrand().post(boost::bind(&CIOClient::Release,this));
+}
+
+void CIOClient::HandleIOCompleted(CallBackFunc fnCompleted,
+                                  const boost::system::error_code& err,size_t transferred)
+{
+    pContainer->GetIoStrand().post(boost::bind(&CIOClient::HandleCompleted,this,
+                                               fnCompleted,err,transferred));
 }
 
 void CIOClient::HandleCompleted(CallBackFunc fnCompleted,
                                 const boost::system::error_code& err,size_t transferred)
 {
-    if (err != boost::asio::error::operation_aborted && IsSocketOpen())
+    if (err != boost::asio::error::operation_aborted && IsOpen())
     {
         fnCompleted(!err ? transferred : 0);
     }
     Release();
 }
 
+void CIOClient::HandleFrameCompleted(CWalleveBufStream& ssRecv,CallBackFrame fnFrame,CallBackFunc fnCompleted,size_t nTotal,
+                                     const boost::system::error_code& err,size_t transferred)
+{
+    size_t nNext = 0;
+    if (!err && fnFrame(nNext) && nNext != 0)
+    {
+        CallBackIO fnIO = boost::bind(&CIOClient::HandleFrameCompleted,this,boost::ref(ssRecv),fnFrame,fnCompleted,
+                                      nTotal + transferred,
+                                      boost::asio::placeholders::error,
+                                      boost::asio::placeholders::bytes_transferred);
+        AsyncRead(ssRecv,nNext,fnIO);
+        return;
+    }
+    HandleIOCompleted(fnCompleted,err,nTotal + transferred);
+}
+
 void CIOClient::HandleConnCompleted(CallBackConn fnCompleted,const boost::system::error_code& err)
 {
-    fnCompleted(IsSocketOpen() ? err : boost::asio::error::operation_aborted);
+    fnCompleted(IsOpen() ? err : boost::asio::error::operation_aborted);
 
-    if (!IsSocketOpen() && nRefCount)
+    if (!IsOpen() && nRefCount)
     {
         Release();
     }
@@ -128,7 +217,7 @@ void CIOClient::HandleConnCompleted(CallBackConn fnCompleted,const boost::system
 ///////////////////////////////
 // CSocketClient
 CSocketClient::CSocketClient(CIOContainer *pContainerIn,boost::asio::io_service& ioservice)
-: CIOClient(pContainerIn), sockClient(ioservice)
+: CIOClient(pContainerIn,ioservice), sockClient(ioservice)
 {
 }
 
@@ -139,24 +228,24 @@ CSocketClient::~CSocketClient()
 
 void CSocketClient::AsyncAccept(tcp::acceptor& acceptor,CallBackConn fnAccepted)
 {
-    acceptor.async_accept(sockClient,boost::bind(&CSocketClient::HandleConnCompleted,this,
-                                                 fnAccepted,boost::asio::placeholders::error));
+    acceptor.async_accept(sockClient,
+                          pContainer->GetIoStrand().wrap(boost::bind(&CSocketClient::HandleConnCompleted,this,
+                                                                     fnAccepted,boost::asio::placeholders::error)));
 }
 
 void CSocketClient::AsyncConnect(const tcp::endpoint& epRemote,CallBackConn fnConnected)
 {
-    sockClient.async_connect(epRemote,boost::bind(&CSocketClient::HandleConnCompleted,this,
-                                                  fnConnected,boost::asio::placeholders::error));
+    sockClient.async_connect(epRemote,
+                             pContainer->GetIoStrand().wrap(boost::bind(&CSocketClient::HandleConnCompleted,this,
+                                                                        fnConnected,boost::asio::placeholders::error)));
 }
 
-void CSocketClient::AsyncRead(CWalleveBufStream& ssRecv,size_t nLength,CallBackFunc fnCompleted)
+void CSocketClient::AsyncRead(CWalleveBufStream& ssRecv,size_t nLength,CallBackIO fnIO)
 {
     boost::asio::async_read(sockClient, 
                             (boost::asio::streambuf&)ssRecv,
                             boost::asio::transfer_exactly(nLength),
-                            boost::bind(&CSocketClient::HandleCompleted,this,fnCompleted,
-                                        boost::asio::placeholders::error,
-                                        boost::asio::placeholders::bytes_transferred));
+                            ioStrand.wrap(fnIO));
 }
 
 void CSocketClient::AsyncReadUntil(CWalleveBufStream& ssRecv,const string& delim,CallBackFunc fnCompleted)
@@ -164,18 +253,18 @@ void CSocketClient::AsyncReadUntil(CWalleveBufStream& ssRecv,const string& delim
     boost::asio::async_read_until(sockClient, 
                                   (boost::asio::streambuf&)ssRecv,
                                   delim,
-                                  boost::bind(&CSocketClient::HandleCompleted,this,fnCompleted,
-                                              boost::asio::placeholders::error,
-                                              boost::asio::placeholders::bytes_transferred));
+                                  ioStrand.wrap(boost::bind(&CSocketClient::HandleIOCompleted,this,fnCompleted,
+                                                            boost::asio::placeholders::error,
+                                                            boost::asio::placeholders::bytes_transferred)));
 }
 
 void CSocketClient::AsyncWrite(CWalleveBufStream& ssSend,CallBackFunc fnCompleted)
 {
     boost::asio::async_write(sockClient, 
                              (boost::asio::streambuf&)ssSend,
-                             boost::bind(&CSocketClient::HandleCompleted,this,fnCompleted,
-                                         boost::asio::placeholders::error,
-                                         boost::asio::placeholders::bytes_transferred));
+                             ioStrand.wrap(boost::bind(&CSocketClient::HandleIOCompleted,this,fnCompleted,
+                                                       boost::asio::placeholders::error,
+                                                       boost::asio::placeholders::bytes_transferred)));
 }
 
 
@@ -204,7 +293,7 @@ bool CSocketClient::IsSocketOpen()
 CSSLClient::CSSLClient(CIOContainer *pContainerIn,boost::asio::io_service& ioserivce,
                                                   boost::asio::ssl::context& context,
                                                   const string& strVerifyHost)
-: CIOClient(pContainerIn), sslClient(ioserivce,context)
+: CIOClient(pContainerIn,ioserivce), sslClient(ioserivce,context)
 {
     if (!strVerifyHost.empty())
     {
@@ -222,27 +311,25 @@ CSSLClient::~CSSLClient()
 void CSSLClient::AsyncAccept(tcp::acceptor& acceptor,CallBackConn fnAccepted)
 {
     acceptor.async_accept(sslClient.lowest_layer(),
-                          boost::bind(&CSSLClient::HandleConnected,this,fnAccepted,
-                                      boost::asio::ssl::stream_base::server,
-                                      boost::asio::placeholders::error));
+                          pContainer->GetIoStrand().wrap(boost::bind(&CSSLClient::HandleConnected,this,fnAccepted,
+                                                                     boost::asio::ssl::stream_base::server,
+                                                                     boost::asio::placeholders::error)));
 }
 
 void CSSLClient::AsyncConnect(const tcp::endpoint& epRemote,CallBackConn fnConnected)
 {
     sslClient.lowest_layer().async_connect(epRemote,
-                                           boost::bind(&CSSLClient::HandleConnected,this,fnConnected,
-                                                       boost::asio::ssl::stream_base::client,
-                                                       boost::asio::placeholders::error));
+                                           pContainer->GetIoStrand().wrap(boost::bind(&CSSLClient::HandleConnected,this,fnConnected,
+                                                                                      boost::asio::ssl::stream_base::client,
+                                                                                      boost::asio::placeholders::error)));
 }
 
-void CSSLClient::AsyncRead(CWalleveBufStream& ssRecv,size_t nLength,CallBackFunc fnCompleted)
+void CSSLClient::AsyncRead(CWalleveBufStream& ssRecv,size_t nLength,CallBackIO fnIO)
 {
     boost::asio::async_read(sslClient, 
                             (boost::asio::streambuf&)ssRecv,
                             boost::asio::transfer_exactly(nLength),
-                            boost::bind(&CSSLClient::HandleCompleted,this,fnCompleted,
-                                        boost::asio::placeholders::error,
-                                        boost::asio::placeholders::bytes_transferred));
+                            ioStrand.wrap(fnIO));
 }
 
 void CSSLClient::AsyncReadUntil(CWalleveBufStream& ssRecv,const string& delim,CallBackFunc fnCompleted)
@@ -250,18 +337,18 @@ void CSSLClient::AsyncReadUntil(CWalleveBufStream& ssRecv,const string& delim,Ca
     boost::asio::async_read_until(sslClient, 
                                   (boost::asio::streambuf&)ssRecv,
                                   delim,
-                                  boost::bind(&CSSLClient::HandleCompleted,this,fnCompleted,
-                                              boost::asio::placeholders::error,
-                                              boost::asio::placeholders::bytes_transferred));
+                                  ioStrand.wrap(boost::bind(&CSSLClient::HandleIOCompleted,this,fnCompleted,
+                                                            boost::asio::placeholders::error,
+                                                            boost::asio::placeholders::bytes_transferred)));
 }
 
 void CSSLClient::AsyncWrite(CWalleveBufStream& ssSend,CallBackFunc fnCompleted)
 {
     boost::asio::async_write(sslClient, 
                              (boost::asio::streambuf&)ssSend,
-                             boost::bind(&CSSLClient::HandleCompleted,this,fnCompleted,
-                                         boost::asio::placeholders::error,
-                                         boost::asio::placeholders::bytes_transferred));
+                             ioStrand.wrap(boost::bind(&CSSLClient::HandleIOCompleted,this,fnCompleted,
+                                                       boost::asio::placeholders::error,
+                                                       boost::asio::placeholders::bytes_transferred)));
 }
 
 const tcp::endpoint CSSLClient::SocketGetRemote()
@@ -290,8 +377,8 @@ void CSSLClient::HandleConnected(CallBackConn fnHandshaked,
 {
     if (!err)
     {
-        sslClient.async_handshake(type,boost::bind(&CSSLClient::HandleConnCompleted,this,fnHandshaked,
-                                                   boost::asio::placeholders::error));
+        sslClient.async_handshake(type,pContainer->GetIoStrand().wrap(boost::bind(&CSSLClient::HandleConnCompleted,this,fnHandshaked,
+                                                                                  boost::asio::placeholders::error)));
     }
     else
     {
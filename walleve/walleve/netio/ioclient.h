@@ -22,8 +22,10 @@ class CIOClient
 public:
     typedef boost::function<void(std::size_t)> CallBackFunc;
     typedef boost::function<void(const boost::system::error_code&)> CallBackConn;
+    typedef boost::function<bool(std::size_t&)> CallBackFrame;
+    typedef boost::function<void(const boost::system::error_code&,std::size_t)> CallBackIO;
 
-    CIOClient(CIOContainer *pContainerIn);
+    CIOClient(CIOContainer *pContainerIn,boost::asio::io_service& ioservice);
     virtual ~CIOClient();
     const boost::asio::ip::tcp::endpoint GetRemote();
     const boost::asio::ip::tcp::endpoint GetLocal();
@@ -33,11 +35,20 @@ public:
     void Accept(boost::asio::ip::tcp::acceptor& acceptor,CallBackConn fnAccepted);
     void Connect(const boost::asio::ip::tcp::endpoint& epRemote,CallBackConn fnConnected);
     void Read(CWalleveBufStream& ssRecv,std::size_t nLength,CallBackFunc fnCompleted);
+    void ReadFrame(CWalleveBufStream& ssRecv,std::size_t nLength,CallBackFrame fnFrame,CallBackFunc fnCompleted);
     void ReadUntil(CWalleveBufStream& ssRecv,const std::string& delim,CallBackFunc fnCompleted);
     void Write(CWalleveBufStream& ssSend,CallBackFunc fnCompleted);
 protected:
+    bool IsOpen();
+    void EnterStrand();
+    void CloseConnection();
+    void HandleClose();
+    void HandleIOCompleted(CallBackFunc fnCompleted,
+                           const boost::system::error_code& err,std::size_t transferred);
     void HandleCompleted(CallBackFunc fnCompleted,
                          const boost::system::error_code& err,std::size_t transferred);
+    void HandleFrameCompleted(CWalleveBufStream& ssRecv,CallBackFrame fnFrame,CallBackFunc fnCompleted,std::size_t nTotal,
+                              const boost::system::error_code& err,std::size_t transferred);
     void HandleConnCompleted(CallBackConn fnCompleted,const boost::system::error_code& err);
     virtual const boost::asio::ip::tcp::endpoint SocketGetRemote() = 0;
     virtual const boost::asio::ip::tcp::endpoint SocketGetLocal() = 0;
@@ -45,13 +56,17 @@ protected:
     virtual bool IsSocketOpen() = 0;
     virtual void AsyncAccept(boost::asio::ip::tcp::acceptor& acceptor,CallBackConn fnAccepted) = 0;
     virtual void AsyncConnect(const boost::asio::ip::tcp::endpoint& epRemote,CallBackConn fnConnected) = 0;
-    virtual void AsyncRead(CWalleveBufStream& ssRecv,std::size_t nLength,CallBackFunc fnCompleted) = 0;
+    virtual void AsyncRead(CWalleveBufStream& ssRecv,std::size_t nLength,CallBackIO fnIO) = 0;
     virtual void AsyncReadUntil(CWalleveBufStream& ssRecv,const std::string& delim,CallBackFunc fnCompleted) = 0;
     virtual void AsyncWrite(CWalleveBufStream& ssSend,CallBackFunc fnCompleted) = 0;
 protected:
     CIOContainer *pContainer;
+    boost::asio::io_service::strand ioStrand;
     boost::asio::ip::tcp::endpoint epRemote;
+    boost::asio::ip::tcp::endpoint epLocal;
     int nRefCount;
+    bool fStrand;
+    bool fOpen;
 };
 
 class CSocketClient : public CIOClient
@@ -62,7 +77,7 @@ public:
 protected:
     void AsyncAccept(boost::asio::ip::tcp::acceptor& acceptor,CallBackConn fnAccepted);
     void AsyncConnect(const boost::asio::ip::tcp::endpoint& epRemote,CallBackConn fnConnected);
-    void AsyncRead(CWalleveBufStream& ssRecv,std::size_t nLength,CallBackFunc fnCompleted);
+    void AsyncRead(CWalleveBufStream& ssRecv,std::size_t nLength,CallBackIO fnIO);
     void AsyncReadUntil(CWalleveBufStream& ssRecv,const std::string& delim,CallBackFunc fnCompleted);
     void AsyncWrite(CWalleveBufStream& ssSend,CallBackFunc fnCompleted);
     const boost::asio::ip::tcp::endpoint SocketGetRemote();
@@ -83,7 +98,7 @@ public:
 protected:
     void AsyncAccept(boost::asio::ip::tcp::acceptor& acceptor,CallBackConn fnAccepted);
     void AsyncConnect(const boost::asio::ip::tcp::endpoint& epRemote,CallBackConn fnConnected);
-    void AsyncRead(CWalleveBufStream& ssRecv,std::size_t nLength,CallBackFunc fnCompleted);
+    void AsyncRead(CWalleveBufStream& ssRecv,std::size_t nLength,CallBackIO fnIO);
     void AsyncReadUntil(CWalleveBufStream& ssRecv,const std::string& delim,CallBackFunc fnCompleted);
     void AsyncWrite(CWalleveBufStream& ssSend,CallBackFunc fnCompleted);
     const boost::asio::ip::tcp::endpoint SocketGetRemote();
@@ -32,6 +32,16 @@ const tcp::endpoint CIOContainer::GetServiceEndpoint()
     return (tcp::endpoint());
 }
 
+boost::asio::io_service::strand& CIOContainer::GetIoStrand()
+{
+    return pIOProc->GetIoStrand();
+}
+
+bool CIOContainer::IsIoRunning()
+{
+    return pIOProc->IsIoRunning();
+}
+
 ///////////////////////////////
 // CIOCachedContainer
 CIOCachedContainer::CIOCachedContainer(CIOProc *pIOProcIn)
@@ -29,6 +29,8 @@ public:
     virtual void ClientClose(CIOClient* pClient) = 0;
     virtual std::size_t GetIdleCount();
     virtual const boost::asio::ip::tcp::endpoint GetServiceEndpoint();
+    boost::asio::io_service::strand& GetIoStrand();
+    bool IsIoRunning();
 protected:
     CIOProc *pIOProc;
 };
@@ -71,6 +71,7 @@ void CIOCompletion::Reset()
 CIOProc::CIOProc(const string& walleveOwnKeyIn)
 : IIOProc(walleveOwnKeyIn),
   thrIOProc(walleveOwnKeyIn,boost::bind(&CIOProc::IOThreadFunc,this)), 
+  nIOThreads(1),fIoRunning(false),
   ioStrand(ioService),resolverHost(ioService),ioOutBound(this),ioSSLOutBound(this),  
   timerHeartbeat(ioService,IOPROC_HEARTBEAT)
 {
@@ -90,6 +91,16 @@ boost::asio::io_service::strand& CIOProc::GetIoStrand()
     return ioStrand;
 }
 
+bool CIOProc::IsIoRunning()
+{
+    return fIoRunning;
+}
+
+void CIOProc::SetIOThreadCount(size_t nIOThreadsIn)
+{
+    nIOThreads = (nIOThreadsIn != 0 ? nIOThreadsIn : 1);
+}
+
 bool CIOProc::DispatchEvent(CWalleveEvent * pEvent)
 {
     bool fResult = false;
@@ -150,6 +161,8 @@ void CIOProc::WalleveHandleHalt()
     mapService.clear();
 }
 
+/* Timers, services and containers are only touched on ioStrand,
+   so the bookkeeping below needs no lock with any number of io threads */
 uint32 CIOProc::SetTimer(uint64 nNonce,int64 nElapse)
 {
     static uint32 nTimerId = 0;
@@ -253,9 +266,9 @@ void CIOProc::ResolveHost(const CNetHost& host)
     ss << host.nPort;
     tcp::resolver::query query(host.strHost,ss.str());
     resolverHost.async_resolve(query,
-                               boost::bind(&CIOProc::IOProcHandleResolved,this,host,
-                                           boost::asio::placeholders::error,
-                                           boost::asio::placeholders::iterator));
+                               ioStrand.wrap(boost::bind(&CIOProc::IOProcHandleResolved,this,host,
+                                                         boost::asio::placeholders::error,
+                                                         boost::asio::placeholders::iterator)));
 }
 
 void CIOProc::EnterLoop() 
@@ -305,12 +318,37 @@ void CIOProc::IOThreadFunc()
 {    
     ioService.reset();
     
-    timerHeartbeat.async_wait(boost::bind(&CIOProc::IOProcHeartBeat,this,_1));
+    timerHeartbeat.async_wait(ioStrand.wrap(boost::bind(&CIOProc::IOProcHeartBeat,this,_1)));
     
+    fIoRunning = true;
+
     EnterLoop();
 
+    for (size_t i = 1;i < nIOThreads;i++)
+    {
+        ostringstream oss;
+        oss << WalleveGetOwnKey() << "-io" << i;
+        CWalleveThread *pThread = new CWalleveThread(oss.str(),boost::bind(&CIOProc::IOWorkerFunc,this));
+        if (!WalleveThreadStart(*pThread))
+        {
+            WalleveLog("Failed to start io worker %s\n",oss.str().c_str());
+            delete pThread;
+            break;
+        }
+        vThrIOWorker.push_back(pThread);
+    }
+
     ioService.run();
 
+    BOOST_FOREACH(CWalleveThread *pThread,vThrIOWorker)
+    {
+        WalleveThreadExit(*pThread);
+        delete pThread;
+    }
+    vThrIOWorker.clear();
+
+    fIoRunning = false;
+
     LeaveLoop();
 
     timerHeartbeat.cancel();
@@ -320,13 +358,18 @@ void CIOProc::IOThreadFunc()
     mapTimerByExpiry.clear();
 }
 
+void CIOProc::IOWorkerFunc()
+{
+    ioService.run();
+}
+
 void CIOProc::IOProcHeartBeat(const boost::system::error_code& err)
 {
     if (!err)
     {
         /* restart deadline timer */
         timerHeartbeat.expires_at(timerHeartbeat.expires_at() + IOPROC_HEARTBEAT);
-        timerHeartbeat.async_wait(boost::bind(&CIOProc::IOProcHeartBeat,this,_1));
+        timerHeartbeat.async_wait(ioStrand.wrap(boost::bind(&CIOProc::IOProcHeartBeat,this,_1)));
 
         /* handle io timer */
         IOProcPollTimer();
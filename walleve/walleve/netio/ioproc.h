@@ -12,6 +12,7 @@
 #include "walleve/netio/iocontainer.h"
 #include <string>
 #include <map>
+#include <vector>
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp> 
 
@@ -55,6 +56,8 @@ public:
     virtual ~CIOProc();
     boost::asio::io_service& GetIoService();
     boost::asio::io_service::strand& GetIoStrand();
+    bool IsIoRunning();
+    void SetIOThreadCount(std::size_t nIOThreadsIn);
     bool DispatchEvent(CWalleveEvent* pEvent);
     virtual CIOClient* CreateIOClient(CIOContainer *pContainer);
 protected:
@@ -85,6 +88,7 @@ protected:
     virtual void HostFailToResolve(const CNetHost& host);
 private:
     void IOThreadFunc();
+    void IOWorkerFunc();
     void IOProcHeartBeat(const boost::system::error_code& err);
     void IOProcPollTimer();
     void IOProcHandleEvent(CWalleveEvent * pEvent,CIOCompletion& compltHandle);
@@ -92,6 +96,9 @@ private:
                               boost::asio::ip::tcp::resolver::iterator endpoint_iterator);
 private:
     CWalleveThread thrIOProc;
+    std::vector<CWalleveThread*> vThrIOWorker;
+    std::size_t nIOThreads;
+    bool fIoRunning;
     boost::asio::io_service ioService;
     boost::asio::io_service::strand ioStrand;
     boost::asio::ip::tcp::resolver resolverHost;
@@ -79,6 +79,13 @@ void CPeer::Read(size_t nLength,CompltFunc fnComplt)
                   boost::bind(&CPeer::HandleRead,this,_1,fnComplt));
 }
 
+void CPeer::ReadFrame(CWalleveBufStream& ssFrame,size_t nLength,CIOClient::CallBackFrame fnFrame,CompltFunc fnComplt)
+{
+    // ssFrame must outlive the read, fnFrame usually holds its owner
+    pClient->ReadFrame(ssFrame,nLength,fnFrame,
+                       boost::bind(&CPeer::HandleRead,this,_1,fnComplt));
+}
+
 void CPeer::Write()
 {
     if (indexWrite == indexStream)
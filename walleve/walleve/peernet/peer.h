@@ -35,6 +35,7 @@ protected:
     CWalleveBufStream& WriteStream();
 
     void Read(std::size_t nLength,CompltFunc fnComplt);
+    void ReadFrame(CWalleveBufStream& ssFrame,std::size_t nLength,CIOClient::CallBackFrame fnFrame,CompltFunc fnComplt);
     void Write();
 
     void HandleRead(std::size_t nTransferred,CompltFunc fnComplt);
@@ -30,6 +30,7 @@ CPeerNet::~CPeerNet()
 void CPeerNet::ConfigNetwork(CPeerNetConfig& config)
 {
     confNetwork = config;
+    SetIOThreadCount(config.nIOThreads);
 }
 
 void CPeerNet::HandlePeerViolate(CPeer *pPeer)
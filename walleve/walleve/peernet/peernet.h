@@ -37,6 +37,7 @@ public:
     std::vector<CPeerService> vecService;
     std::vector<CNetHost> vecNode;
     std::size_t nMaxOutBounds;
+    std::size_t nIOThreads;
     unsigned short nPortDefault;
 };
 
@@ -67,6 +67,15 @@ void circularbuf::consume(size_t n)
     }
 }
 
+const char* circularbuf::contiguous(pos_type pos,size_t n)
+{
+    if (seekpos(pos,ios_base::in) == pos_type(off_type(-1)) || (size_t)(egptr() - gptr()) < n)
+    {
+        return NULL;
+    }
+    return gptr();
+}
+
 circularbuf::int_type circularbuf::underflow()
 {
     size_t ppos = (pptr() - &buffer_[0]) & size_mask_;
@@ -21,6 +21,7 @@ public:
     std::size_t freespace() const;
     pos_type putpos() const;
     void consume(std::size_t n);
+    const char* contiguous(pos_type pos,std::size_t n);
 protected:
     enum {MIN_SIZE=8};
     int_type underflow();
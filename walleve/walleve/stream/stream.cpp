@@ -20,6 +20,7 @@ CWalleveStream& CWalleveStream::Serialize(std::string& t,ObjectType&,LoadType&)
 {
     CVarInt var;
     *this >> var;
+    CheckSpanCount(var.nValue,1);
     t.resize(var.nValue);
     return Read((char *)&t[0],var.nValue);
 }
@@ -11,6 +11,8 @@
 #include <iostream>
 #include <fstream>
 #include <iomanip>
+#include <cstring>
+#include <vector>
 #include <boost/type_traits.hpp>
 #include <boost/asio.hpp>
 
@@ -33,7 +35,8 @@ typedef const boost::integral_constant<int, WALLEVE_STREAM_LOAD> LoadType;
 class CWalleveStream
 {
 public:
-    CWalleveStream(std::streambuf* sb) : ios(sb) {}
+    CWalleveStream(std::streambuf* sb) 
+    : ios(sb),fSpan(false),pSpanCur(NULL),pSpanEnd(NULL),fPutSpan(false),pPutCur(NULL),pPutEnd(NULL) {}
 
     virtual std::size_t GetSize() {return 0;}
     
@@ -44,12 +47,41 @@ public:
 
     CWalleveStream& Write(const char *s,std::size_t n)
     {
+        if (fPutSpan)
+        {
+            // preallocated buffer, derived stream decides what happens when it is full
+            if (n <= (std::size_t)(pPutEnd - pPutCur))
+            {
+                std::memcpy(pPutCur,s,n);
+                pPutCur += n;
+            }
+            else
+            {
+                WriteOverflow(s,n);
+            }
+            return (*this);
+        }
+        if (fSpan)
+        {
+            throw std::ios_base::failure("CWalleveStream : write to read-only span");
+        }
         ios.write(s,n);
         return (*this);
     }
 
     CWalleveStream& Read(char *s,std::size_t n)
     {
+        if (fSpan)
+        {
+            // contiguous buffer, copy straight out of it without going through iostream
+            if (n > (std::size_t)(pSpanEnd - pSpanCur))
+            {
+                throw std::ios_base::failure("CWalleveStream : read out of span");
+            }
+            std::memcpy(s,pSpanCur,n);
+            pSpanCur += n;
+            return (*this);
+        }
         ios.read(s,n);
         return (*this);
     }
@@ -123,8 +155,29 @@ protected:
     /* std::pair */
     template<typename P1, typename P2,typename O>
     CWalleveStream& Serialize(std::pair<P1, P2>& t,ObjectType&,O& o);
+
+    virtual void WriteOverflow(const char *s,std::size_t n)
+    {
+        (void)s; (void)n;
+        throw std::ios_base::failure("CWalleveStream : write out of span");
+    }
+
+    // a span can not hold more elements than its remaining bytes, checked before resize
+    void CheckSpanCount(uint64 nCount,std::size_t nElemSize)
+    {
+        if (fSpan && nCount > (uint64)(pSpanEnd - pSpanCur) / nElemSize)
+        {
+            throw std::ios_base::failure("CWalleveStream : size out of span");
+        }
+    }
 protected:
     std::iostream ios;
+    bool fSpan;
+    const char* pSpanCur;
+    const char* pSpanEnd;
+    bool fPutSpan;
+    char* pPutCur;
+    char* pPutEnd;
 };
 
 // Autosize buffer stream
@@ -202,6 +255,59 @@ public:
     }
 };
 
+// Read-only stream over a contiguous buffer owned by the caller, 
+// objects are decoded in place without an iostream
+class CWalleveSpanStream : public CWalleveStream
+{
+public:
+    CWalleveSpanStream(const char* pData,std::size_t nSize) : CWalleveStream(NULL)
+    {
+        fSpan = true;
+        pSpanCur = pData;
+        pSpanEnd = pData + nSize;
+    }
+
+    std::size_t GetSize()
+    {
+        return (std::size_t)(pSpanEnd - pSpanCur);
+    }
+
+    const char *GetData() const
+    {
+        return pSpanCur;
+    }
+
+    void Consume(std::size_t nSize)
+    {
+        pSpanCur += std::min(nSize,GetSize());
+    }
+};
+
+// Write-only stream over a buffer presized to the exact serialized size, 
+// built as CWalleveVectorStream ss(GetSerializeSize(obj)); ss << obj;
+class CWalleveVectorStream : public CWalleveStream
+{
+public:
+    CWalleveVectorStream(std::size_t nSize) : CWalleveStream(NULL),vBuf(nSize)
+    {
+        fPutSpan = true;
+        pPutCur = vBuf.empty() ? NULL : &vBuf[0];
+        pPutEnd = pPutCur + nSize;
+    }
+
+    const char *GetData() const
+    {
+        return (vBuf.empty() ? NULL : &vBuf[0]);
+    }
+
+    std::size_t GetSize()
+    {
+        return (vBuf.size() - (std::size_t)(pPutEnd - pPutCur));
+    }
+protected:
+    std::vector<char> vBuf;
+};
+
 // Circular buffer stream
 class CWalleveCircularStream : public circularbuf, public CWalleveStream
 {
@@ -247,6 +353,13 @@ public:
         consume(nSize);
     }
 
+    // Pointer to nSize bytes at nPos if they are live and do not wrap around, otherwise NULL
+    const char* GetData(std::size_t nPos,std::size_t nSize)
+    {
+        ios.clear();
+        return contiguous(nPos,nSize);
+    }
+
     void Dump()
     {
         std::cout << "CWalleveStream Dump : " << size() << std::endl << std::hex;
@@ -400,6 +513,7 @@ CWalleveStream& CWalleveStream::Serialize(std::vector<T, A>& t,ObjectType&,LoadT
 {
     CVarInt var;
     *this >> var;
+    CheckSpanCount(var.nValue,boost::is_fundamental<T>::value ? sizeof(T) : 1);
     t.resize(var.nValue);
     if (boost::is_fundamental<T>::value)
     {
@@ -443,7 +557,7 @@ CWalleveStream& CWalleveStream::Serialize(std::pair<P1, P2>& t,ObjectType&,O& o)
 template<typename T>
 std::size_t GetSerializeSize(const T& obj)
 {
-    CWalleveBufStream ss;
+    CWalleveSpanStream ss(NULL,0);
     return ss.GetSerializeSize(obj);
 }
 
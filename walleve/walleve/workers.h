@@ -0,0 +1,144 @@
+// Copyright (c) 2016-2018 The LoMoCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef  WALLEVE_WORKERS_H
+#define  WALLEVE_WORKERS_H
+
+#include <vector>
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/atomic.hpp>
+
+namespace walleve
+{
+
+class CWalleveWorkers : public boost::noncopyable
+{
+public:
+    typedef boost::function<void(std::size_t)> WorkFunc;
+    CWalleveWorkers() : pWork(NULL) {}
+    ~CWalleveWorkers()
+    {
+        Stop();
+    }
+    bool Start(std::size_t nThreads = 0)
+    {
+        if (pWork != NULL)
+        {
+            return true;
+        }
+        if (nThreads == 0)
+        {
+            nThreads = boost::thread::hardware_concurrency();
+        }
+        ioService.reset();
+        pWork = new boost::asio::io_service::work(ioService);
+        try
+        {
+            for (std::size_t i = 1;i < nThreads;i++)
+            {
+                thrGroup.create_thread(boost::bind(&boost::asio::io_service::run,&ioService));
+            }
+        }
+        catch (...)
+        {
+            Stop();
+            return false;
+        }
+        return true;
+    }
+    void Stop()
+    {
+        if (pWork != NULL)
+        {
+            delete pWork;
+            pWork = NULL;
+            ioService.stop();
+            thrGroup.join_all();
+        }
+    }
+    std::size_t GetThreadCount() const
+    {
+        return (thrGroup.size() + 1);
+    }
+    /* Run fn(0) .. fn(nCount - 1) on the pool and the calling thread,
+       return after every item completed, false if any item threw.
+       Reentrant from a worker thread */
+    bool ForEach(std::size_t nCount,WorkFunc fn)
+    {
+        if (nCount == 0)
+        {
+            return true;
+        }
+        boost::shared_ptr<CBatch> spBatch(new CBatch(nCount,fn));
+        if (pWork != NULL && nCount > 1)
+        {
+            std::size_t nHelper = std::min(nCount - 1,thrGroup.size());
+            for (std::size_t i = 0;i < nHelper;i++)
+            {
+                ioService.post(boost::bind(&CBatch::Assist,spBatch));
+            }
+        }
+        spBatch->Run();
+        spBatch->Wait();
+        return (!spBatch->IsFailed());
+    }
+protected:
+    class CBatch
+    {
+    public:
+        CBatch(std::size_t nCountIn,WorkFunc fnIn) : nCount(nCountIn),fn(fnIn),nNext(0),nDone(0),fFailed(false) {}
+        static void Assist(boost::shared_ptr<CBatch> spBatch) { spBatch->Run(); }
+        void Run()
+        {
+            std::size_t n;
+            while ((n = nNext.fetch_add(1)) < nCount)
+            {
+                try
+                {
+                    fn(n);
+                }
+                catch (...)
+                {
+                    fFailed.store(true);
+                }
+                if (nDone.fetch_add(1) + 1 == nCount)
+                {
+                    boost::lock_guard<boost::mutex> lock(mutex);
+                    cond.notify_all();
+                }
+            }
+        }
+        void Wait()
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (nDone.load() < nCount)
+            {
+                cond.wait(lock);
+            }
+        }
+        bool IsFailed() const { return fFailed.load(); }
+    protected:
+        const std::size_t nCount;
+        WorkFunc fn;
+        boost::atomic<std::size_t> nNext;
+        boost::atomic<std::size_t> nDone;
+        boost::atomic<bool> fFailed;
+        boost::mutex mutex;
+        boost::condition_variable cond;
+    };
+protected:
+    boost::asio::io_service ioService;
+    boost::asio::io_service::work* pWork;
+    boost::thread_group thrGroup;
+};
+
+} // namespace walleve
+
+#endif //WALLEVE_WORKERS_H